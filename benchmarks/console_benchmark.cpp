@@ -0,0 +1,105 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// GUI-thread cost of the console over a long sequence.
+//
+// Simulates the 100 ms console flush of WidgetBase with 'lines' messages per
+// flush, either
+//   - 'textedit': QTextEdit::append() once per message on an unbounded
+//     document (the previous console), or
+//   - 'plain': one QPlainTextEdit::appendPlainText() per flush with a maximum
+//     block count of 5000 (WidgetBase::createConsole()).
+// Reports the mean time per flush over the first and the last 100 flushes,
+// the worst flush, and the size of the document at the end. 36000 flushes
+// are one hour of logging.
+//
+// Usage: console_benchmark [flushes] [lines]
+// Without a display, run with QT_QPA_PLATFORM=offscreen.
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPlainTextEdit>
+#include <QStringList>
+#include <QTextDocument>
+#include <QTextEdit>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static QStringList makeMessages(int flush, int lines) {
+    QStringList messages;
+    for (int i = 0; i < lines; i++) {
+        messages << QString("[2024-01-01 12:00:00] Sending image %1 (slice %2)...").arg(flush).arg(i);
+    }
+    return messages;
+}
+
+static void report(const char* mode, const std::vector<double>& ms, int blocks, int characters) {
+    size_t n = std::min<size_t>(100, ms.size());
+    double first = 0.0;
+    double last = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        first += ms[i];
+        last += ms[ms.size() - 1 - i];
+    }
+    double worst = ms.empty() ? 0.0 : *std::max_element(ms.begin(), ms.end());
+    printf("%-9s %12.3f %12.3f %10.3f %10d %12d\n", mode, first / n, last / n, worst, blocks, characters);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    int flushes = argc > 1 ? atoi(argv[1]) : 6000;
+    int lines = argc > 2 ? atoi(argv[2]) : 5;
+
+    printf("%-9s %12s %12s %10s %10s %12s\n", "mode", "first(ms)", "last(ms)", "max(ms)", "blocks", "characters");
+
+    {
+        QTextEdit console;
+        console.setReadOnly(true);
+        console.show();
+        std::vector<double> ms;
+        QElapsedTimer timer;
+        for (int f = 0; f < flushes; f++) {
+            QStringList messages = makeMessages(f, lines);
+            timer.start();
+            for (const QString& message : messages) {
+                console.append(message);
+            }
+            QApplication::processEvents();
+            ms.push_back(timer.nsecsElapsed() / 1.0e6);
+        }
+        report("textedit", ms, console.document()->blockCount(), console.document()->characterCount());
+    }
+
+    {
+        QPlainTextEdit console;
+        console.setReadOnly(true);
+        console.setUndoRedoEnabled(false);
+        console.setMaximumBlockCount(5000);
+        console.show();
+        std::vector<double> ms;
+        QElapsedTimer timer;
+        for (int f = 0; f < flushes; f++) {
+            QStringList messages = makeMessages(f, lines);
+            timer.start();
+            console.appendPlainText(messages.join('\n'));
+            QApplication::processEvents();
+            ms.push_back(timer.nsecsElapsed() / 1.0e6);
+        }
+        report("plain", ms, console.document()->blockCount(), console.document()->characterCount());
+    }
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Typed embedding API vs. the signal route (loopback).
+//
+// An IGTLListener in server mode (slowConsumerPolicy 'block', so nothing is
+// dropped) sends to a reader thread on the loopback interface. A producer
+// thread sends N images or tracking samples either
+//   - 'signal': as a QVariantMap through SignalManager::emitSignal(), as the
+//     simulator does; the slot runs in the thread of the event loop, or
+//   - 'direct': with IGTLListener::sendImage()/sendTracking().
+// The benchmark reports the producer time per call and the time per message
+// until the reader has received all N messages.
+//
+// Usage: embedding_api_benchmark [port] [count]
+
+#include "igtl_listener.h"
+#include "signal_manager.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QThread>
+#include <QVariantList>
+#include <QVariantMap>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<long> imagesReceived(0);
+static std::atomic<long> trackingReceived(0);
+
+static void receive(int port, std::atomic<bool>& active) {
+    igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+    while (active && socket->ConnectToServer("127.0.0.1", port) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    socket->SetReceiveTimeout(100);
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    std::vector<char> body;
+    while (active) {
+        header->InitPack();
+        bool timeout = true;
+        int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+        if (r != header->GetPackSize()) {
+            if (r == 0 && timeout) {
+                continue;
+            }
+            break;
+        }
+        header->Unpack();
+        body.resize(header->GetPackBodySize());
+        if (!body.empty()) {
+            timeout = false;
+            socket->Receive(body.data(), body.size(), timeout);
+        }
+        if (std::strcmp(header->GetDeviceType(), "IMAGE") == 0) {
+            imagesReceived++;
+        } else if (std::strcmp(header->GetDeviceType(), "TDATA") == 0) {
+            trackingReceived++;
+        }
+    }
+    socket->CloseSocket();
+}
+
+// Run the event loop (for the signal route) until 'counter' reaches 'target'
+static bool waitFor(const std::atomic<long>& counter, long target) {
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (counter < target) {
+        QCoreApplication::processEvents();
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+}
+
+static void report(const char* route, const char* payload, int count, double producerS, double totalS, bool complete) {
+    printf("%-7s %-16s %12.2f %12.2f %10.0f%s\n", route, payload, producerS * 1e6 / count, totalS * 1e6 / count,
+           count / totalS, complete ? "" : "  (incomplete)");
+    fflush(stdout);
+}
+
+static void runImage(SignalManager& signalManager, IGTLListener& listener, int size, int count) {
+    std::vector<uint16_t> pixels(static_cast<size_t>(size) * size, 100);
+    char payload[32];
+    snprintf(payload, sizeof(payload), "image %dx%d", size, size);
+
+    for (int direct = 0; direct < 2; direct++) {
+        long target = imagesReceived + count;
+        double producerS = 0.0;
+        auto start = Clock::now();
+        std::thread producer([&]() {
+            auto begin = Clock::now();
+            if (direct) {
+                ImageView image;
+                image.data = pixels.data();
+                image.size = pixels.size() * sizeof(uint16_t);
+                image.dimension[0] = size;
+                image.dimension[1] = size;
+                image.name = "MRImage";
+                for (int i = 0; i < count; i++) {
+                    listener.sendImage(image);
+                }
+            } else {
+                // As MRSimListener: the pixels are shared by the QByteArray, not copied
+                QByteArray binary = QByteArray::fromRawData(reinterpret_cast<const char*>(pixels.data()),
+                                                            static_cast<int>(pixels.size() * sizeof(uint16_t)));
+                for (int i = 0; i < count; i++) {
+                    QVariantMap param;
+                    param["dtype"] = "uint16";
+                    param["dimension"] = QVariantList() << size << size << 1;
+                    param["spacing"] = QVariantList() << 1.0 << 1.0 << 1.0;
+                    param["name"] = "MRImage";
+                    param["numberOfComponents"] = 1;
+                    param["endian"] = 2;
+                    QVariantList matrix;
+                    for (int k = 0; k < 16; k++) {
+                        matrix << ((k % 5 == 0) ? 1.0 : 0.0);
+                    }
+                    param["matrix"] = matrix;
+                    param["binary"] = QVariantList() << binary;
+                    param["binaryOffset"] = QVariantList() << 0;
+                    signalManager.emitSignal("sendImageIGTL", param);
+                }
+            }
+            producerS = std::chrono::duration<double>(Clock::now() - begin).count();
+        });
+        bool complete = waitFor(imagesReceived, target);
+        producer.join();
+        double totalS = std::chrono::duration<double>(Clock::now() - start).count();
+        report(direct ? "direct" : "signal", payload, count, producerS, totalS, complete);
+    }
+}
+
+static void runTracking(SignalManager& signalManager, IGTLListener& listener, int coils, int count) {
+    std::vector<CoilSample> samples(coils);
+    for (int c = 0; c < coils; c++) {
+        samples[c].id = "coil" + std::to_string(c);
+        samples[c].position[0] = 1.0f * c;
+        samples[c].position[1] = 2.0f;
+        samples[c].position[2] = 3.0f;
+    }
+    char payload[32];
+    snprintf(payload, sizeof(payload), "tracking %d", coils);
+
+    for (int direct = 0; direct < 2; direct++) {
+        long target = trackingReceived + count;
+        double producerS = 0.0;
+        auto start = Clock::now();
+        std::thread producer([&]() {
+            auto begin = Clock::now();
+            for (int i = 0; i < count; i++) {
+                if (direct) {
+                    listener.sendTracking(samples);
+                } else {
+                    QVariantList coilList;
+                    for (const CoilSample& sample : samples) {
+                        QVariantMap coil;
+                        coil["id"] = QString::fromStdString(sample.id);
+                        coil["position"] = QVariantList() << sample.position[0] << sample.position[1] << sample.position[2];
+                        coilList.append(coil);
+                    }
+                    QVariantMap param;
+                    param["coils"] = coilList;
+                    signalManager.emitSignal("sendTrackingDataIGTL", param);
+                }
+            }
+            producerS = std::chrono::duration<double>(Clock::now() - begin).count();
+        });
+        bool complete = waitFor(trackingReceived, target);
+        producer.join();
+        double totalS = std::chrono::duration<double>(Clock::now() - start).count();
+        report(direct ? "direct" : "signal", payload, count, producerS, totalS, complete);
+    }
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    int port = argc > 1 ? atoi(argv[1]) : 18980;
+    int count = argc > 2 ? atoi(argv[2]) : 2000;
+
+    SignalManager signalManager;
+    IGTLListener listener;
+    QVariantMap param;
+    param["mode"] = "server";
+    param["port"] = QString::number(port);
+    param["slowConsumerPolicy"] = "block";
+    param["maxQueueDepth"] = 64;
+    listener.connectSlots(&signalManager);
+    listener.configure(param);
+    listener.start();
+
+    std::atomic<bool> active(true);
+    std::thread reader(receive, port, std::ref(active));
+
+    // Wait until the listener has accepted the reader
+    std::vector<CoilSample> probe(1);
+    probe[0].id = "probe";
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!listener.sendTracking(probe)) {
+        if (Clock::now() > deadline) {
+            fprintf(stderr, "The reader did not connect on port %d\n", port);
+            active = false;
+            reader.join();
+            listener.stop();
+            return 1;
+        }
+        QCoreApplication::processEvents();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    waitFor(trackingReceived, 1);
+
+    printf("%-7s %-16s %12s %12s %10s\n", "route", "payload", "call(us)", "total(us)", "msg/s");
+    runTracking(signalManager, listener, 4, count);
+    runTracking(signalManager, listener, 64, count);
+    runImage(signalManager, listener, 64, count);
+    runImage(signalManager, listener, 256, count);
+    runImage(signalManager, listener, 512, count / 4);
+
+    listener.stop();
+    active = false;
+    reader.join();
+    return 0;
+}
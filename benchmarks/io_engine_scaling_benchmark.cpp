@@ -0,0 +1,197 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Connection-count scaling benchmark for the epoll I/O engine.
+//
+// A load generator opens N connections to a local server and sends TRANSFORM
+// messages at a fixed rate on each of them. The server side is either
+//   - 'threads': one receiver thread per connection polling with 10 ms receive
+//                timeouts (what N IGTLListener instances do), or
+//   - 'epoll'  : a single IGTLIOEngine thread.
+// For each N the benchmark reports received messages, CPU time and context
+// switches of the whole process. The generator load is identical in both modes.
+//
+// Usage: io_engine_scaling_benchmark [port] [seconds] [rateHz]
+
+#include "igtl_io_engine.h"
+#include <igtlServerSocket.h>
+#include <igtlClientSocket.h>
+#include <igtlTransformMessage.h>
+#include <igtlMath.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+struct Usage {
+    double cpu;        // User + system time (s)
+    long csw;          // Voluntary + involuntary context switches
+};
+
+static Usage getUsage() {
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    Usage u;
+    u.cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+    u.csw = ru.ru_nvcsw + ru.ru_nivcsw;
+    return u;
+}
+
+// Open 'n' connections and send one TRANSFORM per connection every 1/rate seconds
+static void generateLoad(int port, int n, double seconds, double rate, std::atomic<bool>& ready) {
+    std::vector<igtl::ClientSocket::Pointer> sockets;
+    for (int i = 0; i < n; i++) {
+        igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+        if (socket->ConnectToServer("127.0.0.1", port) != 0) {
+            fprintf(stderr, "Could not connect to port %d\n", port);
+            return;
+        }
+        sockets.push_back(socket);
+    }
+    while (!ready) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    igtl::TransformMessage::Pointer msg = igtl::TransformMessage::New();
+    msg->SetDeviceName("PLANE_0");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    msg->SetMatrix(matrix);
+    msg->Pack();
+
+    auto period = std::chrono::duration<double>(1.0 / rate);
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    while (std::chrono::steady_clock::now() - start < std::chrono::duration<double>(seconds)) {
+        for (auto& socket : sockets) {
+            socket->Send(msg->GetPackPointer(), msg->GetPackSize());
+        }
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(next);
+    }
+    for (auto& socket : sockets) {
+        socket->CloseSocket();
+    }
+}
+
+static long runThreads(int port, int n, double seconds, double rate) {
+    igtl::ServerSocket::Pointer server = igtl::ServerSocket::New();
+    if (server->CreateServer(port) < 0) {
+        return -1;
+    }
+
+    std::atomic<bool> ready(false);
+    std::atomic<bool> active(true);
+    std::atomic<long> received(0);
+    std::thread generator(generateLoad, port, n, seconds, rate, std::ref(ready));
+
+    std::vector<std::thread> receivers;
+    for (int i = 0; i < n; i++) {
+        igtl::ClientSocket::Pointer socket = server->WaitForConnection(5000);
+        if (socket.IsNull()) {
+            break;
+        }
+        receivers.emplace_back([socket, &active, &received]() {
+            igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+            igtl::TransformMessage::Pointer body = igtl::TransformMessage::New();
+            while (active) {
+                header->InitPack();
+                socket->SetReceiveTimeout(10);
+                bool timeout = true;
+                int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+                if (r == 0 && timeout) {
+                    continue;
+                }
+                if (r != header->GetPackSize()) {
+                    break;
+                }
+                header->Unpack();
+                body->Copy(header);
+                body->AllocatePack();
+                timeout = false;
+                socket->Receive(body->GetPackBodyPointer(), body->GetPackBodySize(), timeout);
+                body->Unpack();
+                received++;
+            }
+        });
+    }
+
+    ready = true;
+    generator.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    active = false;
+    for (auto& t : receivers) {
+        t.join();
+    }
+    server->CloseSocket();
+    return received;
+}
+
+static long runEngine(int port, int n, double seconds, double rate) {
+    IGTLIOEngine engine;
+    std::atomic<long> received(0);
+    std::atomic<int> connected(0);
+    engine.setMessageHandler("TRANSFORM", [&received](IGTLIOEngine::ConnectionId, igtl::MessageBase::Pointer msg) {
+        igtl::TransformMessage::Pointer body = igtl::TransformMessage::New();
+        body->Copy(msg);
+        body->Unpack();
+        received++;
+    });
+    engine.setConnectionHandler([&connected](IGTLIOEngine::ConnectionId, bool up) {
+        connected += up ? 1 : -1;
+    });
+    if (engine.listenOn(port) < 0 || !engine.start()) {
+        return -1;
+    }
+
+    std::atomic<bool> ready(false);
+    std::thread generator(generateLoad, port, n, seconds, rate, std::ref(ready));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (connected < n && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    ready = true;
+    generator.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    engine.stop();
+    return received;
+}
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 18950;
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    double rate = argc > 3 ? atof(argv[3]) : 100.0;
+    const int counts[] = {1, 4, 16, 32, 64};
+
+    printf("%-8s %6s %10s %10s %10s %12s\n", "mode", "conns", "expected", "received", "cpu(s)", "ctx-switch");
+    for (int n : counts) {
+        for (int mode = 0; mode < 2; mode++) {
+            long expected = static_cast<long>(seconds * rate) * n;
+            Usage before = getUsage();
+            long received = (mode == 0) ? runThreads(port, n, seconds, rate) : runEngine(port, n, seconds, rate);
+            Usage after = getUsage();
+            printf("%-8s %6d %10ld %10ld %10.3f %12ld\n", mode == 0 ? "threads" : "epoll", n, expected,
+                   received, after.cpu - before.cpu, after.csw - before.csw);
+            fflush(stdout);
+            port++;  // Avoid TIME_WAIT collisions between runs
+        }
+    }
+    return 0;
+}
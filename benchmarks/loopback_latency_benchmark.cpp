@@ -0,0 +1,424 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// End-to-end latency of the bridge against a local navigation system.
+//
+// A stand-in for the navigation system listens on an igtl::ServerSocket; an
+// IGTLListener (client mode) connects to it and an MRSimListener produces the
+// images, wired as in the bridge application. The stand-in
+//   1. starts and stops the sequence 'cycles' times (STRING START_SEQUENCE /
+//      STOP_SEQUENCE), then
+//   2. starts it once more and sends TRANSFORM PLANE_0 at 'transform-rate' Hz
+//      for 'seconds' while receiving the images.
+// All commands carry an OpenIGTLink timestamp. Reported as histograms:
+//   - TRANSFORM sent to 'updateScanPlane' emitted by the bridge (the plane is
+//     identified by its z offset),
+//   - START_SEQUENCE sent to the first IMAGE received,
+//   - 'sendImageIGTL' emitted by the simulator to the IMAGE received in full
+//     (images are matched in order: in client mode every image is sent),
+// and the images/s and MB/s received during step 2.
+//
+// With --compression the stand-in asks for COMP_IMAGE (STRING
+// IMAGE_COMPRESSION 'on') and decodes each image as it arrives; the decode
+// time is reported as well, and the image latency includes it.
+//
+// With --max-transform-p99, --max-image-p99 or --min-fps the exit code is 2
+// if a limit is not met, so that the benchmark can gate changes.
+//
+// Usage: loopback_latency_benchmark [--port N] [--seconds S] [--cycles N]
+//            [--size N] [--fps F] [--source NAME] [--transform-rate HZ]
+//            [--compression] [--max-transform-p99 MS] [--max-image-p99 MS] [--min-fps F]
+
+#include "bridge_metrics.h"
+#include "igtl_listener.h"
+#include "image_compression.h"
+#include "mrsim_listener.h"
+#include "signal_manager.h"
+#include "thread_pool.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <igtlServerSocket.h>
+#include <igtlStringMessage.h>
+#include <igtlTimeStamp.h>
+#include <igtlTransformMessage.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef BridgeMetrics::Histogram Histogram;
+
+static const int PlaneSlots = 100;  // TRANSFORMs in flight, told apart by z offset
+
+// Shared between the stand-in thread and the bridge (main) thread
+static std::mutex emitMutex;
+static std::deque<qint64> emitTimes;  // 'sendImageIGTL' not yet received
+static std::atomic<qint64> transformSent[PlaneSlots];
+static std::atomic<int> listenersConnected(0);
+static Histogram transformLatency;
+static Histogram startLatency;
+static Histogram imageLatency;
+static Histogram decodeTime;
+
+// The listeners emit from the main thread, so these slots are called directly
+class Probe : public QObject {
+    Q_OBJECT
+
+public slots:
+    void onListenerConnected(const QString& className) {
+        Q_UNUSED(className);
+        listenersConnected++;
+    }
+
+    void onSendImage(const QVariantMap& param) {
+        Q_UNUSED(param);
+        std::lock_guard<std::mutex> lock(emitMutex);
+        emitTimes.push_back(BridgeMetrics::now());
+    }
+
+    void onUpdateScanPlane(const QVariantMap& param) {
+        qint64 now = BridgeMetrics::now();
+        QVariantList matrix = param["matrix"].toList();
+        if (matrix.size() != 4) {
+            return;
+        }
+        int slot = static_cast<int>(std::lround(matrix[2].toList()[3].toDouble())) + PlaneSlots / 2;
+        if (slot >= 0 && slot < PlaneSlots) {
+            qint64 sent = transformSent[slot].exchange(0);
+            if (sent > 0) {
+                transformLatency.record(now - sent);
+            }
+        }
+    }
+};
+
+struct Throughput {
+    long images = 0;
+    double bytes = 0.0;
+    double imageBytes = 0.0;  // As IMAGE, i.e. after decoding a COMP_IMAGE
+    double seconds = 0.0;
+};
+
+class NavigationStandIn {
+public:
+    NavigationStandIn(igtl::ServerSocket::Pointer server, bool compression) : server(server), compression(compression) {}
+
+    bool run(int cycles, double seconds, double transformRate, Throughput& throughput);
+
+private:
+    // Receive one message; returns false on error. 'type' is empty on timeout.
+    bool receive(int timeoutMs, std::string& type);
+    void sendString(const char* command, const char* deviceName = "CMD");
+    void sendTransform(int slot);
+    void stamp(igtl::MessageBase* msg);
+
+    igtl::ServerSocket::Pointer server;
+    bool compression;
+    igtl::ClientSocket::Pointer socket;
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    std::vector<char> body;
+    size_t lastBytes = 0;
+    size_t lastImageBytes = 0;
+};
+
+bool NavigationStandIn::receive(int timeoutMs, std::string& type) {
+    type.clear();
+    header->InitPack();
+    bool timeout = false;
+    socket->SetReceiveTimeout(timeoutMs);
+    int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+    if (r == 0 && timeout) {
+        return true;
+    }
+    if (r != header->GetPackSize()) {
+        return false;
+    }
+    header->Unpack();
+    body.resize(header->GetPackBodySize());
+    if (!body.empty()) {
+        socket->SetReceiveTimeout(5000);
+        if (socket->Receive(body.data(), body.size(), timeout) != body.size()) {
+            return false;
+        }
+    }
+    type = header->GetDeviceType();
+    lastBytes = header->GetPackSize() + body.size();
+    lastImageBytes = lastBytes;
+
+    if (type == CompressedImageType) {
+        qint64 start = BridgeMetrics::now();
+        QString error;
+        igtl::ImageMessage::Pointer imageMsg = decompressImage(header, body.data(), body.size(), ThreadPool::shared(), error);
+        if (imageMsg.IsNull()) {
+            fprintf(stderr, "Cannot decode %s: %s\n", CompressedImageType, error.toUtf8().constData());
+            return false;
+        }
+        decodeTime.record(BridgeMetrics::now() - start);
+        lastImageBytes = imageMsg->GetPackSize();
+        type = "IMAGE";
+    }
+
+    if (type == "IMAGE") {
+        qint64 now = BridgeMetrics::now();
+        std::lock_guard<std::mutex> lock(emitMutex);
+        if (!emitTimes.empty()) {
+            imageLatency.record(now - emitTimes.front());
+            emitTimes.pop_front();
+        }
+    }
+    return true;
+}
+
+void NavigationStandIn::stamp(igtl::MessageBase* msg) {
+    igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+    ts->GetTime();
+    msg->SetTimeStamp(ts);
+}
+
+void NavigationStandIn::sendString(const char* command, const char* deviceName) {
+    igtl::StringMessage::Pointer msg = igtl::StringMessage::New();
+    msg->SetDeviceName(deviceName);
+    msg->SetString(command);
+    stamp(msg);
+    msg->Pack();
+    socket->Send(msg->GetPackPointer(), msg->GetPackSize());
+}
+
+void NavigationStandIn::sendTransform(int slot) {
+    igtl::TransformMessage::Pointer msg = igtl::TransformMessage::New();
+    msg->SetDeviceName("PLANE_0");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    matrix[2][3] = static_cast<float>(slot - PlaneSlots / 2);
+    msg->SetMatrix(matrix);
+    stamp(msg);
+    msg->Pack();
+    transformSent[slot] = BridgeMetrics::now();
+    socket->Send(msg->GetPackPointer(), msg->GetPackSize());
+}
+
+bool NavigationStandIn::run(int cycles, double seconds, double transformRate, Throughput& throughput) {
+    socket = server->WaitForConnection(10000);
+    if (socket.IsNull()) {
+        fprintf(stderr, "The bridge did not connect\n");
+        return false;
+    }
+    // The simulator may still be rendering its volume
+    qint64 deadline = BridgeMetrics::now() + 60000000000LL;
+    while (listenersConnected < 2) {
+        if (BridgeMetrics::now() > deadline) {
+            fprintf(stderr, "The simulator did not start\n");
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::string type;
+    if (compression) {
+        sendString("on", "IMAGE_COMPRESSION");
+    }
+
+    // 1. Sequence start to first image
+    for (int c = 0; c < cycles; c++) {
+        qint64 start = BridgeMetrics::now();
+        sendString("START_SEQUENCE");
+        while (type != "IMAGE") {
+            if (!receive(100, type) || BridgeMetrics::now() - start > 5000000000LL) {
+                fprintf(stderr, "No image after START_SEQUENCE\n");
+                return false;
+            }
+        }
+        startLatency.record(BridgeMetrics::now() - start);
+        sendString("STOP_SEQUENCE");
+        // Drain the frames that were already on their way
+        qint64 drainEnd = BridgeMetrics::now() + 300000000LL;
+        while (BridgeMetrics::now() < drainEnd) {
+            if (!receive(10, type)) {
+                return false;
+            }
+        }
+        type.clear();
+    }
+
+    // 2. Sustained streaming with scan plane updates
+    sendString("START_SEQUENCE");
+    const qint64 period = static_cast<qint64>(1.0e9 / transformRate);
+    const qint64 begin = BridgeMetrics::now();
+    const qint64 end = begin + static_cast<qint64>(seconds * 1.0e9);
+    qint64 nextTransform = begin;
+    int slot = 0;
+    while (BridgeMetrics::now() < end) {
+        if (BridgeMetrics::now() >= nextTransform) {
+            sendTransform(slot);
+            slot = (slot + 1) % PlaneSlots;
+            nextTransform += period;
+        }
+        if (!receive(1, type)) {
+            return false;
+        }
+        if (type == "IMAGE") {
+            throughput.images++;
+            throughput.bytes += lastBytes;
+            throughput.imageBytes += lastImageBytes;
+        }
+    }
+    throughput.seconds = (BridgeMetrics::now() - begin) / 1.0e9;
+    sendString("STOP_SEQUENCE");
+    return true;
+}
+
+static double report(const char* name, const Histogram& histogram) {
+    quint64 counts[Histogram::BucketCount];
+    quint64 zero[Histogram::BucketCount] = {};
+    histogram.read(counts);
+    quint64 total = 0;
+    quint64 peak = 0;
+    for (int i = 0; i < Histogram::BucketCount; i++) {
+        total += counts[i];
+        peak = std::max(peak, counts[i]);
+    }
+    double p99 = Histogram::percentile(counts, zero, 0.99);
+    printf("\n%s: %llu samples, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms\n", name, static_cast<unsigned long long>(total),
+           Histogram::percentile(counts, zero, 0.50), Histogram::percentile(counts, zero, 0.90), p99);
+    for (int i = 0; i < Histogram::BucketCount; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        int bar = static_cast<int>(40 * counts[i] / peak);
+        printf("  >= %10.3f ms %8llu %s\n", Histogram::lowerBound(i), static_cast<unsigned long long>(counts[i]),
+               std::string(std::max(bar, 1), '#').c_str());
+    }
+    return p99;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "Port of the stand-in navigation system.", "port", "18996");
+    QCommandLineOption secondsOption("seconds", "Duration of the sustained phase.", "seconds", "10");
+    QCommandLineOption cyclesOption("cycles", "START_SEQUENCE/STOP_SEQUENCE cycles.", "count", "20");
+    QCommandLineOption sizeOption("size", "Image matrix (size x size).", "pixels", "256");
+    QCommandLineOption fpsOption("fps", "Simulator frame rate.", "fps", "20");
+    QCommandLineOption sourceOption("source", "Simulator image source ('ring' or 'reslice').", "name", "reslice");
+    QCommandLineOption rateOption("transform-rate", "TRANSFORMs per second.", "hz", "10");
+    QCommandLineOption compressionOption("compression", "Receive the images as COMP_IMAGE.");
+    QCommandLineOption maxTransformOption("max-transform-p99", "Fail above this TRANSFORM latency.", "ms");
+    QCommandLineOption maxImageOption("max-image-p99", "Fail above this image latency.", "ms");
+    QCommandLineOption minFpsOption("min-fps", "Fail below this sustained image rate.", "fps");
+    parser.addOptions({portOption, secondsOption, cyclesOption, sizeOption, fpsOption, sourceOption, rateOption,
+                       compressionOption, maxTransformOption, maxImageOption, minFpsOption});
+    parser.process(app);
+    const int port = parser.value(portOption).toInt();
+
+    igtl::ServerSocket::Pointer server = igtl::ServerSocket::New();
+    if (server->CreateServer(port) < 0) {
+        fprintf(stderr, "Cannot listen on port %d\n", port);
+        return 1;
+    }
+
+    // The bridge, wired as in HeadlessBridge; the probe is connected first so
+    // that it sees each image before it is sent
+    SignalManager signalManager;
+    Probe probe;
+    signalManager.connectSlot("listenerConnected", &probe, SLOT(onListenerConnected(QString)));
+    signalManager.connectSlot("sendImageIGTL", &probe, SLOT(onSendImage(QVariantMap)));
+    signalManager.connectSlot("updateScanPlane", &probe, SLOT(onUpdateScanPlane(QVariantMap)));
+
+    IGTLListener igtlListener;
+    QVariantMap igtlParam;
+    igtlParam["ip"] = "127.0.0.1";
+    igtlParam["port"] = QString::number(port);
+    igtlListener.connectSlots(&signalManager);
+    igtlListener.configure(igtlParam);
+
+    MRSimListener mrSimListener;
+    QVariantMap mrSimParam;
+    mrSimParam["width"] = parser.value(sizeOption).toInt();
+    mrSimParam["height"] = parser.value(sizeOption).toInt();
+    mrSimParam["fps"] = parser.value(fpsOption).toDouble();
+    mrSimParam["source"] = parser.value(sourceOption);
+    mrSimListener.connectSlots(&signalManager);
+    mrSimListener.configure(mrSimParam);
+
+    igtlListener.start();
+    mrSimListener.start();
+
+    Throughput throughput;
+    std::atomic<bool> done(false);
+    bool ok = false;
+    std::thread navigation([&]() {
+        NavigationStandIn standIn(server, parser.isSet(compressionOption));
+        ok = standIn.run(parser.value(cyclesOption).toInt(), parser.value(secondsOption).toDouble(),
+                         parser.value(rateOption).toDouble(), throughput);
+        done = true;
+    });
+
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [&]() {
+        if (done) {
+            app.quit();
+        }
+    });
+    poll.start(20);
+    app.exec();
+    navigation.join();
+
+    mrSimListener.stop();
+    igtlListener.stop();
+    server->CloseSocket();
+    if (!ok) {
+        return 1;
+    }
+
+    double transformP99 = report("TRANSFORM to updateScanPlane", transformLatency);
+    report("START_SEQUENCE to first image", startLatency);
+    double imageP99 = report("sendImageIGTL to image received", imageLatency);
+    double fps = throughput.images / throughput.seconds;
+    printf("\nSustained: %.1f images/s, %.1f MB/s over %.1f s\n", fps,
+           throughput.bytes / throughput.seconds / (1024.0 * 1024.0), throughput.seconds);
+    if (parser.isSet(compressionOption)) {
+        report("COMP_IMAGE decode", decodeTime);
+        printf("\nCompression: ratio %.2f, %.1f MB/s of images decoded\n", throughput.imageBytes / throughput.bytes,
+               throughput.imageBytes / throughput.seconds / (1024.0 * 1024.0));
+    }
+
+    bool pass = true;
+    if (parser.isSet(maxTransformOption) && transformP99 > parser.value(maxTransformOption).toDouble()) {
+        printf("FAIL: TRANSFORM p99 %.3f ms > %s ms\n", transformP99, parser.value(maxTransformOption).toUtf8().constData());
+        pass = false;
+    }
+    if (parser.isSet(maxImageOption) && imageP99 > parser.value(maxImageOption).toDouble()) {
+        printf("FAIL: image p99 %.3f ms > %s ms\n", imageP99, parser.value(maxImageOption).toUtf8().constData());
+        pass = false;
+    }
+    if (parser.isSet(minFpsOption) && fps < parser.value(minFpsOption).toDouble()) {
+        printf("FAIL: %.1f images/s < %s\n", fps, parser.value(minFpsOption).toUtf8().constData());
+        pass = false;
+    }
+    return pass ? 0 : 2;
+}
+
+#include "loopback_latency_benchmark.moc"
@@ -0,0 +1,453 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Microbenchmarks of the bridge hot paths, written as JSON.
+//
+//   emitSignal/direct                 SignalManager::emitSignal() to a slot in
+//                                     the same thread
+//   emitSignal/proxy                  SignalManagerProxy::emitSignal() until the
+//                                     slot has run in the event loop thread
+//   imageParam/<size>                 The 'sendImageIGTL' QVariantMap as built
+//                                     by MRSimListener
+//   imagePack/<dtype>/<size>          Build, fill and pack an IMAGE message
+//   sendImageIGTL/<dtype>/<size>      The 'sendImageIGTL' slot, including the
+//                                     pack and the queueing for one client
+//   imageAssemble/<mode>/<slices>     Copy a 256^2 x <slices> uint16 volume
+//                                     sent as one chunk per slice into the
+//                                     message ('serial' or 'parallel')
+//   imageCompress/<dtype>             compressImage() of a 256^2 x 16 phantom
+//                                     volume with noise (uint16, float32); the
+//                                     entry has the compression ratio
+//   imageDecompress/<dtype>           decompressImage() of the same volume
+//   onReceiveTransform                Unpack a TRANSFORM, convert it with
+//                                     IGTLListener::scanPlaneParam() and emit
+//                                     'updateScanPlane'
+//   sendTrackingDataIGTL/<coils>      The 'sendTrackingDataIGTL' slot
+//
+// <dtype> runs over AllScalarTypes; images are single slices of <size>^2 voxels.
+// Each benchmark is run in batches of about 1 ms for at least 'min-time'
+// seconds; the JSON has the median, minimum and mean time per operation over
+// the batches. The slots send to a reader thread on the loopback interface
+// (slowConsumerPolicy 'dropOldest', so they never wait for the reader).
+//
+// Usage: mrigtl_benchmarks [--port N] [--min-time S] [--filter TEXT] [--output FILE]
+
+#include "igtl_listener.h"
+#include "image_assembly.h"
+#include "image_compression.h"
+#include "scalar_type.h"
+#include "signal_manager.h"
+#include "thread_pool.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QVariantList>
+#include <QVariantMap>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <igtlTransformMessage.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+class Receiver : public QObject {
+    Q_OBJECT
+
+public:
+    long count = 0;
+
+public slots:
+    void onDict(const QVariantMap& param) {
+        Q_UNUSED(param);
+        count++;
+    }
+};
+
+class Suite {
+public:
+    Suite(double minTime, const QString& filter) : minTime(minTime), filter(filter) {}
+
+    // 'bytes' per operation, for the throughput (0: none)
+    template <typename Function>
+    void run(const QString& name, double bytes, Function function) {
+        if (!filter.isEmpty() && !name.contains(filter)) {
+            return;
+        }
+        long batch = 1;
+        while (batch < (1L << 24) && time(function, batch) < 1.0e-3) {
+            batch *= 2;
+        }
+
+        std::vector<double> samples;  // ns per operation
+        long iterations = 0;
+        auto start = Clock::now();
+        while (samples.size() < 5 || std::chrono::duration<double>(Clock::now() - start).count() < minTime) {
+            samples.push_back(time(function, batch) * 1.0e9 / batch);
+            iterations += batch;
+        }
+        std::sort(samples.begin(), samples.end());
+        double median = samples[samples.size() / 2];
+        double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+        QJsonObject result;
+        result["name"] = name;
+        result["iterations"] = static_cast<double>(iterations);
+        result["ns_per_op"] = median;
+        result["ns_per_op_min"] = samples.front();
+        result["ns_per_op_mean"] = mean;
+        if (bytes > 0.0) {
+            result["bytes_per_second"] = bytes * 1.0e9 / median;
+        }
+        results.append(result);
+        fprintf(stderr, "%-36s %14.0f ns\n", name.toUtf8().constData(), median);
+    }
+
+    // Adds 'key' to the result of benchmark 'name', if it was run
+    void annotate(const QString& name, const QString& key, double value) {
+        for (int i = 0; i < results.size(); i++) {
+            QJsonObject result = results[i].toObject();
+            if (result.value("name").toString() == name) {
+                result[key] = value;
+                results.replace(i, result);
+                fprintf(stderr, "%-36s %14.2f %s\n", name.toUtf8().constData(), value, key.toUtf8().constData());
+                return;
+            }
+        }
+    }
+
+    QJsonArray results;
+
+private:
+    template <typename Function>
+    static double time(Function& function, long count) {
+        auto begin = Clock::now();
+        for (long i = 0; i < count; i++) {
+            function();
+        }
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    }
+
+    double minTime;
+    QString filter;
+};
+
+static void receive(int port, std::atomic<bool>& active) {
+    igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+    while (active && socket->ConnectToServer("127.0.0.1", port) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    socket->SetReceiveTimeout(100);
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    std::vector<char> body;
+    while (active) {
+        header->InitPack();
+        bool timeout = true;
+        int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+        if (r != header->GetPackSize()) {
+            if (r == 0 && timeout) {
+                continue;
+            }
+            break;
+        }
+        header->Unpack();
+        body.resize(header->GetPackBodySize());
+        if (!body.empty()) {
+            timeout = false;
+            socket->Receive(body.data(), body.size(), timeout);
+        }
+    }
+    socket->CloseSocket();
+}
+
+// As MRSimListener: the voxels are shared by the QByteArray, not copied
+static QVariantMap imageParam(const QString& dtype, int size, const QByteArray& binary) {
+    QVariantMap param;
+    param["dtype"] = dtype;
+    param["dimension"] = QVariantList() << size << size << 1;
+    param["spacing"] = QVariantList() << 1.0 << 1.0 << 1.0;
+    param["name"] = "MRImage";
+    param["numberOfComponents"] = 1;
+    param["endian"] = 2;
+    QVariantList matrix;
+    for (int k = 0; k < 16; k++) {
+        matrix << ((k % 5 == 0) ? 1.0 : 0.0);
+    }
+    param["matrix"] = matrix;
+    param["binary"] = QVariantList() << binary;
+    param["binaryOffset"] = QVariantList() << 0;
+    return param;
+}
+
+static void quietDebug(QtMsgType type, const QMessageLogContext& context, const QString& message) {
+    // The slots log every call with qDebug()
+    Q_UNUSED(context);
+    if (type != QtDebugMsg) {
+        fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+    }
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    qInstallMessageHandler(quietDebug);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption portOption("port", "Loopback port for the slot benchmarks.", "port", "18995");
+    QCommandLineOption minTimeOption("min-time", "Minimum time per benchmark in seconds.", "seconds", "0.2");
+    QCommandLineOption filterOption("filter", "Only run benchmarks whose name contains this text.", "text");
+    QCommandLineOption outputOption("output", "Write the JSON to this file instead of stdout.", "file");
+    parser.addOption(portOption);
+    parser.addOption(minTimeOption);
+    parser.addOption(filterOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+    int port = parser.value(portOption).toInt();
+    Suite suite(parser.value(minTimeOption).toDouble(), parser.value(filterOption));
+
+    SignalManager signalManager;
+    Receiver receiver;
+    signalManager.addCustomSlot("benchmarkSignal", "dict", &receiver, SLOT(onDict(QVariantMap)));
+    signalManager.connectSlot("updateScanPlane", &receiver, SLOT(onDict(QVariantMap)));
+
+    IGTLListener listener;
+    QVariantMap config;
+    config["mode"] = "server";
+    config["port"] = QString::number(port);
+    config["slowConsumerPolicy"] = "dropOldest";
+    listener.connectSlots(&signalManager);
+    listener.configure(config);
+    listener.start();
+
+    std::atomic<bool> active(true);
+    std::thread reader(receive, port, std::ref(active));
+
+    // Wait until the listener has accepted the reader
+    std::vector<CoilSample> probe(1);
+    probe[0].id = "probe";
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!listener.sendTracking(probe)) {
+        if (Clock::now() > deadline) {
+            fprintf(stderr, "The reader did not connect on port %d\n", port);
+            active = false;
+            reader.join();
+            listener.stop();
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Signals
+    QVariantMap small;
+    small["plane_id"] = 0;
+    suite.run("emitSignal/direct", 0, [&]() { signalManager.emitSignal("benchmarkSignal", small); });
+    SignalManagerProxy* proxy = signalManager.getSignalManagerProxy();
+    suite.run("emitSignal/proxy", 0, [&]() {
+        long target = receiver.count + 1;
+        proxy->emitSignal("benchmarkSignal", small);
+        while (receiver.count < target) {
+            QCoreApplication::processEvents();
+        }
+    });
+
+    // Images
+    const int sizes[] = {64, 256, 512};
+    std::vector<char> voxels(static_cast<size_t>(512) * 512 * 8);
+    for (size_t i = 0; i < voxels.size(); i++) {
+        voxels[i] = static_cast<char>(i * 7);
+    }
+    for (int size : sizes) {
+        QByteArray binary = QByteArray::fromRawData(voxels.data(), size * size * 2);
+        suite.run(QString("imageParam/%1").arg(size), 0, [&]() {
+            QVariantMap param = imageParam("uint16", size, binary);
+            Q_UNUSED(param);
+        });
+    }
+    for (ScalarType type : AllScalarTypes) {
+        const QString dtype = scalarTypeName(type);
+        const int scalarType = static_cast<int>(type);
+        const int scalarSize = mrigtlbridge::scalarSize(type);
+        for (int size : sizes) {
+            const int bytes = size * size * scalarSize;
+            suite.run(QString("imagePack/%1/%2").arg(dtype).arg(size), bytes, [&]() {
+                igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+                imageMsg->SetDimensions(size, size, 1);
+                imageMsg->SetScalarType(scalarType);
+                imageMsg->SetDeviceName("MRImage");
+                imageMsg->SetSpacing(1.0f, 1.0f, 1.0f);
+                imageMsg->AllocateScalars();
+                std::memcpy(imageMsg->GetScalarPointer(), voxels.data(), bytes);
+                imageMsg->Pack();
+            });
+
+            QVariantMap param = imageParam(dtype, size, QByteArray::fromRawData(voxels.data(), bytes));
+            suite.run(QString("sendImageIGTL/%1/%2").arg(dtype).arg(size), bytes, [&]() {
+                signalManager.emitSignal("sendImageIGTL", param);
+            });
+        }
+    }
+
+    // Multi-chunk volumes; the parallel copy uses the shared pool
+    const int assembleSlices[] = {16, 64, 256};
+    for (int slices : assembleSlices) {
+        const qint64 sliceBytes = 256 * 256 * 2;
+        const qint64 total = sliceBytes * slices;
+        std::vector<char> source(static_cast<size_t>(total), 1);
+        std::vector<char> volume(static_cast<size_t>(total));
+        std::vector<ImageChunk> chunks(slices);
+        for (int k = 0; k < slices; k++) {
+            chunks[k].data = source.data() + k * sliceBytes;
+            chunks[k].offset = k * sliceBytes;
+            chunks[k].size = sliceBytes;
+        }
+        const char* modes[] = {"serial", "parallel"};
+        for (const char* mode : modes) {
+            const qint64 threshold = (std::strcmp(mode, "parallel") == 0) ? 1 : 0;
+            suite.run(QString("imageAssemble/%1/%2").arg(mode).arg(slices), total, [&]() {
+                qint64 gapBytes = 0;
+                QString error;
+                validateImageChunks(chunks, total, 2, gapBytes, error);
+                assembleImageChunks(chunks, volume.data(), total, ThreadPool::shared(), threshold);
+            });
+        }
+    }
+
+    // Lossless compression of a disk phantom with a little noise in the low bits
+    const ScalarType compressTypes[] = {ScalarType::UInt16, ScalarType::Float32};
+    for (ScalarType type : compressTypes) {
+        const int size = 256;
+        const int slices = 16;
+        igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+        imageMsg->SetDimensions(size, size, slices);
+        imageMsg->SetScalarType(static_cast<int>(type));
+        imageMsg->SetDeviceName("MRImage");
+        imageMsg->SetSpacing(1.0f, 1.0f, 1.0f);
+        imageMsg->AllocateScalars();
+        quint32 noise = 1;
+        dispatchScalarType(type, [&](auto traits) {
+            using T = typename decltype(traits)::Type;
+            T* scalars = static_cast<T*>(imageMsg->GetScalarPointer());
+            for (int i = 0; i < size * size * slices; i++) {
+                const double x = i % size - size / 2.0;
+                const double y = (i / size) % size - size / 2.0;
+                const double r2 = (x * x + y * y) / (100.0 * 100.0);
+                noise = noise * 1664525u + 1013904223u;
+                scalars[i] = static_cast<T>((r2 < 1.0 ? 1000.0 * (1.0 - r2) : 0.0) + (noise >> 30));
+            }
+        });
+        imageMsg->Pack();
+        const double bytes = imageMsg->GetPackSize();
+        igtl::MessageBase::Pointer compressed = compressImage(imageMsg, ThreadPool::shared());
+        if (compressed.IsNull()) {
+            fprintf(stderr, "imageCompress/%s: not smaller compressed\n", scalarTypeName(type));
+            continue;
+        }
+        const QString name = QString("imageCompress/%1").arg(scalarTypeName(type));
+        suite.run(name, bytes, [&]() {
+            compressImage(imageMsg, ThreadPool::shared());
+        });
+        suite.annotate(name, "compression_ratio", bytes / compressed->GetPackSize());
+        suite.run(QString("imageDecompress/%1").arg(scalarTypeName(type)), bytes, [&]() {
+            QString error;
+            decompressImage(compressed, compressed->GetPackBodyPointer(), compressed->GetPackBodySize(),
+                            ThreadPool::shared(), error);
+        });
+    }
+
+    // Transforms from the scanner side, as received
+    igtl::TransformMessage::Pointer transform = igtl::TransformMessage::New();
+    transform->SetDeviceName("PLANE_0");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    matrix[0][3] = 10.0f;
+    transform->SetMatrix(matrix);
+    transform->Pack();
+    std::vector<char> packed(static_cast<const char*>(transform->GetPackPointer()),
+                             static_cast<const char*>(transform->GetPackPointer()) + transform->GetPackSize());
+    suite.run("onReceiveTransform", 0, [&]() {
+        // As IGTLListener::receiveMessage() and handleMessage()
+        igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+        header->InitPack();
+        std::memcpy(header->GetPackPointer(), packed.data(), header->GetPackSize());
+        header->Unpack();
+        header->AllocatePack();
+        std::memcpy(header->GetPackBodyPointer(), packed.data() + header->GetPackSize(), header->GetPackBodySize());
+        igtl::TransformMessage::Pointer received = igtl::TransformMessage::New();
+        received->Copy(header);
+        received->Unpack();
+        igtl::Matrix4x4 m;
+        received->GetMatrix(m);
+        signalManager.emitSignal("updateScanPlane", IGTLListener::scanPlaneParam(m, received->GetDeviceName()));
+    });
+
+    // Tracking
+    const int coilCounts[] = {1, 4, 16, 64, 256};
+    for (int coils : coilCounts) {
+        QVariantList coilList;
+        for (int c = 0; c < coils; c++) {
+            QVariantMap coil;
+            coil["id"] = QString("coil%1").arg(c);
+            coil["position"] = QVariantList() << 1.0 * c << 2.0 << 3.0;
+            coilList.append(coil);
+        }
+        QVariantMap param;
+        param["coils"] = coilList;
+        suite.run(QString("sendTrackingDataIGTL/%1").arg(coils), 0, [&]() {
+            signalManager.emitSignal("sendTrackingDataIGTL", param);
+        });
+    }
+
+    listener.stop();
+    active = false;
+    reader.join();
+
+    QJsonObject context;
+    context["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    context["host"] = QSysInfo::machineHostName();
+    context["cpu_architecture"] = QSysInfo::currentCpuArchitecture();
+    context["os"] = QSysInfo::prettyProductName();
+    context["qt_version"] = qVersion();
+    context["min_time"] = parser.value(minTimeOption).toDouble();
+    QJsonObject root;
+    root["context"] = context;
+    root["benchmarks"] = suite.results;
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            fprintf(stderr, "Cannot write %s\n", file.fileName().toLocal8Bit().constData());
+            return 1;
+        }
+        file.write(json);
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    return 0;
+}
+
+#include "mrigtl_benchmarks.moc"
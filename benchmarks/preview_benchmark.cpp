@@ -0,0 +1,155 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Image send throughput with the preview off and on (loopback).
+//
+// An IGTLListener in server mode (slowConsumerPolicy 'block') sends N images
+// with IGTLListener::sendImage() to a reader thread, first without a preview,
+// then with a PreviewRenderer attached to the image tap at 'rate' Hz. Reports
+// images/s and MB/s for both, and the frames rendered by the preview and the
+// time per render.
+//
+// Usage: preview_benchmark [port] [count] [rate]
+
+#include "igtl_listener.h"
+#include "image_preview_widget.h"
+#include "signal_manager.h"
+#include <QCoreApplication>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+static std::atomic<long> imagesReceived(0);
+
+static void receive(int port, std::atomic<bool>& active) {
+    igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+    while (active && socket->ConnectToServer("127.0.0.1", port) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    socket->SetReceiveTimeout(100);
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    std::vector<char> body;
+    while (active) {
+        header->InitPack();
+        bool timeout = true;
+        int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+        if (r != header->GetPackSize()) {
+            if (r == 0 && timeout) {
+                continue;
+            }
+            break;
+        }
+        header->Unpack();
+        body.resize(header->GetPackBodySize());
+        if (!body.empty()) {
+            timeout = false;
+            socket->Receive(body.data(), body.size(), timeout);
+        }
+        if (std::strcmp(header->GetDeviceType(), "IMAGE") == 0) {
+            imagesReceived++;
+        }
+    }
+    socket->CloseSocket();
+}
+
+static void run(IGTLListener& listener, int size, int count, double rate) {
+    std::vector<uint16_t> pixels(static_cast<size_t>(size) * size);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = static_cast<uint16_t>(i % 1000);
+    }
+    ImageView image;
+    image.data = pixels.data();
+    image.size = pixels.size() * sizeof(uint16_t);
+    image.dimension[0] = size;
+    image.dimension[1] = size;
+    image.name = "MRImage";
+
+    for (int preview = 0; preview < 2; preview++) {
+        PreviewRenderer renderer;
+        if (preview) {
+            renderer.setRate(rate);
+            renderer.start();
+        }
+        long target = imagesReceived + count;
+        auto start = Clock::now();
+        for (int i = 0; i < count; i++) {
+            listener.sendImage(image);
+        }
+        while (imagesReceived < target && Clock::now() - start < std::chrono::seconds(60)) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        renderer.stop();
+
+        printf("%4dx%-4d %-8s %10.0f %10.1f %10llu %10.3f\n", size, size, preview ? "on" : "off", count / seconds,
+               count * image.size / seconds / (1024.0 * 1024.0),
+               static_cast<unsigned long long>(renderer.getFrameCount()), renderer.getLastRenderMs());
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    int port = argc > 1 ? atoi(argv[1]) : 18990;
+    int count = argc > 2 ? atoi(argv[2]) : 2000;
+    double rate = argc > 3 ? atof(argv[3]) : 30.0;
+
+    SignalManager signalManager;
+    IGTLListener listener;
+    QVariantMap param;
+    param["mode"] = "server";
+    param["port"] = QString::number(port);
+    param["slowConsumerPolicy"] = "block";
+    param["maxQueueDepth"] = 64;
+    listener.connectSlots(&signalManager);
+    listener.configure(param);
+    listener.start();
+
+    std::atomic<bool> active(true);
+    std::thread reader(receive, port, std::ref(active));
+
+    // Wait until the listener has accepted the reader
+    std::vector<CoilSample> probe(1);
+    probe[0].id = "probe";
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (!listener.sendTracking(probe)) {
+        if (Clock::now() > deadline) {
+            fprintf(stderr, "The reader did not connect on port %d\n", port);
+            active = false;
+            reader.join();
+            listener.stop();
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    printf("%-9s %-8s %10s %10s %10s %10s\n", "image", "preview", "images/s", "MB/s", "rendered", "render(ms)");
+    run(listener, 256, count, rate);
+    run(listener, 512, count / 4, rate);
+
+    listener.stop();
+    active = false;
+    reader.join();
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Per-plane reslice time of the simulator's reference volume.
+//
+// Renders the Shepp-Logan phantom as a float volume (as MRSimListener does)
+// and reslices it along an oblique plane at 256x256 and 512x512 output.
+// Each size is run with the scalar kernel on one thread, the AVX2 kernel on
+// one thread (if supported), and the AVX2 kernel on the thread pool. The
+// plane is rotated slightly between iterations so that every run touches
+// a different part of the volume. Finally, three planes (as in a multi-plane
+// protocol) are resliced one after the other and concurrently, both on the
+// pool, as MRSimListener does.
+//
+// Usage: reslice_benchmark [volumeSize] [iterations]
+
+#include "mrsim_image_generator.h"
+#include "thread_pool.h"
+#include "volume_reslicer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+static void obliquePlane(int iteration, double m[4][4]) {
+    // 30 degrees about x, then a small rotation about z that changes per iteration
+    double a = 30.0 * 3.14159265358979323846 / 180.0;
+    double b = 0.01 * iteration;
+    double rx[3][3] = {{1, 0, 0}, {0, std::cos(a), -std::sin(a)}, {0, std::sin(a), std::cos(a)}};
+    double rz[3][3] = {{std::cos(b), -std::sin(b), 0}, {std::sin(b), std::cos(b), 0}, {0, 0, 1}};
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            m[i][j] = 0.0;
+            for (int k = 0; k < 3; k++) {
+                m[i][j] += rz[i][k] * rx[k][j];
+            }
+        }
+    }
+    m[2][3] = 10.0;
+}
+
+static double run(VolumeReslicer& reslicer, int size, int iterations, ThreadPool* pool) {
+    std::vector<unsigned short> output(static_cast<size_t>(size) * size);
+    double m[4][4];
+    obliquePlane(0, m);
+    reslicer.reslice(m, size, size, 256.0 / size, 5, output.data(), pool);  // Warm up
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        obliquePlane(i, m);
+        reslicer.reslice(m, size, size, 256.0 / size, 5, output.data(), pool);
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+}
+
+static double runPlanes(VolumeReslicer& reslicer, int size, int iterations, bool concurrent) {
+    const int planes = 3;
+    std::vector<std::vector<unsigned short>> outputs(planes, std::vector<unsigned short>(static_cast<size_t>(size) * size));
+    ThreadPool* pool = ThreadPool::shared();
+    auto reslicePlane = [&](int i, int n) {
+        double m[4][4];
+        obliquePlane(i + 50 * n, m);
+        reslicer.reslice(m, size, size, 256.0 / size, 5, outputs[n].data(), pool);
+    };
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        if (concurrent) {
+            pool->parallelFor(planes, [&](int begin, int end) {
+                for (int n = begin; n < end; n++) {
+                    reslicePlane(i, n);
+                }
+            });
+        } else {
+            for (int n = 0; n < planes; n++) {
+                reslicePlane(i, n);
+            }
+        }
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    int volumeSize = argc > 1 ? atoi(argv[1]) : 256;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+    MRSimImageGenerator generator;
+    MRSimImageGenerator::Settings settings;
+    settings.width = volumeSize;
+    settings.height = volumeSize;
+    settings.slices = volumeSize;
+    settings.dtype = "float32";
+    settings.ringSize = 1;
+    if (!generator.configure(settings)) {
+        fprintf(stderr, "Invalid volume size %d\n", volumeSize);
+        return 1;
+    }
+    auto renderStart = Clock::now();
+    generator.render();
+    double renderMs = std::chrono::duration<double, std::milli>(Clock::now() - renderStart).count();
+
+    VolumeReslicer reslicer;
+    const double spacing[3] = {256.0 / volumeSize, 256.0 / volumeSize, 256.0 / volumeSize};
+    reslicer.setVolume(reinterpret_cast<const float*>(generator.getFrame(0)[0].data.constData()),
+                       volumeSize, volumeSize, volumeSize, spacing);
+
+    ThreadPool* pool = ThreadPool::shared();
+    printf("volume %d^3 rendered in %.0f ms, %d pool threads, AVX2 %s\n", volumeSize, renderMs,
+           pool->getThreadCount(), VolumeReslicer::hasAVX2() ? "yes" : "no");
+    printf("%-8s %12s %12s %12s\n", "output", "scalar(ms)", "avx2(ms)", "pool(ms)");
+
+    const int sizes[] = {256, 512};
+    for (int size : sizes) {
+        reslicer.setVectorized(false);
+        double scalar = run(reslicer, size, iterations, nullptr);
+        reslicer.setVectorized(true);
+        double vector = run(reslicer, size, iterations, nullptr);
+        double pooled = run(reslicer, size, iterations, pool);
+        printf("%4dx%-4d %11.3f %12.3f %12.3f\n", size, size, scalar, vector, pooled);
+        fflush(stdout);
+    }
+
+    printf("\n%-8s %16s %16s\n", "3 planes", "sequential(ms)", "concurrent(ms)");
+    for (int size : sizes) {
+        double sequential = runPlanes(reslicer, size, iterations, false);
+        double concurrent = runPlanes(reslicer, size, iterations, true);
+        printf("%4dx%-4d %15.3f %16.3f\n", size, size, sequential, concurrent);
+        fflush(stdout);
+    }
+    return 0;
+}
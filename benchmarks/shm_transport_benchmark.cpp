@@ -0,0 +1,195 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Loopback TCP vs. shared memory ring for large OpenIGTLink messages.
+//
+// For each payload size a writer thread sends IGTL-framed messages and a reader
+// thread consumes them, either through an igtl::ServerSocket/ClientSocket pair
+// on 127.0.0.1 or through a SharedMemoryRing. The writer stores a steady_clock
+// timestamp at the start of the payload.
+//   - latency   : one message in flight at a time; one-way latency p50/p99
+//   - throughput: back-to-back messages; MB/s at the reader
+// The TCP reader receives into its own buffer (as IGTLListener does); the ring
+// reader reads in place.
+//
+// Usage: shm_transport_benchmark [port] [iterations]
+
+#include "shm_ring.h"
+#include <igtlServerSocket.h>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    double p50;   // One-way latency (us)
+    double p99;
+    double mbps;  // Streaming throughput
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Framed message: 58-byte IGTL header followed by 'payload' bytes
+static std::vector<char> makeMessage(size_t payload) {
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    header->SetDeviceName("BENCH");
+    header->InitPack();
+    size_t headerSize = static_cast<size_t>(header->GetPackSize());
+    std::vector<char> buffer(headerSize + payload, 1);
+    std::memcpy(buffer.data(), header->GetPackPointer(), headerSize);
+    return buffer;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+}
+
+static Result runTcp(int port, size_t payload, int iterations) {
+    Result result = {0.0, 0.0, 0.0};
+    igtl::ServerSocket::Pointer server = igtl::ServerSocket::New();
+    if (server->CreateServer(port) < 0) {
+        return result;
+    }
+    std::vector<char> msg = makeMessage(payload);
+    const size_t headerSize = msg.size() - payload;
+    const int total = iterations * 2;  // Latency phase, then throughput phase
+
+    std::atomic<int> consumed(0);
+    std::vector<double> latencies;
+    double seconds = 0.0;
+
+    std::thread reader([&]() {
+        igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+        socket->ConnectToServer("127.0.0.1", port);
+        std::vector<char> buffer(msg.size());
+        Clock::time_point start;
+        for (int i = 0; i < total; i++) {
+            bool timeout = false;
+            socket->Receive(buffer.data(), buffer.size(), timeout);
+            int64_t stamp;
+            std::memcpy(&stamp, buffer.data() + headerSize, sizeof(stamp));
+            if (i < iterations) {
+                latencies.push_back((nowNs() - stamp) / 1000.0);
+            } else if (i == iterations) {
+                start = Clock::now();
+            }
+            consumed++;
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        socket->CloseSocket();
+    });
+
+    igtl::ClientSocket::Pointer socket = server->WaitForConnection(5000);
+    for (int i = 0; i < total && socket.IsNotNull(); i++) {
+        if (i < iterations) {
+            while (consumed < i) {
+                std::this_thread::yield();
+            }
+        }
+        int64_t stamp = nowNs();
+        std::memcpy(msg.data() + headerSize, &stamp, sizeof(stamp));
+        socket->Send(msg.data(), msg.size());
+    }
+    reader.join();
+    server->CloseSocket();
+
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    result.mbps = seconds > 0.0 ? (iterations - 1) * msg.size() / seconds / (1024.0 * 1024.0) : 0.0;
+    return result;
+}
+
+static Result runRing(size_t payload, int iterations) {
+    Result result = {0.0, 0.0, 0.0};
+    SharedMemoryRing tx;
+    SharedMemoryRing rx;
+    // Room for a few of the largest messages
+    if (!tx.create("/mrigtl_bench", std::max<size_t>(payload * 4, 1024 * 1024)) || !rx.open("/mrigtl_bench")) {
+        return result;
+    }
+    std::vector<char> msg = makeMessage(payload);
+    const size_t headerSize = msg.size() - payload;
+    const int total = iterations * 2;
+
+    std::atomic<int> consumed(0);
+    std::vector<double> latencies;
+    double seconds = 0.0;
+
+    std::thread reader([&]() {
+        Clock::time_point start;
+        for (int i = 0; i < total; i++) {
+            size_t size = 0;
+            const char* record = static_cast<const char*>(rx.peek(size, -1));
+            int64_t stamp;
+            std::memcpy(&stamp, record + headerSize, sizeof(stamp));
+            rx.release();
+            if (i < iterations) {
+                latencies.push_back((nowNs() - stamp) / 1000.0);
+            } else if (i == iterations) {
+                start = Clock::now();
+            }
+            consumed++;
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    });
+
+    for (int i = 0; i < total; i++) {
+        if (i < iterations) {
+            while (consumed < i) {
+                std::this_thread::yield();
+            }
+        }
+        int64_t stamp = nowNs();
+        std::memcpy(msg.data() + headerSize, &stamp, sizeof(stamp));
+        tx.write(msg.data(), msg.size(), -1);
+    }
+    reader.join();
+
+    result.p50 = percentile(latencies, 0.50);
+    result.p99 = percentile(latencies, 0.99);
+    result.mbps = seconds > 0.0 ? (iterations - 1) * msg.size() / seconds / (1024.0 * 1024.0) : 0.0;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 18960;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    const size_t sizes[] = {64 * 1024, 1024 * 1024, 8 * 1024 * 1024, 32 * 1024 * 1024};
+
+    printf("%-6s %10s %12s %12s %12s\n", "mode", "payload", "p50(us)", "p99(us)", "MB/s");
+    for (size_t payload : sizes) {
+        Result tcp = runTcp(port++, payload, iterations);
+        printf("%-6s %9zuK %12.1f %12.1f %12.1f\n", "tcp", payload / 1024, tcp.p50, tcp.p99, tcp.mbps);
+        Result shm = runRing(payload, iterations);
+        printf("%-6s %9zuK %12.1f %12.1f %12.1f\n", "shm", payload / 1024, shm.p50, shm.p99, shm.mbps);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Long-running soak of the simulator -> IGTL pipeline (Linux).
+//
+// An MRSimListener streams to an IGTLListener in server mode, and a local
+// sink connects as a client: it starts the sequence, receives the images and
+// sends a TRANSFORM PLANE_0 every 1/'transform-rate' s so that the scan plane
+// to image latency is exercised. Every 'interval' seconds a row is written to
+// the CSV with
+//   - the resident set size (/proc/self/statm),
+//   - operator new calls so far and allocations still live (counted by this
+//     executable), and the heap in use and free in the arenas (mallinfo2),
+//   - the SignalManagerProxy queue and the client send queues,
+//   - images sent, received by the sink and dropped,
+//   - send time and scan plane to image latency percentiles over the interval.
+// At the end, a column whose quarter means (after the first 10% of the run)
+// all increase and whose last quarter is more than 5% above the first is
+// reported as growing, and the exit code is 2.
+//
+// Usage: soak_benchmark [--duration S] [--interval S] [--csv FILE] [--port N]
+//            [--size N] [--fps F] [--source NAME] [--transform-rate HZ]
+
+#include "bridge_metrics.h"
+#include "igtl_listener.h"
+#include "mrsim_listener.h"
+#include "signal_manager.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <igtlStringMessage.h>
+#include <igtlTransformMessage.h>
+#include <malloc.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+// Allocation counters for the whole process (library and Qt included, as far
+// as they allocate with operator new)
+static std::atomic<quint64> allocations(0);
+static std::atomic<quint64> deallocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p) {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        std::free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+static std::atomic<long> imagesReceived(0);
+static std::atomic<int> listenersConnected(0);
+
+class Probe : public QObject {
+    Q_OBJECT
+
+public slots:
+    void onListenerConnected(const QString& className) {
+        Q_UNUSED(className);
+        listenersConnected++;
+    }
+};
+
+static long residentKB() {
+    long pages = 0;
+    long resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) {
+        return 0;
+    }
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void sink(int port, double transformRate, std::atomic<bool>& active) {
+    igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+    while (active && socket->ConnectToServer("127.0.0.1", port) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    while (active && listenersConnected < 2) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    igtl::StringMessage::Pointer start = igtl::StringMessage::New();
+    start->SetDeviceName("CMD");
+    start->SetString("START_SEQUENCE");
+    start->Pack();
+    socket->Send(start->GetPackPointer(), start->GetPackSize());
+
+    const qint64 period = static_cast<qint64>(1.0e9 / transformRate);
+    qint64 nextTransform = BridgeMetrics::now() + period;
+    int step = 0;
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    std::vector<char> body;
+    socket->SetReceiveTimeout(10);
+    while (active) {
+        if (BridgeMetrics::now() >= nextTransform) {
+            igtl::TransformMessage::Pointer transform = igtl::TransformMessage::New();
+            transform->SetDeviceName("PLANE_0");
+            igtl::Matrix4x4 matrix;
+            igtl::IdentityMatrix(matrix);
+            matrix[2][3] = static_cast<float>(step++ % 21 - 10);
+            transform->SetMatrix(matrix);
+            transform->Pack();
+            socket->Send(transform->GetPackPointer(), transform->GetPackSize());
+            nextTransform += period;
+        }
+
+        header->InitPack();
+        bool timeout = false;
+        int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+        if (r != header->GetPackSize()) {
+            if (r == 0 && timeout) {
+                continue;
+            }
+            break;
+        }
+        header->Unpack();
+        body.resize(header->GetPackBodySize());
+        if (!body.empty()) {
+            socket->SetReceiveTimeout(5000);
+            socket->Receive(body.data(), body.size(), timeout);
+            socket->SetReceiveTimeout(10);
+        }
+        if (std::strcmp(header->GetDeviceType(), "IMAGE") == 0) {
+            imagesReceived++;
+        }
+    }
+    socket->CloseSocket();
+}
+
+struct Column {
+    const char* name;
+    bool checkGrowth;  // Cumulative counters grow by design
+};
+
+static const Column columns[] = {
+    {"elapsed_s", false},       {"rss_kb", true},           {"allocations", false},
+    {"live_allocations", true}, {"heap_in_use_kb", true},   {"heap_free_kb", true},
+    {"proxy_queue", true},      {"client_queue", true},     {"images_sent", false},
+    {"images_received", false}, {"messages_dropped", false}, {"send_p50_ms", true},
+    {"send_p99_ms", true},      {"plane_p50_ms", true},     {"plane_p99_ms", true},
+};
+static const int ColumnCount = sizeof(columns) / sizeof(columns[0]);
+
+// Quarter means after the warm-up all increase, and by more than 5% in total
+static bool growing(const std::vector<std::vector<double>>& rows, int column, double& from, double& to) {
+    size_t first = rows.size() / 10;
+    size_t n = rows.size() - first;
+    if (n < 8) {
+        return false;
+    }
+    double means[4] = {};
+    for (int q = 0; q < 4; q++) {
+        size_t begin = first + n * q / 4;
+        size_t end = first + n * (q + 1) / 4;
+        for (size_t i = begin; i < end; i++) {
+            means[q] += rows[i][column];
+        }
+        means[q] /= (end - begin);
+    }
+    from = means[0];
+    to = means[3];
+    return means[0] < means[1] && means[1] < means[2] && means[2] < means[3] && means[3] > means[0] * 1.05;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption durationOption("duration", "Length of the soak in seconds.", "seconds", "3600");
+    QCommandLineOption intervalOption("interval", "Sampling interval in seconds.", "seconds", "10");
+    QCommandLineOption csvOption("csv", "CSV file for the samples.", "file", "soak.csv");
+    QCommandLineOption portOption("port", "Port of the IGTL listener (server mode).", "port", "18997");
+    QCommandLineOption sizeOption("size", "Image matrix (size x size).", "pixels", "256");
+    QCommandLineOption fpsOption("fps", "Simulator frame rate.", "fps", "20");
+    QCommandLineOption sourceOption("source", "Simulator image source ('ring' or 'reslice').", "name", "reslice");
+    QCommandLineOption rateOption("transform-rate", "TRANSFORMs per second from the sink.", "hz", "1");
+    parser.addOptions({durationOption, intervalOption, csvOption, portOption, sizeOption, fpsOption, sourceOption,
+                       rateOption});
+    parser.process(app);
+    const int port = parser.value(portOption).toInt();
+
+    FILE* csv = fopen(parser.value(csvOption).toLocal8Bit().constData(), "w");
+    if (!csv) {
+        fprintf(stderr, "Cannot write %s\n", parser.value(csvOption).toLocal8Bit().constData());
+        return 1;
+    }
+    for (int c = 0; c < ColumnCount; c++) {
+        fprintf(csv, "%s%s", columns[c].name, c + 1 < ColumnCount ? "," : "\n");
+    }
+
+    SignalManager signalManager;
+    Probe probe;
+    signalManager.connectSlot("listenerConnected", &probe, SLOT(onListenerConnected(QString)));
+
+    IGTLListener igtlListener;
+    QVariantMap igtlParam;
+    igtlParam["mode"] = "server";
+    igtlParam["port"] = QString::number(port);
+    igtlListener.connectSlots(&signalManager);
+    igtlListener.configure(igtlParam);
+
+    MRSimListener mrSimListener;
+    QVariantMap mrSimParam;
+    mrSimParam["width"] = parser.value(sizeOption).toInt();
+    mrSimParam["height"] = parser.value(sizeOption).toInt();
+    mrSimParam["fps"] = parser.value(fpsOption).toDouble();
+    mrSimParam["source"] = parser.value(sourceOption);
+    mrSimListener.connectSlots(&signalManager);
+    mrSimListener.configure(mrSimParam);
+
+    igtlListener.start();
+    mrSimListener.start();
+    std::atomic<bool> active(true);
+    std::thread sinkThread(sink, port, parser.value(rateOption).toDouble(), std::ref(active));
+
+    std::vector<std::vector<double>> rows;
+    BridgeMetrics::Snapshot last = BridgeMetrics::instance().snapshot();
+    const qint64 begin = last.time;
+    QTimer sampler;
+    QObject::connect(&sampler, &QTimer::timeout, [&]() {
+        BridgeMetrics::Snapshot now = BridgeMetrics::instance().snapshot();
+        typedef BridgeMetrics::Histogram Histogram;
+        quint64 allocated = allocations.load(std::memory_order_relaxed);
+        quint64 freed = deallocations.load(std::memory_order_relaxed);
+        double heapInUse = 0.0;
+        double heapFree = 0.0;
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 33)
+        struct mallinfo2 info = mallinfo2();
+        heapInUse = info.uordblks / 1024.0;
+        heapFree = info.fordblks / 1024.0;
+#endif
+#endif
+        std::vector<double> row = {
+            (now.time - begin) / 1.0e9,
+            static_cast<double>(residentKB()),
+            static_cast<double>(allocated),
+            static_cast<double>(allocated - freed),
+            heapInUse,
+            heapFree,
+            static_cast<double>(signalManager.getSignalManagerProxy()->getQueueSize()),
+            static_cast<double>(now.queuedMessages),
+            static_cast<double>(now.imagesSent),
+            static_cast<double>(imagesReceived.load()),
+            static_cast<double>(now.messagesDropped),
+            Histogram::percentile(now.sendTime, last.sendTime, 0.50),
+            Histogram::percentile(now.sendTime, last.sendTime, 0.99),
+            Histogram::percentile(now.planeLatency, last.planeLatency, 0.50),
+            Histogram::percentile(now.planeLatency, last.planeLatency, 0.99),
+        };
+        for (int c = 0; c < ColumnCount; c++) {
+            fprintf(csv, "%.10g%s", row[c], c + 1 < ColumnCount ? "," : "\n");
+        }
+        fflush(csv);
+        rows.push_back(row);
+        last = now;
+    });
+    sampler.start(static_cast<int>(parser.value(intervalOption).toDouble() * 1000));
+    QTimer::singleShot(static_cast<int>(parser.value(durationOption).toDouble() * 1000), &app, &QCoreApplication::quit);
+    app.exec();
+
+    active = false;
+    sinkThread.join();
+    mrSimListener.stop();
+    igtlListener.stop();
+    fclose(csv);
+
+    printf("%zu samples written to %s\n", rows.size(), parser.value(csvOption).toLocal8Bit().constData());
+    bool growth = false;
+    for (int c = 0; c < ColumnCount; c++) {
+        double from = 0.0;
+        double to = 0.0;
+        if (columns[c].checkGrowth && growing(rows, c, from, to)) {
+            printf("GROWTH: %s from %.6g to %.6g (mean of the first and last quarter)\n", columns[c].name, from, to);
+            growth = true;
+        }
+    }
+    if (!growth) {
+        printf("No monotonic growth\n");
+    }
+    return growth ? 2 : 0;
+}
+
+#include "soak_benchmark.moc"
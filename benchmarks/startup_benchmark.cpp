@@ -0,0 +1,95 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Startup time and memory of the GUI executable vs. the headless bridge.
+//
+// Runs each executable with --startup-report a number of times and reports
+// the medians of
+//   - the wall time from launch to exit (includes loading the libraries),
+//   - the time to the first pass of the event loop reported by the process,
+//   - the peak RSS reported by the process.
+// Without a display the GUI is started with '-platform offscreen'.
+//
+// Usage: startup_benchmark <mrigtl_lib> <mrigtl_bridge> [runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double median(std::vector<double> v) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+static void run(const std::string& command, int runs) {
+    std::vector<double> wall;
+    std::vector<double> reported;
+    std::vector<double> rss;
+    for (int i = 0; i < runs; i++) {
+        auto start = Clock::now();
+        FILE* pipe = popen((command + " --startup-report 2>/dev/null").c_str(), "r");
+        if (!pipe) {
+            fprintf(stderr, "Could not run %s\n", command.c_str());
+            return;
+        }
+        char line[512];
+        double ms = -1.0;
+        double mb = -1.0;
+        while (fgets(line, sizeof(line), pipe)) {
+            const char* report = std::strstr(line, " startup: ");
+            if (report) {
+                sscanf(report, " startup: %lf ms, peak RSS: %lf MB", &ms, &mb);
+            }
+        }
+        pclose(pipe);
+        wall.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        if (ms >= 0.0) {
+            reported.push_back(ms);
+            rss.push_back(mb);
+        }
+    }
+    if (reported.empty()) {
+        fprintf(stderr, "%s did not print a startup report\n", command.c_str());
+        return;
+    }
+    printf("%-40s %10.1f %12.1f %10.1f\n", command.c_str(), median(wall), median(reported), median(rss));
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <mrigtl_lib> <mrigtl_bridge> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 3 ? atoi(argv[3]) : 10;
+
+    std::string gui = argv[1];
+    if (!getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY")) {
+        gui += " -platform offscreen";
+    }
+
+    printf("%-40s %10s %12s %10s\n", "executable", "wall(ms)", "to loop(ms)", "RSS(MB)");
+    run(gui, runs);
+    run(argv[2], runs);
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Cost of one tracking sample on the simulator -> sendTrackingDataIGTL path.
+//
+// For 4 to 1024 coils, measures per sample:
+//   - 'generate': MRSimTrackingGenerator::sample() (the QVariantMap emitted
+//     by MRSimListener)
+//   - 'pack': the conversion done by IGTLListener::sendTrackingDataIGTL()
+//     (QVariantMap -> TrackingDataMessage) and Pack()
+// and the highest sample rate the two could sustain on one thread. Signal
+// delivery and the socket are not included.
+//
+// Usage: tracking_generator_benchmark [iterations]
+
+#include "mrsim_tracking_generator.h"
+#include <igtlTrackingDataMessage.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+static int pack(const QVariantMap& param) {
+    igtl::TrackingDataMessage::Pointer msg = igtl::TrackingDataMessage::New();
+    msg->SetDeviceName("MRTracking");
+    QVariantList coilList = param["coils"].toList();
+    for (const QVariant& coilVariant : coilList) {
+        QVariantMap coilData = coilVariant.toMap();
+        QVariantList posVar = coilData["position"].toList();
+        igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+        element->SetName(coilData["id"].toString().toStdString().c_str());
+        element->SetType(igtl::TrackingDataElement::TYPE_TRACKER);
+        element->SetPosition(posVar[0].toFloat(), posVar[1].toFloat(), posVar[2].toFloat());
+        msg->AddTrackingDataElement(element);
+    }
+    msg->Pack();
+    return msg->GetPackSize();
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+
+    printf("%6s %10s %14s %12s %12s %12s\n", "coils", "bytes", "generate(us)", "pack(us)", "total(us)", "max Hz");
+    const int counts[] = {4, 16, 64, 256, 1024};
+    for (int coils : counts) {
+        MRSimTrackingGenerator generator;
+        MRSimTrackingGenerator::Settings settings;
+        settings.coils = coils;
+        generator.configure(settings);
+
+        double generateUs = 0.0;
+        double packUs = 0.0;
+        int bytes = 0;
+        for (int i = 0; i < iterations; i++) {
+            auto t0 = Clock::now();
+            QVariantMap param = generator.sample(i * 0.001);
+            auto t1 = Clock::now();
+            bytes = pack(param);
+            auto t2 = Clock::now();
+            generateUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            packUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+        }
+        generateUs /= iterations;
+        packUs /= iterations;
+        printf("%6d %10d %14.1f %12.1f %12.1f %12.0f\n", coils, bytes, generateUs, packUs, generateUs + packUs,
+               1e6 / (generateUs + packUs));
+        fflush(stdout);
+    }
+    return 0;
+}
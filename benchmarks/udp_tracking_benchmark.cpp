@@ -0,0 +1,232 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Tracking latency under image load: TCP stream vs. UDP channel (loopback).
+//
+// An image thread sends multi-megabyte IMAGE messages over a TCP connection
+// as fast as the receiver reads them. A tracking thread sends one TDATA
+// message per millisecond, either
+//   - 'tcp': on the same TCP connection, interleaved between images, or
+//   - 'udp': through IGTLUdpChannel.
+// The message timestamp carries the steady_clock send time; the receiver
+// reports p50/p99/max tracking latency, the number of tracking samples
+// received, and the image throughput.
+//
+// Usage: udp_tracking_benchmark [port] [seconds] [imageMB]
+
+#include "igtl_udp_channel.h"
+#include <igtlServerSocket.h>
+#include <igtlClientSocket.h>
+#include <igtlImageMessage.h>
+#include <igtlTrackingDataMessage.h>
+#include <igtlTimeStamp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace mrigtlbridge;
+
+typedef std::chrono::steady_clock Clock;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void stamp(igtl::MessageBase* msg) {
+    int64_t ns = nowNs();
+    msg->SetTimeStamp(static_cast<unsigned int>(ns / 1000000000), static_cast<unsigned int>(ns % 1000000000));
+}
+
+static double latencyUs(igtl::MessageBase* msg) {
+    igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+    msg->GetTimeStamp(ts);
+    unsigned int sec = 0;
+    unsigned int nsec = 0;
+    ts->GetTimeStamp(&sec, &nsec);
+    return (nowNs() - (static_cast<int64_t>(sec) * 1000000000 + nsec)) / 1000.0;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    if (v.empty()) {
+        return 0.0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+}
+
+static igtl::TrackingDataMessage::Pointer makeTracking() {
+    igtl::TrackingDataMessage::Pointer msg = igtl::TrackingDataMessage::New();
+    msg->SetDeviceName("MRTracking");
+    for (int i = 0; i < 4; i++) {
+        igtl::TrackingDataElement::Pointer element = igtl::TrackingDataElement::New();
+        std::string name = "coil" + std::to_string(i);
+        element->SetName(name.c_str());
+        element->SetType(igtl::TrackingDataElement::TYPE_3D);
+        element->SetPosition(1.0f * i, 2.0f, 3.0f);
+        msg->AddTrackingDataElement(element);
+    }
+    return msg;
+}
+
+static void run(bool udp, int port, double seconds, int imageMB) {
+    igtl::ServerSocket::Pointer server = igtl::ServerSocket::New();
+    if (server->CreateServer(port) < 0) {
+        fprintf(stderr, "Could not create a server on port %d\n", port);
+        return;
+    }
+
+    IGTLUdpChannel udpRx;
+    IGTLUdpChannel udpTx;
+    // The receiver accepts datagrams only from its destinations
+    if (udp && (!udpRx.open(0) || !udpTx.open(0) || udpTx.addDestination("127.0.0.1", udpRx.getLocalPort()) < 0 ||
+                udpRx.addDestination("127.0.0.1", udpTx.getLocalPort()) < 0)) {
+        fprintf(stderr, "Could not open the UDP channel\n");
+        return;
+    }
+
+    std::atomic<bool> active(true);
+    std::vector<double> latencies;
+    std::mutex latencyMutex;
+    std::atomic<long> imageBytes(0);
+
+    // Receiver: one TCP stream (images, and tracking in 'tcp' mode)
+    std::thread tcpReader([&]() {
+        igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+        socket->ConnectToServer("127.0.0.1", port);
+        socket->SetReceiveTimeout(100);
+        igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+        while (active) {
+            header->InitPack();
+            bool timeout = true;
+            int r = socket->Receive(header->GetPackPointer(), header->GetPackSize(), timeout);
+            if (r != header->GetPackSize()) {
+                if (r == 0 && timeout) {
+                    continue;
+                }
+                break;
+            }
+            header->Unpack();
+            if (std::strcmp(header->GetDeviceType(), "TDATA") == 0) {
+                double latency = latencyUs(header);
+                std::lock_guard<std::mutex> lock(latencyMutex);
+                latencies.push_back(latency);
+            }
+            igtl::MessageBase::Pointer body = igtl::MessageBase::New();
+            body->Copy(header);
+            body->AllocatePack();
+            timeout = false;
+            socket->Receive(body->GetPackBodyPointer(), body->GetPackBodySize(), timeout);
+            imageBytes += body->GetPackBodySize();
+        }
+        socket->CloseSocket();
+    });
+
+    std::thread udpReader;
+    if (udp) {
+        udpReader = std::thread([&]() {
+            while (active) {
+                for (const auto& msg : udpRx.receiveLatest(10)) {
+                    double latency = latencyUs(msg);
+                    std::lock_guard<std::mutex> lock(latencyMutex);
+                    latencies.push_back(latency);
+                }
+            }
+        });
+    }
+
+    igtl::ClientSocket::Pointer socket = server->WaitForConnection(5000);
+    if (socket.IsNull()) {
+        active = false;
+        tcpReader.join();
+        return;
+    }
+    std::mutex sendMutex;  // A TCP stream carries one message at a time
+
+    std::thread imageSender([&]() {
+        int dim = 256;
+        int slices = std::max(1, imageMB * 1024 * 1024 / (dim * dim * 2));
+        igtl::ImageMessage::Pointer image = igtl::ImageMessage::New();
+        image->SetDimensions(dim, dim, slices);
+        image->SetScalarType(igtl::ImageMessage::TYPE_INT16);
+        image->SetDeviceName("MRImage");
+        image->AllocateScalars();
+        std::memset(image->GetScalarPointer(), 0, image->GetImageSize());
+        image->Pack();
+        while (active) {
+            std::lock_guard<std::mutex> lock(sendMutex);
+            socket->Send(image->GetPackPointer(), image->GetPackSize());
+        }
+    });
+
+    long sent = 0;
+    igtl::TrackingDataMessage::Pointer tracking = makeTracking();
+    auto start = Clock::now();
+    auto next = start;
+    while (Clock::now() - start < std::chrono::duration<double>(seconds)) {
+        stamp(tracking);
+        tracking->Pack();
+        if (udp) {
+            udpTx.send(tracking);
+        } else {
+            std::lock_guard<std::mutex> lock(sendMutex);
+            socket->Send(tracking->GetPackPointer(), tracking->GetPackSize());
+        }
+        sent++;
+        next += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    active = false;
+    imageSender.join();
+    socket->CloseSocket();
+    tcpReader.join();
+    if (udpReader.joinable()) {
+        udpReader.join();
+    }
+    server->CloseSocket();
+
+    std::lock_guard<std::mutex> lock(latencyMutex);
+    size_t received = latencies.size();
+    double p50 = percentile(latencies, 0.50);
+    double p99 = percentile(latencies, 0.99);
+    double max = latencies.empty() ? 0.0 : latencies.back();
+    printf("%-4s %8ld %9zu %10.1f %10.1f %10.1f %10.1f\n", udp ? "udp" : "tcp", sent, received, p50, p99, max,
+           imageBytes / elapsed / (1024.0 * 1024.0));
+    if (udp) {
+        IGTLUdpChannel::Statistics stats = udpRx.getStatistics();
+        printf("     udp: received %llu, stale %llu, superseded %llu, lost %llu\n",
+               static_cast<unsigned long long>(stats.received), static_cast<unsigned long long>(stats.stale),
+               static_cast<unsigned long long>(stats.superseded), static_cast<unsigned long long>(stats.lost));
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? atoi(argv[1]) : 18970;
+    double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+    int imageMB = argc > 3 ? atoi(argv[3]) : 8;
+
+    printf("%-4s %8s %9s %10s %10s %10s %10s\n", "mode", "sent", "received", "p50(us)", "p99(us)", "max(us)", "img MB/s");
+    run(false, port, seconds, imageMB);
+    run(true, port + 1, seconds, imageMB);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QtGlobal>
+#include <atomic>
+
+namespace mrigtlbridge {
+
+// Process-wide performance counters (see PerformancePanel).
+//
+// The listeners only do relaxed atomic increments on their send and receive
+// paths; there are no locks and no allocation. A reader takes a Snapshot at
+// its own rate and derives rates and percentiles from the difference between
+// two snapshots, so the counters never need to be reset.
+class BridgeMetrics {
+public:
+    // Durations in log-scale buckets: four per octave from 1 us to about a
+    // minute (bucket 0 holds anything below 1 us)
+    class Histogram {
+    public:
+        static const int BucketCount = 108;
+
+        MRIGTL_LIB_EXPORT void record(qint64 ns);
+        MRIGTL_LIB_EXPORT void read(quint64 counts[BucketCount]) const;
+
+        // Percentile p (0 to 1) in ms of the durations recorded between two
+        // reads ('before' may be all zeros); 0 if there were none
+        MRIGTL_LIB_EXPORT static double percentile(const quint64* now, const quint64* before, double p);
+        // Lower bound of a bucket in ms
+        MRIGTL_LIB_EXPORT static double lowerBound(int bucket);
+
+    private:
+        std::atomic<quint64> buckets[BucketCount] = {};
+    };
+
+    struct Snapshot {
+        qint64 time = 0;                   // ns (steady clock)
+        quint64 imagesSent = 0;
+        quint64 imageBytesSent = 0;
+        quint64 trackingSent = 0;
+        quint64 transformsReceived = 0;
+        quint64 messagesDropped = 0;       // By the send queues and transports (not sent)
+        qint64 queuedMessages = 0;         // In all client send queues (server mode)
+        quint64 deltaFrames = 0;           // Images sent as subvolume updates ('deltaUpdates')
+        quint64 deltaKeyframes = 0;        // Images sent in full while 'deltaUpdates' is on
+        quint64 deltaBytesSaved = 0;       // Image bytes not sent thanks to the updates
+        quint64 imagesCompressed = 0;      // Images sent as COMP_IMAGE
+        quint64 compressInBytes = 0;       // IMAGE bytes given to the compression
+        quint64 compressOutBytes = 0;      // Bytes sent for them (compressed, or as they were)
+        quint64 sendTime[Histogram::BucketCount] = {};      // Pack and send/enqueue of an image
+        quint64 planeLatency[Histogram::BucketCount] = {};  // TRANSFORM received to image sent
+        quint64 diffTime[Histogram::BucketCount] = {};      // Comparison with the previous frame
+        quint64 compressTime[Histogram::BucketCount] = {};  // Compression of an image
+    };
+
+    MRIGTL_LIB_EXPORT static BridgeMetrics& instance();
+
+    // Steady clock in ns, for the durations recorded here
+    MRIGTL_LIB_EXPORT static qint64 now();
+
+    MRIGTL_LIB_EXPORT Snapshot snapshot() const;
+
+    std::atomic<quint64> imagesSent{0};
+    std::atomic<quint64> imageBytesSent{0};
+    std::atomic<quint64> trackingSent{0};
+    std::atomic<quint64> transformsReceived{0};
+    std::atomic<quint64> messagesDropped{0};
+    std::atomic<qint64> queuedMessages{0};
+    std::atomic<quint64> deltaFrames{0};
+    std::atomic<quint64> deltaKeyframes{0};
+    std::atomic<quint64> deltaBytesSaved{0};
+    std::atomic<quint64> imagesCompressed{0};
+    std::atomic<quint64> compressInBytes{0};
+    std::atomic<quint64> compressOutBytes{0};
+    Histogram sendTime;
+    Histogram planeLatency;
+    Histogram diffTime;
+    Histogram compressTime;
+};
+
+} // namespace mrigtlbridge
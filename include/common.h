@@ -23,7 +23,8 @@ namespace mrigtlbridge {
 // Signal names and their parameter types
 extern std::map<std::string, std::string> SignalNames;
 
-// Data type table for OpenIGTLink
+// Data type table for OpenIGTLink ({IGTL type, bytes} by name). Kept for
+// existing callers; the library uses ScalarType (scalar_type.h).
 extern std::map<std::string, std::vector<int>> DataTypeTable;
 
 } // namespace mrigtlbridge
\ No newline at end of file
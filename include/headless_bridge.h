@@ -0,0 +1,76 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+
+namespace mrigtlbridge {
+
+class SignalManager;
+class IGTLListener;
+class MRSimListener;
+
+// IGTL and MR simulator listeners without a GUI (QtCore only).
+//
+// Does what IGTLWidget and MRSimWidget do when their buttons are pressed:
+// creates, configures and starts both listeners on one SignalManager, and
+// prints their console text to stdout. Optionally starts the sequence once
+// both listeners are up. Emits finished() when a listener terminates.
+class MRIGTL_QT_EXPORT HeadlessBridge : public QObject {
+    Q_OBJECT
+
+public:
+    MRIGTL_LIB_EXPORT explicit HeadlessBridge(QObject* parent = nullptr);
+    MRIGTL_LIB_EXPORT ~HeadlessBridge() override;
+
+    // Listener parameters (see IGTLListener and MRSimListener for the keys)
+    MRIGTL_LIB_EXPORT void setIGTLParameters(const QVariantMap& param) { igtlParameter = param; }
+    MRIGTL_LIB_EXPORT void setMRSimParameters(const QVariantMap& param) { mrSimParameter = param; }
+    // Start the sequence as soon as both listeners are connected (default)
+    MRIGTL_LIB_EXPORT void setAutoStart(bool enable) { autoStart = enable; }
+    // Do not print console text
+    MRIGTL_LIB_EXPORT void setQuiet(bool enable) { quiet = enable; }
+
+    MRIGTL_LIB_EXPORT void start();
+    MRIGTL_LIB_EXPORT void stop();
+
+signals:
+    void finished();
+
+private slots:
+    void onConsoleTextIGTL(const QString& text);
+    void onConsoleTextMR(const QString& text);
+    void onListenerConnected(const QString& className);
+    void onListenerTerminated(const QString& className);
+
+private:
+    void print(const char* source, const QString& text);
+
+    SignalManager* signalManager;
+    IGTLListener* igtlListener;
+    MRSimListener* mrSimListener;
+    QVariantMap igtlParameter;
+    QVariantMap mrSimParameter;
+    QSet<QString> connected;
+    bool autoStart;
+    bool quiet;
+    bool stopping;
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include "igtl_stream_limiter.h"
+#include "image_reduction.h"
+#include <QThread>
+#include <QString>
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <cstdint>
+
+namespace mrigtlbridge {
+
+// A client connected to IGTLListener in server mode. Outbound messages are
+// packed once by the listener and shared by reference (igtl smart pointer)
+// across the send queues of all sessions; each session drains its own queue
+// on a dedicated thread so a slow client cannot stall the others.
+class MRIGTL_QT_EXPORT IGTLClientSession : public QThread {
+    Q_OBJECT
+
+public:
+    // What to do when the send queue is full
+    enum SlowConsumerPolicy {
+        DropOldest,  // Discard the oldest queued message (latest data wins)
+        DropNewest,  // Discard the message being enqueued
+        Block,       // The producer waits for the queue to drain (waitForSpace(),
+                     // bounded by blockTimeout), then the newest is discarded
+        Disconnect   // Close the connection to the client
+    };
+
+    // 'peerAddress': numeric address of the client, as recorded on accept
+    MRIGTL_LIB_EXPORT IGTLClientSession(igtl::ClientSocket::Pointer socket, const QString& name,
+                                        const QString& peerAddress = QString(), QObject* parent = nullptr);
+    MRIGTL_LIB_EXPORT ~IGTLClientSession();
+
+    MRIGTL_LIB_EXPORT void setPolicy(SlowConsumerPolicy policy) { slowConsumerPolicy = policy; }
+    MRIGTL_LIB_EXPORT SlowConsumerPolicy getPolicy() const { return slowConsumerPolicy; }
+    MRIGTL_LIB_EXPORT void setMaxQueueDepth(int depth) { maxQueueDepth = depth > 0 ? depth : 1; }
+    MRIGTL_LIB_EXPORT void setBlockTimeout(int msec) { blockTimeout = msec; }
+
+    // Queue a packed message for sending. Never waits. Returns false if the
+    // message was dropped.
+    MRIGTL_LIB_EXPORT bool enqueue(const igtl::MessageBase::Pointer& msg);
+
+    // Block policy: wait until the queue has room, at most until 'start' +
+    // blockTimeout. Must be called without any lock that the sender or the
+    // other producers need. Returns false on timeout.
+    MRIGTL_LIB_EXPORT bool waitForSpace(std::chrono::steady_clock::time_point start);
+
+    // Stop the sender thread and close the socket
+    MRIGTL_LIB_EXPORT void close();
+
+    MRIGTL_LIB_EXPORT bool isAlive() const { return alive; }
+    MRIGTL_LIB_EXPORT igtl::ClientSocket::Pointer getSocket() const { return socket; }
+    MRIGTL_LIB_EXPORT QString getPeerName() const { return peerName; }
+    // Numeric address of the connected client (empty if unknown)
+    MRIGTL_LIB_EXPORT QString getPeerAddress() const { return peerAddress; }
+    MRIGTL_LIB_EXPORT int getQueueDepth();
+    MRIGTL_LIB_EXPORT uint64_t getSentCount() const { return sentCount; }
+    MRIGTL_LIB_EXPORT uint64_t getDroppedCount() const { return droppedCount; }
+
+    // Rate limiter for the stream of the given device type (STT_/STP_ requests).
+    // Used by the listener thread only.
+    MRIGTL_LIB_EXPORT IGTLStreamLimiter& getStream(const std::string& deviceType) { return streams[deviceType]; }
+    MRIGTL_LIB_EXPORT std::map<std::string, IGTLStreamLimiter>& getStreams() { return streams; }
+
+    // Crop/downsampling of the images sent to this client (IMAGE_REDUCTION
+    // request); the listener's default applies until the client sends one.
+    // Used with the listener's send lock held.
+    MRIGTL_LIB_EXPORT void setImageReduction(const ImageReduction& reduction) { imageReduction = reduction; customReduction = true; }
+    MRIGTL_LIB_EXPORT void clearImageReduction() { imageReduction = ImageReduction(); customReduction = false; }
+    MRIGTL_LIB_EXPORT bool hasImageReduction() const { return customReduction; }
+    MRIGTL_LIB_EXPORT const ImageReduction& getImageReduction() const { return imageReduction; }
+
+    // Images as COMP_IMAGE (IMAGE_COMPRESSION request); the listener's
+    // default applies until the client sends one. Same locking as above.
+    MRIGTL_LIB_EXPORT void setImageCompression(bool enable) { imageCompression = enable; customCompression = true; }
+    MRIGTL_LIB_EXPORT void clearImageCompression() { imageCompression = false; customCompression = false; }
+    MRIGTL_LIB_EXPORT bool hasImageCompression() const { return customCompression; }
+    MRIGTL_LIB_EXPORT bool getImageCompression() const { return imageCompression; }
+
+    // IGTLUdpChannel destination for the client's TDATA/TRANSFORM (UDP_TRACKING
+    // request), or -1 to send them over TCP. Same locking as above.
+    MRIGTL_LIB_EXPORT void setUdpDestination(int id) { udpDestination = id; }
+    MRIGTL_LIB_EXPORT int getUdpDestination() const { return udpDestination; }
+
+    MRIGTL_LIB_EXPORT static SlowConsumerPolicy policyFromString(const QString& name);
+
+protected:
+    void run() override;
+
+private:
+    igtl::ClientSocket::Pointer socket;
+    QString peerName;
+    QString peerAddress;
+
+    std::deque<igtl::MessageBase::Pointer> sendQueue;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::atomic<bool> stopRequested;
+    std::atomic<bool> alive;
+
+    std::atomic<SlowConsumerPolicy> slowConsumerPolicy;
+    int maxQueueDepth;
+    int blockTimeout; // Milliseconds
+
+    std::atomic<uint64_t> sentCount;
+    std::atomic<uint64_t> droppedCount;
+
+    std::map<std::string, IGTLStreamLimiter> streams;
+
+    ImageReduction imageReduction;
+    bool customReduction;
+    bool imageCompression;
+    bool customCompression;
+    int udpDestination;
+};
+
+} // namespace mrigtlbridge
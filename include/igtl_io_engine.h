@@ -0,0 +1,159 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <igtlMessageBase.h>
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+namespace mrigtlbridge {
+
+// Single-threaded OpenIGTLink I/O engine (Linux epoll).
+//
+// One thread owns any number of client and server sockets. Incoming data is
+// parsed incrementally (header, then body) on non-blocking sockets and each
+// complete message is dispatched to the handler registered for its device
+// type. Outgoing messages must be packed by the caller; the engine keeps a
+// reference to the message until all of its bytes have been written.
+//
+// Handlers are called on the engine thread and must not block. send(),
+// broadcast(), connectTo(), listenOn() and close() may be called from any thread.
+class IGTLIOEngine {
+public:
+    typedef int ConnectionId;
+    typedef std::function<void(ConnectionId, igtl::MessageBase::Pointer)> MessageHandler;
+    typedef std::function<void(ConnectionId, bool)> ConnectionHandler; // (id, connected)
+
+    struct Statistics {
+        uint64_t messagesReceived = 0;
+        uint64_t messagesSent = 0;
+        uint64_t bytesReceived = 0;
+        uint64_t bytesSent = 0;
+        uint64_t messagesDropped = 0;  // Discarded because a send queue was full
+        uint64_t wakeups = 0;  // Number of returns from epoll_wait()
+    };
+
+    MRIGTL_LIB_EXPORT IGTLIOEngine();
+    MRIGTL_LIB_EXPORT ~IGTLIOEngine();
+
+    // Process-wide engine shared by listeners that opt in (started on first use)
+    MRIGTL_LIB_EXPORT static IGTLIOEngine* shared();
+
+    MRIGTL_LIB_EXPORT bool start();
+    MRIGTL_LIB_EXPORT void stop();
+    MRIGTL_LIB_EXPORT bool isRunning() const { return running; }
+
+    // Handler for messages of the given device type. An empty type sets the
+    // fallback handler. A handler set for a single connection takes precedence;
+    // connections accepted by a server inherit the handler of the server.
+    MRIGTL_LIB_EXPORT void setMessageHandler(const std::string& deviceType, MessageHandler handler);
+    MRIGTL_LIB_EXPORT void setConnectionMessageHandler(ConnectionId id, MessageHandler handler);
+    MRIGTL_LIB_EXPORT void setConnectionHandler(ConnectionHandler handler);
+
+    // Handlers and send queue limit of a single connection. They are in place
+    // before the engine polls the socket, so no message or close is missed.
+    struct ConnectionSettings {
+        MessageHandler messageHandler;        // Takes precedence over setMessageHandler()
+        ConnectionHandler connectionHandler;  // Called instead of setConnectionHandler()'s
+        int maxQueueDepth = -1;               // -1: setMaxQueueDepth()
+    };
+
+    // Returns the new connection ID, or -1 on failure
+    MRIGTL_LIB_EXPORT ConnectionId connectTo(const std::string& host, int port);
+    MRIGTL_LIB_EXPORT ConnectionId connectTo(const std::string& host, int port, const ConnectionSettings& settings);
+    MRIGTL_LIB_EXPORT ConnectionId listenOn(int port);
+    MRIGTL_LIB_EXPORT void close(ConnectionId id);
+    // Close a connection and drop its handlers. Returns once none of them is
+    // running; they are not called again.
+    MRIGTL_LIB_EXPORT void detach(ConnectionId id);
+    MRIGTL_LIB_EXPORT bool isConnected(ConnectionId id);
+
+    // Maximum number of queued messages per connection (0: unlimited), unless
+    // set for the connection. When the queue is full the oldest message that
+    // has not started going out is dropped.
+    MRIGTL_LIB_EXPORT void setMaxQueueDepth(int depth) { maxQueueDepth = depth; }
+
+    // Queue a packed message. Returns false if the connection does not exist.
+    MRIGTL_LIB_EXPORT bool send(ConnectionId id, const igtl::MessageBase::Pointer& msg);
+    // Queue a packed message on every accepted/connected socket (not listeners)
+    MRIGTL_LIB_EXPORT int broadcast(const igtl::MessageBase::Pointer& msg);
+
+    MRIGTL_LIB_EXPORT int getConnectionCount();
+    MRIGTL_LIB_EXPORT Statistics getStatistics();
+
+private:
+    struct Connection {
+        ConnectionId id = -1;
+        int fd = -1;
+        bool listening = false;
+        ConnectionId parent = -1;   // Server connection that accepted this one
+        int maxQueueDepth = -1;     // -1: the engine's
+
+        // Inbound parser state (engine thread only)
+        igtl::MessageBase::Pointer inMsg;
+        bool inHeaderDone = false;
+        size_t inReceived = 0;
+        size_t inBodySize = 0;
+
+        // Outbound queue (guarded by 'mutex')
+        std::deque<igtl::MessageBase::Pointer> outQueue;
+        size_t outOffset = 0;
+        bool writeArmed = false;
+    };
+
+    void run();
+    ConnectionId addConnection(int fd, bool listening, ConnectionId parent, const ConnectionSettings& settings);
+    void handleAccept(Connection* conn);
+    bool handleReadable(Connection* conn, std::vector<igtl::MessageBase::Pointer>& complete);
+    bool flushOutput(Connection* conn);
+    void updateWriteInterest(Connection* conn, bool enable);
+    void removeConnection(ConnectionId id);
+    void wake();
+    void dispatch(ConnectionId id, const igtl::MessageBase::Pointer& msg);
+    void enqueueLocked(Connection* conn, const igtl::MessageBase::Pointer& msg);
+
+    int epollFd;
+    int wakeFd;
+    std::thread thread;
+    std::atomic<bool> running;
+
+    std::mutex mutex;
+    std::unordered_map<ConnectionId, std::unique_ptr<Connection>> connections;
+    std::vector<ConnectionId> pendingClose;
+    ConnectionId nextId;
+    std::atomic<int> maxQueueDepth;
+
+    // Held while a handler runs, so that detach() can wait for it
+    std::recursive_mutex dispatchMutex;
+    std::mutex handlerMutex;
+    std::map<std::string, MessageHandler> handlers;
+    std::unordered_map<ConnectionId, MessageHandler> connectionHandlers;
+    ConnectionHandler connectionHandler;
+    std::unordered_map<ConnectionId, ConnectionHandler> connectionStateHandlers;
+
+    Statistics stats;
+};
+
+} // namespace mrigtlbridge
@@ -16,20 +16,57 @@
 
 #include "mrigtl_lib_export.h"
 #include "listener_base.h"
+#include "image_compression.h"
+#include "image_delta_encoder.h"
+#include "image_reduction.h"
+#include "igtl_client_session.h"
+#include "igtl_server_socket.h"
 #include <QMutex>
 #include <QVector>
 #include <QString>
 #include <igtlClientSocket.h>
+#include <igtlServerSocket.h>
 #include <igtlTransformMessage.h>
 #include <igtlImageMessage.h>
 #include <igtlStringMessage.h>
 #include <igtlMessageBase.h>
 #include <array>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <cstdint>
 
 namespace mrigtlbridge {
 
+class IGTLIOEngine;
+class SharedMemoryRing;
+class IGTLUdpChannel;
+
+// Image for IGTLListener::sendImage(). 'data' holds the voxels of the whole
+// image (components interleaved, x fastest) and is only read during the call.
+struct ImageView {
+    const void* data = nullptr;
+    size_t size = 0;                    // Bytes; must match the dimensions and type
+    int dimension[3] = {1, 1, 1};
+    double spacing[3] = {1.0, 1.0, 1.0};
+    int scalarType = 5;                 // IGTL scalar type (see ScalarType in scalar_type.h)
+    int numberOfComponents = 1;
+    int endian = 2;                     // 1: big; 2: little
+    double matrix[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+    std::string name = "image";
+    qint64 timestamp = 0;               // ms since the epoch, for the header and IMAGE_TIMESTAMP; 0: now, no IMAGE_TIMESTAMP
+};
+
+// One element of IGTLListener::sendTracking()
+struct CoilSample {
+    std::string id;
+    float position[3];                  // Patient coordinate system (mm)
+};
+
 class IGTLListener : public ListenerBase {
     Q_OBJECT
 
@@ -40,6 +77,25 @@ public:
     MRIGTL_LIB_EXPORT void connectSlots(SignalManager* signalManager) override;
     MRIGTL_LIB_EXPORT void disconnectSlots() override;
 
+    // Typed alternatives to the 'sendImageIGTL' and 'sendTrackingDataIGTL'
+    // signals for applications that link the library. They may be called from
+    // any thread while the listener is running: the message is built and packed
+    // in the calling thread, and the send is serialized with the listener's own
+    // sends. The call returns once the message is queued (server mode, I/O
+    // engine) or written (client mode, shared memory, UDP). Returns false if
+    // there is no connection, the message could not be sent, or the image is
+    // invalid (reported on 'consoleTextIGTL'). Successful sends are not reported.
+    MRIGTL_LIB_EXPORT bool sendImage(const ImageView& image);
+    MRIGTL_LIB_EXPORT bool sendTracking(const CoilSample* coils, size_t count, const char* name = "MRTracking");
+    template <typename Container>
+    bool sendTracking(const Container& coils, const char* name = "MRTracking") {
+        return sendTracking(coils.data(), coils.size(), name);
+    }
+
+    // The 'updateScanPlane' parameters ('plane_id', 'matrix') for a TRANSFORM
+    // message received from the scanner side
+    MRIGTL_LIB_EXPORT static QVariantMap scanPlaneParam(const igtl::Matrix4x4& matrix, const std::string& deviceName);
+
 signals:
     void closeSocketSignal();
     void transformReceivedSignal(const QVariantMap& matrix, const QVariantMap& param);
@@ -60,10 +116,108 @@ protected:
 
 private:
     bool connect(const QString& ip, int port);
+    bool listen(int port);
+    bool isServerMode() const { return serverSocket.IsNotNull(); }
+    bool isConnected();
+    void acceptClients();
+    void closeClients();
+    // Receive and handle one message. Returns 0 on timeout, -1 if the peer closed the connection.
+    int receiveMessage(igtl::ClientSocket::Pointer socket, IGTLClientSession* session = nullptr);
+    void handleMessage(igtl::MessageBase::Pointer msg, IGTLClientSession* session = nullptr);
+    bool attachToIOEngine(const QString& ip, int port);
+    bool openSharedMemory(const QString& name, int sizeMB);
+    bool openUdpChannel(const QString& ip, int port);
+    void closeSharedMemory();
+    int receiveSharedMemoryMessage();
+    void detachFromIOEngine();
+    // Handle the messages received by the I/O engine. Returns false once the
+    // engine has closed the connection.
+    bool receiveIOEngineMessages();
+    void flushPendingTransform();
+    // Wait, with sendMutex released, for the clients with the Block policy
+    // whose queue is full. Called by the producers before they send.
+    void waitForSlowClients();
+    // 'delta': the subvolume update for 'msg' (an IMAGE), if there is one
+    int sendMessage(igtl::MessageBase* msg, igtl::MessageBase* delta = nullptr);
+    // 'msg' as the client (or the peer, if 'session' is null) gets it: an IMAGE is
+    // cropped/downsampled as requested, or replaced by 'delta' if the client takes
+    // every image in full, and compressed for clients that asked for COMP_IMAGE.
+    // Clients asking for the same share one message through 'reduced' (a map per
+    // image).
+    igtl::MessageBase::Pointer forClient(igtl::MessageBase* msg, IGTLClientSession* session,
+                                         std::map<QString, igtl::MessageBase::Pointer>& reduced,
+                                         igtl::MessageBase* delta = nullptr);
+    // An IMAGE message with the scalars allocated, from ImageBufferPool if 'bufferPool' is 1
+    igtl::ImageMessage::Pointer newImageMessage(const int dimension[3], int scalarType, int numberOfComponents);
+    // Pack and send an image stamped with 'timestampMs' (and an IMAGE_TIMESTAMP
+    // message) if timestampMs > 0
+    int sendImageMessage(igtl::ImageMessage::Pointer imageMsg, qint64 timestampMs);
+    int sendToPeer(igtl::MessageBase* msg);
+    // Queue 'msg' for a client, or send it over UDP if the client asked for
+    // UDP_TRACKING. Returns false if the message was dropped.
+    bool sendToSession(IGTLClientSession* session, igtl::MessageBase* msg);
+    int reply(igtl::MessageBase* msg, IGTLClientSession* session);
+    bool isUdpMessage(igtl::MessageBase* msg);
+    void flushStreams();
+    void onStreamControl(igtl::MessageBase::Pointer msg, IGTLClientSession* session);
     int onReceiveTransform(igtl::TransformMessage::Pointer transMsg);
-    void onReceiveString(igtl::StringMessage::Pointer stringMsg);
+    void onReceiveString(igtl::StringMessage::Pointer stringMsg, IGTLClientSession* session = nullptr);
 
     igtl::ClientSocket::Pointer clientServer;
+
+    // Server mode: one session (with its own send queue) per connected client
+    IGTLServerSocket::Pointer serverSocket;
+    // Shared so that a producer can wait for a client outside sendMutex
+    std::vector<std::shared_ptr<IGTLClientSession>> sessions;
+    int sessionCount;
+
+    // Set when the connection is owned by the shared epoll engine (parameter 'ioEngine')
+    IGTLIOEngine* ioEngine;
+    int ioConnection;
+    // Filled on the engine thread and drained by process(), so that messages
+    // are handled on the same thread as with a socket of our own
+    std::mutex ioInboxMutex;
+    std::deque<igtl::MessageBase::Pointer> ioInbox;
+    bool ioClosed;
+
+    // Shared memory rings (parameter 'transport' = 'shm')
+    std::unique_ptr<SharedMemoryRing> shmTx;
+    std::unique_ptr<SharedMemoryRing> shmRx;
+
+    // Rate limiters requested by the peer in client mode and over shared memory
+    // (per-client limiters live in the sessions, also for their UDP tracking)
+    std::map<std::string, IGTLStreamLimiter> peerStreams;
+    igtl::MessageBase::Pointer lastImageMsg;
+
+    // Image reduction for clients that have not asked for their own
+    // (parameter 'imageReduction'), and the one asked for by the peer
+    ImageReduction defaultReduction;
+    ImageReduction peerReduction;
+    // The same for COMP_IMAGE (parameter 'imageCompression')
+    bool defaultCompression;
+    bool peerCompression;
+
+    // Subvolume updates (parameter 'deltaUpdates'); restarted with keyframes
+    // when a client connects or a queued message is dropped
+    ImageDeltaEncoder deltaEncoder;
+    quint64 deltaDropCount;
+
+    // Datagram channel for TDATA/TRANSFORM (parameter 'udpTracking'). In server
+    // mode only the clients that asked for it (UDP_TRACKING) are destinations.
+    std::unique_ptr<IGTLUdpChannel> udpChannel;
+
+    // Copies of the image parameters, made by initialize(): the parameter map
+    // must not be read from the threads that call sendImage(). The first two
+    // are read without the send lock.
+    std::atomic<bool> useBufferPool;       // 'bufferPool'
+    std::atomic<qint64> parallelCopyBytes; // 'parallelCopyMB'
+    bool deltaUpdates;                     // 'deltaUpdates'
+    bool sendTimestamp;                    // 'sendTimestamp'
+
+    // Serializes sends (and changes to the connection and session list) between
+    // the listener thread, the thread that runs the slots and the callers of
+    // sendImage()/sendTracking()
+    std::recursive_mutex sendMutex;
     
     QVector<QByteArray> imageQueue;
     QVector<double> imgIntvQueue;
@@ -0,0 +1,46 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <igtlServerSocket.h>
+#include <igtlClientSocket.h>
+#include <string>
+
+namespace mrigtlbridge {
+
+// igtl::ServerSocket that also reports the numeric address of each client it
+// accepts. igtl::Socket::GetSocketAddressAndPort() gives the local address of
+// a socket only, and the UDP tracking channel needs the client's.
+class IGTLServerSocket : public igtl::ServerSocket {
+public:
+    typedef IGTLServerSocket Self;
+    typedef igtl::ServerSocket Superclass;
+    typedef igtl::SmartPointer<Self> Pointer;
+    typedef igtl::SmartPointer<const Self> ConstPointer;
+
+    igtlTypeMacro(mrigtlbridge::IGTLServerSocket, igtl::ServerSocket);
+    igtlNewMacro(Self);
+
+    // Like WaitForConnection(); 'peerAddress' is set to the client's address,
+    // or left empty where it is not available (without UDP transport)
+    MRIGTL_LIB_EXPORT igtl::ClientSocket::Pointer waitForClient(unsigned long msec, std::string& peerAddress);
+
+protected:
+    IGTLServerSocket() {}
+    ~IGTLServerSocket() {}
+};
+
+} // namespace mrigtlbridge
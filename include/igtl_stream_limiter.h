@@ -0,0 +1,68 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <igtlMessageBase.h>
+#include <chrono>
+#include <cstdint>
+
+namespace mrigtlbridge {
+
+// Per-client state of one outbound stream (e.g. TDATA or IMAGE).
+//
+// Until the client sends STT_<type>, every sample is forwarded as before.
+// After STT_<type> with a resolution, at most one sample per interval goes
+// out; samples produced in between replace each other, so the client always
+// gets the newest one. STP_<type> stops the stream.
+class IGTLStreamLimiter {
+public:
+    enum Mode {
+        Push,       // No request from the client; forward everything
+        Streaming,  // Forward at most one sample per interval
+        Stopped     // Forward nothing
+    };
+
+    MRIGTL_LIB_EXPORT IGTLStreamLimiter();
+
+    // 'resolutionMs' is the minimum interval requested by the client (0: every sample)
+    MRIGTL_LIB_EXPORT void start(int resolutionMs);
+    MRIGTL_LIB_EXPORT void stop();
+
+    // Returns true if 'msg' should be sent now. Otherwise the message is kept
+    // as the pending sample (Streaming) or discarded (Stopped).
+    MRIGTL_LIB_EXPORT bool offer(const igtl::MessageBase::Pointer& msg);
+
+    // The pending sample once its interval has elapsed, or a null pointer
+    MRIGTL_LIB_EXPORT igtl::MessageBase::Pointer takeDue();
+
+    MRIGTL_LIB_EXPORT Mode getMode() const { return mode; }
+    MRIGTL_LIB_EXPORT int getResolution() const { return resolution; }
+    MRIGTL_LIB_EXPORT uint64_t getForwardedCount() const { return forwardedCount; }
+    MRIGTL_LIB_EXPORT uint64_t getCoalescedCount() const { return coalescedCount; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Mode mode;
+    int resolution;  // Milliseconds
+    Clock::time_point lastSent;
+    igtl::MessageBase::Pointer pending;
+
+    uint64_t forwardedCount;
+    uint64_t coalescedCount;  // Samples replaced by a newer one or discarded
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,103 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <igtlMessageBase.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace mrigtlbridge {
+
+// Datagram channel for small, high-rate OpenIGTLink messages (TDATA, TRANSFORM).
+//
+// Each datagram carries one packed message behind an 8-byte prefix
+// ('MRGU' magic + 32-bit sequence number, big endian). The receiver discards
+// datagrams that are older than the last one seen from the same peer and,
+// of everything queued on the socket, returns only the newest message per
+// device type and name. Nothing is retransmitted: a lost sample is simply
+// replaced by the next one.
+//
+// Datagrams are accepted only from hosts that are destinations; the sending
+// peers are remembered for the sequence check only. Data goes to the
+// destinations that were added explicitly, so a datagram from an unknown host
+// can neither inject samples nor redirect the stream. Not thread-safe.
+class IGTLUdpChannel {
+public:
+    struct Statistics {
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        uint64_t stale = 0;       // Out of order or duplicate; discarded
+        uint64_t superseded = 0;  // Replaced by a newer sample in the same receive call
+        uint64_t lost = 0;        // Gaps in the sequence numbers
+        uint64_t oversized = 0;   // Too large for one datagram; not sent
+        uint64_t rejected = 0;    // From a host that is not a destination
+    };
+
+    // Largest packed message that fits into one datagram
+    static const size_t MaxMessageSize = 65507 - 8;
+    // Destinations and learned peers; learned peers make room for destinations,
+    // and datagrams from further peers are ignored
+    static const size_t MaxPeers = 32;
+
+    MRIGTL_LIB_EXPORT IGTLUdpChannel();
+    MRIGTL_LIB_EXPORT ~IGTLUdpChannel();
+
+    // Bind to 'localPort' (0: any free port)
+    MRIGTL_LIB_EXPORT bool open(int localPort);
+    MRIGTL_LIB_EXPORT void close();
+    MRIGTL_LIB_EXPORT bool isOpen() const { return fd >= 0; }
+    MRIGTL_LIB_EXPORT int getLocalPort() const;
+
+    // Add a destination and announce this channel to it. Returns an id for
+    // send() and removeDestination(), or -1.
+    MRIGTL_LIB_EXPORT int addDestination(const std::string& host, int port);
+    MRIGTL_LIB_EXPORT void removeDestination(int id);
+    MRIGTL_LIB_EXPORT int getDestinationCount() const;
+
+    // Send a packed message to all destinations, or to destination 'id' only
+    MRIGTL_LIB_EXPORT bool send(igtl::MessageBase* msg);
+    MRIGTL_LIB_EXPORT bool send(igtl::MessageBase* msg, int id);
+
+    // Wait up to 'timeoutMs' for data, then drain the socket and return the
+    // newest message for each device type/name
+    MRIGTL_LIB_EXPORT std::vector<igtl::MessageBase::Pointer> receiveLatest(int timeoutMs);
+
+    MRIGTL_LIB_EXPORT Statistics getStatistics() const { return stats; }
+
+private:
+    struct Peer {
+        std::vector<unsigned char> address;  // sockaddr of the peer
+        int id = 0;                          // > 0: destination
+        uint32_t sendSequence = 0;           // Last sequence number sent to the peer
+        uint32_t lastSequence = 0;           // Last sequence number received from it
+        bool seen = false;                   // 'lastSequence' is valid
+    };
+
+    Peer* findPeer(const void* address, size_t length, bool add);
+    bool isDestinationHost(const void* address, size_t length) const;
+    bool sendDatagram(const Peer& peer, const void* data, size_t size);
+    bool sendTo(Peer& peer, igtl::MessageBase* msg);
+
+    int fd;
+    int nextId;
+    std::vector<Peer> peers;
+    std::vector<unsigned char> buffer;
+    Statistics stats;
+};
+
+} // namespace mrigtlbridge
@@ -18,7 +18,7 @@
 #include "widget_base.h"
 #include <QLineEdit>
 #include <QPushButton>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QLabel>
 #include <memory>
 
@@ -28,12 +28,12 @@ class IGTLWidget : public WidgetBase {
     Q_OBJECT
 
 public:
-    MRIGTL_LIB_EXPORT explicit IGTLWidget(QObject* parent = nullptr);
-    MRIGTL_LIB_EXPORT ~IGTLWidget() override;
+    MRIGTL_GUI_EXPORT explicit IGTLWidget(QObject* parent = nullptr);
+    MRIGTL_GUI_EXPORT ~IGTLWidget() override;
 
-    MRIGTL_LIB_EXPORT void buildGUI(QWidget* parent) override;
-    MRIGTL_LIB_EXPORT void updateGUI(const QString& state) override;
-    MRIGTL_LIB_EXPORT void setSignalManager(SignalManager* sm) override;
+    MRIGTL_GUI_EXPORT void buildGUI(QWidget* parent) override;
+    MRIGTL_GUI_EXPORT void updateGUI(const QString& state) override;
+    MRIGTL_GUI_EXPORT void setSignalManager(SignalManager* sm) override;
 
 private slots:
     void onConnectButtonClicked();
@@ -46,7 +46,7 @@ private:
     QLineEdit* openIGT_PortEdit;
     QPushButton* openIGTConnectButton;
     QPushButton* openIGTDisconnectButton;
-    QTextEdit* openIGTConsole;
+    QPlainTextEdit* openIGTConsole;
     QLabel* openIGTStatus;
 };
 
@@ -0,0 +1,47 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+namespace mrigtlbridge {
+
+class ThreadPool;
+
+// A piece of an image's scalars ('binary'/'binaryOffset' of sendImageIGTL)
+struct ImageChunk {
+    const char* data = nullptr;
+    qint64 offset = 0;  // Bytes from the start of the scalars
+    qint64 size = 0;
+};
+
+// Sorts the chunks by offset and checks, once for all of them, that each lies
+// within 'totalSize', starts and ends on a multiple of 'alignment' (a voxel)
+// and does not overlap the next. Returns false with 'error' set otherwise.
+// 'gapBytes' is the number of bytes that no chunk covers.
+MRIGTL_LIB_EXPORT bool validateImageChunks(std::vector<ImageChunk>& chunks, qint64 totalSize, int alignment,
+                                           qint64& gapBytes, QString& error);
+
+// Copies validated chunks into 'dest' and zeroes the gaps. Images of at least
+// 'parallelThreshold' bytes are copied on 'pool' in pieces of about 1 MB, so
+// that a volume sent as one chunk is split as well; smaller images (or
+// 'pool' = nullptr, or a threshold <= 0) are copied on the calling thread.
+MRIGTL_LIB_EXPORT void assembleImageChunks(const std::vector<ImageChunk>& chunks, char* dest, qint64 totalSize,
+                                           ThreadPool* pool, qint64 parallelThreshold);
+
+} // namespace mrigtlbridge
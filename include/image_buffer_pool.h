@@ -0,0 +1,128 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QByteArray>
+#include <QMetaType>
+#include <QtGlobal>
+#include <igtlImageMessage.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mrigtlbridge {
+
+// A block from ImageBufferPool. Copies share the block, which goes back to
+// the pool when the last copy is destroyed.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+
+    char* data() const { return block ? block->data : nullptr; }
+    size_t size() const { return length; }
+    bool isNull() const { return !block; }
+
+    // The block as a QByteArray without a copy. The QByteArray does not keep
+    // the block: keep this PooledBuffer (e.g. in the same QVariantMap) for as
+    // long as the QByteArray is used.
+    QByteArray toByteArray() const { return QByteArray::fromRawData(data(), static_cast<int>(length)); }
+
+private:
+    friend class ImageBufferPool;
+
+    struct Block {
+        char* data = nullptr;
+        size_t capacity = 0;
+        size_t mappedLength = 0;  // mmap()ed for huge pages; 0 if malloc()ed
+    };
+
+    std::shared_ptr<Block> block;
+    size_t length = 0;
+};
+
+// Reuses the large buffers of the image path instead of allocating them for
+// every frame.
+//
+//  - acquire(): blocks for producers (e.g. the simulator's frames), in size
+//    classes of a quarter octave. With huge pages enabled, blocks of 2 MB and
+//    more are mapped with MAP_HUGETLB, or with transparent huge pages if none
+//    are reserved (Linux).
+//  - acquireImageMessage(): IMAGE messages for sendImageIGTL. A message is
+//    handed out again once the pool holds the only reference to it, i.e. the
+//    client queues, the tap and the listener have all released it. Its pack
+//    buffer is kept by AllocateScalars() as long as the image size does not
+//    change, so packing does not allocate.
+//
+// Idle buffers of a size that has not been asked for in a while are freed.
+class ImageBufferPool {
+public:
+    struct Statistics {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 bytes = 0;           // Held by the pool (in use and idle)
+        quint64 highWaterBytes = 0;
+    };
+
+    MRIGTL_LIB_EXPORT static ImageBufferPool& instance();
+
+    MRIGTL_LIB_EXPORT void setEnabled(bool enable);
+    MRIGTL_LIB_EXPORT bool isEnabled() const;
+    MRIGTL_LIB_EXPORT void setHugePages(bool enable);
+    // Buffers kept per size (default 8); more are allocated but not kept
+    MRIGTL_LIB_EXPORT void setMaxPerSize(int count);
+
+    MRIGTL_LIB_EXPORT PooledBuffer acquire(size_t size);
+    // A message with the dimensions, type and scalars allocated and no time
+    // stamp; the caller sets everything else (the previous user's settings
+    // are still there)
+    MRIGTL_LIB_EXPORT igtl::ImageMessage::Pointer acquireImageMessage(const int dimension[3], int scalarType,
+                                                                      int numberOfComponents);
+
+    MRIGTL_LIB_EXPORT Statistics getStatistics() const;
+    // Free every idle buffer
+    MRIGTL_LIB_EXPORT void trim();
+
+private:
+    ImageBufferPool() = default;
+
+    // Blocks that are not in use, and all messages (in use or not), per size
+    struct SizeClass {
+        std::vector<PooledBuffer::Block*> idleBlocks;
+        std::vector<igtl::ImageMessage::Pointer> messages;
+        quint64 lastUse = 0;
+    };
+
+    static size_t blockClass(size_t size);
+    static PooledBuffer::Block* allocateBlock(size_t capacity, bool huge);
+    static void freeBlock(PooledBuffer::Block* block);
+    void release(PooledBuffer::Block* block);
+    void age();
+    void addBytes(qint64 bytes);
+
+    mutable std::mutex mutex;
+    std::map<size_t, SizeClass> blocks;
+    std::map<size_t, SizeClass> messages;
+    bool enabled = true;
+    bool hugePages = false;
+    size_t maxPerSize = 8;
+    quint64 uses = 0;
+    Statistics statistics;
+};
+
+} // namespace mrigtlbridge
+
+Q_DECLARE_METATYPE(mrigtlbridge::PooledBuffer)
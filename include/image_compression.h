@@ -0,0 +1,68 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QString>
+#include <QtGlobal>
+#include <igtlImageMessage.h>
+#include <igtlMessageBase.h>
+
+namespace mrigtlbridge {
+
+class ThreadPool;
+
+// Lossless compression of IMAGE messages for slow links.
+//
+// A COMP_IMAGE message carries a packed IMAGE: the IMAGE header as it is, and
+// the scalars byte-shuffled (byte k of every scalar together, so that the
+// slowly varying high bytes form long runs) and LZ-compressed in independent
+// chunks, which are encoded and decoded on the thread pool. The device name
+// and timestamp are those of the IMAGE. Body (big endian):
+//
+//   char[8]    codec             "SHUF-LZ" (NUL padded)
+//   uint16     version           1
+//   uint16     shuffleWidth      Bytes per scalar (1: not shuffled)
+//   uint32     chunkBytes        Uncompressed bytes per chunk (the last may be shorter)
+//   uint32     chunkCount
+//   uint32     imageHeaderBytes
+//   uint64     rawBytes          Uncompressed scalar bytes
+//   uint64     imageCrc          CRC64 of the IMAGE body
+//   uint8[imageHeaderBytes]      IMAGE header
+//   uint32[chunkCount]           Compressed size of each chunk; a chunk that
+//                                did not get smaller is stored as it is (not
+//                                shuffled) and has its uncompressed size
+//   chunks
+//
+// An LZ sequence is a token (literal length << 4 | match length - 4, 15
+// meaning that bytes of 255... follow), the literals, and a 16-bit
+// little-endian match offset; the last sequence of a chunk has no match.
+const char* const CompressedImageType = "COMP_IMAGE";
+const int DefaultCompressionChunkBytes = 256 * 1024;
+
+// Compresses a packed IMAGE (header version 1). Returns a packed COMP_IMAGE,
+// or null if the compressed message would not be smaller or 'imageMsg' cannot
+// be compressed; the caller then sends the IMAGE. Updates the compression
+// counters of BridgeMetrics.
+MRIGTL_LIB_EXPORT igtl::MessageBase::Pointer compressImage(igtl::MessageBase* imageMsg, ThreadPool* pool,
+                                                           int chunkBytes = DefaultCompressionChunkBytes);
+
+// Decodes a COMP_IMAGE from its header (unpacked, as received) and body into
+// an unpacked IMAGE, checked against the CRC of the original. Returns null
+// with 'error' set if the body is not valid.
+MRIGTL_LIB_EXPORT igtl::ImageMessage::Pointer decompressImage(igtl::MessageBase* header, const void* body,
+                                                              qint64 bodySize, ThreadPool* pool, QString& error);
+
+} // namespace mrigtlbridge
@@ -0,0 +1,76 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <igtlImageMessage.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mrigtlbridge {
+
+// Turns consecutive frames of an image into IGTL subvolume updates.
+//
+// encode() compares each frame with the previous frame of the same device,
+// row by row in 64-byte blocks (memcmp), and returns an IMAGE message that
+// holds only the bounding subvolume of the changed blocks; the receiver
+// updates that part of the image it already has. A full image (a keyframe)
+// is sent instead for the first frame of a device, when the geometry or type
+// changes, every 'keyframeInterval' frames, and when the changed subvolume is
+// not much smaller than the image.
+//
+// Costs one copy of the last frame per device. Not thread-safe.
+class ImageDeltaEncoder {
+public:
+    MRIGTL_LIB_EXPORT ImageDeltaEncoder();
+
+    // A keyframe at least every 'frames' frames (default 30; 1: always)
+    MRIGTL_LIB_EXPORT void setKeyframeInterval(int frames);
+    // Keyframe if the subvolume has more than this fraction of the voxels (default 0.5)
+    MRIGTL_LIB_EXPORT void setMaxDeltaRatio(double ratio);
+
+    // The next frame of every device is a keyframe, e.g. after a client has
+    // connected or a message was dropped
+    MRIGTL_LIB_EXPORT void reset();
+
+    // 'imageMsg' is a full image with its scalars and geometry set. Returns
+    // the subvolume update (not packed), or a null pointer if the full image
+    // is to be sent. Records the time and the bytes saved in BridgeMetrics.
+    MRIGTL_LIB_EXPORT igtl::ImageMessage::Pointer encode(igtl::ImageMessage* imageMsg);
+
+private:
+    struct DeviceState {
+        std::vector<char> scalars;  // The last frame
+        int dimension[3];
+        int scalarType;
+        int components;
+        int endian;
+        float spacing[3];
+        igtl::Matrix4x4 matrix;
+        int framesSinceKeyframe;
+    };
+
+    // Bounding box [begin, end) of the voxels that differ from 'previous'; false if none do
+    static bool changedRegion(const char* current, const char* previous, const int dimension[3], int voxelBytes,
+                              int begin[3], int end[3]);
+    static bool sameGeometry(const DeviceState& state, igtl::ImageMessage* imageMsg);
+
+    std::map<std::string, DeviceState> devices;
+    int keyframeInterval;
+    double maxDeltaRatio;
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,105 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QImage>
+#include <QMutex>
+#include <QPainter>
+#include <QThread>
+#include <QWidget>
+#include <atomic>
+#include <vector>
+
+namespace igtl {
+class ImageMessage;
+}
+
+namespace mrigtlbridge {
+
+// Renders the newest image of ImageTap into an 8-bit grayscale QImage on its
+// own thread: the middle slice, downsampled (nearest neighbour) to at most
+// 'maxSize' pixels on the longer side and mapped through a window/level
+// (the range of the frame if no window is set). At most 'rate' frames per
+// second are rendered; frames sent in between are skipped.
+class MRIGTL_GUI_QT_EXPORT PreviewRenderer : public QThread {
+    Q_OBJECT
+
+public:
+    explicit PreviewRenderer(QObject* parent = nullptr);
+    ~PreviewRenderer() override;
+
+    void setMaxSize(int pixels) { maxSize = pixels > 0 ? pixels : 1; }
+    void setRate(double hz) { rate = hz > 0.0 ? hz : 1.0; }
+    // window <= 0: automatic
+    void setWindowLevel(double window, double level);
+
+    void stop();
+
+    // Draw the last rendered frame into 'target', keeping its aspect ratio
+    void draw(QPainter& painter, const QRect& target);
+    quint64 getFrameCount() const { return frameCount; }
+    double getLastRenderMs() const { return lastRenderMs; }
+
+signals:
+    void frameReady();
+
+protected:
+    void run() override;
+
+private:
+    void render(igtl::ImageMessage* image);
+
+    std::atomic<bool> stopRequested;
+    std::atomic<int> maxSize;
+    std::atomic<double> rate;
+    std::atomic<double> window;
+    std::atomic<double> level;
+
+    // Rendered into 'back', then swapped with 'front' under the mutex
+    QImage front;
+    QImage back;
+    QMutex imageMutex;
+    std::vector<float> values;
+
+    std::atomic<quint64> frameCount;
+    std::atomic<double> lastRenderMs;
+};
+
+// Shows the output of a PreviewRenderer, scaled to the widget. The renderer
+// runs (and the image tap is attached) only while the preview is active.
+class ImagePreviewWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    MRIGTL_GUI_EXPORT explicit ImagePreviewWidget(QWidget* parent = nullptr);
+    MRIGTL_GUI_EXPORT ~ImagePreviewWidget() override;
+
+    MRIGTL_GUI_EXPORT PreviewRenderer* getRenderer() { return renderer; }
+
+public slots:
+    MRIGTL_GUI_EXPORT void setActive(bool active);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private slots:
+    void onFrameReady();
+
+private:
+    PreviewRenderer* renderer;
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,71 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QString>
+#include <igtlImageMessage.h>
+
+namespace mrigtlbridge {
+
+class ThreadPool;
+
+// What a client wants of each image: a region of interest, then decimation
+// or box-filter downsampling, capped to a maximum matrix size.
+//
+// As text (listener parameter 'imageReduction', or the IMAGE_REDUCTION
+// string a client sends), space-separated options:
+//
+//   roi=x,y,z,w,h,d   Region in voxels (w, h or d = 0: to the end of the axis)
+//   factor=f[,fy,fz]  Keep every f-th voxel (fy, fz default to f, 1)
+//   filter=box        Average f x fy x fz blocks instead ('pick': decimate)
+//   max=n             Raise the factors until no axis exceeds n voxels
+//
+// "" or "none" is the full image.
+struct ImageReduction {
+    int roiOrigin[3] = {0, 0, 0};
+    int roiSize[3] = {0, 0, 0};     // 0: the whole axis from roiOrigin
+    int factor[3] = {1, 1, 1};
+    bool boxFilter = false;
+    int maxSize = 0;                // 0: no cap
+
+    MRIGTL_LIB_EXPORT bool isIdentity() const;
+    // Returns false and sets 'error' (leaving this unchanged) for invalid text
+    MRIGTL_LIB_EXPORT bool parse(const QString& text, QString& error);
+    // Canonical text; equal reductions have equal text
+    MRIGTL_LIB_EXPORT QString toString() const;
+};
+
+// The reduction applied to an image of a given size
+struct ReductionPlan {
+    int origin[3];      // First voxel of the ROI, clipped to the image
+    int factor[3];      // After the 'max' cap
+    int dimension[3];   // Of the reduced image
+    bool boxFilter;
+};
+
+// Returns false if the ROI lies outside the image
+MRIGTL_LIB_EXPORT bool planReduction(const int dimension[3], const ImageReduction& reduction, ReductionPlan& plan);
+
+// Writes the reduced scalars of 'source' into 'dest', which must have been
+// allocated with the plan's dimension and the source's scalar type and
+// components, and sets the spacing and matrix of 'dest' so that each voxel
+// stays where it was in patient space (the IGTL position is the image
+// center). Name and endian are copied; 'dest' is not packed. Rows are
+// split across 'pool' if given.
+MRIGTL_LIB_EXPORT void reduceImage(igtl::ImageMessage* source, const ReductionPlan& plan, igtl::ImageMessage* dest,
+                                   ThreadPool* pool = nullptr);
+
+} // namespace mrigtlbridge
@@ -0,0 +1,54 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QtGlobal>
+#include <igtlImageMessage.h>
+#include <atomic>
+#include <mutex>
+
+namespace mrigtlbridge {
+
+// The newest image sent by IGTLListener, for previews.
+//
+// IGTLListener publishes each image after it has been packed and handed to
+// the transport. Only a reference to the packed message is kept (the message
+// is not modified after packing and is already shared by the client queues),
+// so publishing costs a reference count and an uncontended lock, and nothing
+// at all while no consumer is attached. Consumers poll with take() at their
+// own rate and only ever see the newest image.
+class ImageTap {
+public:
+    MRIGTL_LIB_EXPORT static ImageTap& instance();
+
+    // Consumers attach while they want images; the tap is off with none
+    MRIGTL_LIB_EXPORT void attach();
+    MRIGTL_LIB_EXPORT void detach();
+    MRIGTL_LIB_EXPORT bool isActive() const { return consumers.load(std::memory_order_relaxed) > 0; }
+
+    MRIGTL_LIB_EXPORT void publish(const igtl::ImageMessage::Pointer& image);
+
+    // The newest image if it is newer than 'sequence' (updated); null otherwise
+    MRIGTL_LIB_EXPORT igtl::ImageMessage::Pointer take(quint64& sequence);
+
+private:
+    std::atomic<int> consumers{0};
+    std::mutex mutex;
+    igtl::ImageMessage::Pointer latest;
+    quint64 published = 0;
+};
+
+} // namespace mrigtlbridge
@@ -22,22 +22,24 @@
 namespace mrigtlbridge {
 
 class WidgetBase;
+class PerformancePanel;
 
 class MainWindow : public QWidget {
     Q_OBJECT
 
 public:
-    MRIGTL_LIB_EXPORT explicit MainWindow(QWidget* parent = nullptr);
-    MRIGTL_LIB_EXPORT ~MainWindow();
+    MRIGTL_GUI_EXPORT explicit MainWindow(QWidget* parent = nullptr);
+    MRIGTL_GUI_EXPORT ~MainWindow();
 
-    MRIGTL_LIB_EXPORT void setTitle(const QString& title);
-    MRIGTL_LIB_EXPORT void setLeftWidget(WidgetBase* widget);
-    MRIGTL_LIB_EXPORT void setRightWidget(WidgetBase* widget);
-    MRIGTL_LIB_EXPORT void setup();
+    MRIGTL_GUI_EXPORT void setTitle(const QString& title);
+    MRIGTL_GUI_EXPORT void setLeftWidget(WidgetBase* widget);
+    MRIGTL_GUI_EXPORT void setRightWidget(WidgetBase* widget);
+    MRIGTL_GUI_EXPORT void setup();
 
 private:
     WidgetBase* leftWidget;
     WidgetBase* rightWidget;
+    PerformancePanel* performancePanel;
     QString title;
 };
 
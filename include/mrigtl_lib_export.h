@@ -9,21 +9,32 @@
   // Static library - no exports needed
   #define MRIGTL_LIB_EXPORT
   #define MRIGTL_QT_EXPORT
+  #define MRIGTL_GUI_EXPORT
+  #define MRIGTL_GUI_QT_EXPORT
 #else
   // Shared library (DLL) - use appropriate exports
-  #if defined(mrigtl_lib_shared_EXPORTS)
+  // MRIGTL_LIB_EXPORT: core classes, built into mrigtl_core
+  #if defined(mrigtl_core_EXPORTS)
     #define MRIGTL_LIB_EXPORT Q_DECL_EXPORT
   #else
     #define MRIGTL_LIB_EXPORT Q_DECL_IMPORT
   #endif
+  // MRIGTL_GUI_EXPORT: widgets, built into mrigtl_lib on top of mrigtl_core
+  #if defined(mrigtl_lib_shared_EXPORTS)
+    #define MRIGTL_GUI_EXPORT Q_DECL_EXPORT
+  #else
+    #define MRIGTL_GUI_EXPORT Q_DECL_IMPORT
+  #endif
 
   // Platform-specific Qt class export handling
   // On Windows, we use class-level exports for Qt classes to ensure MOC symbols are exported
   // On other platforms, we use function-level exports to avoid any potential issues
   #ifdef _WIN32
     #define MRIGTL_QT_EXPORT MRIGTL_LIB_EXPORT
+    #define MRIGTL_GUI_QT_EXPORT MRIGTL_GUI_EXPORT
   #else
     #define MRIGTL_QT_EXPORT
+    #define MRIGTL_GUI_QT_EXPORT
   #endif
 #endif
 
@@ -0,0 +1,120 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QByteArray>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include <memory>
+
+class QFile;
+
+namespace mrigtlbridge {
+
+// A file mapped for reading. Copies share the mapping, which is removed when
+// the last copy is destroyed.
+class FileMapping {
+public:
+    FileMapping() = default;
+
+    const char* data() const { return map ? map->data : nullptr; }
+    qint64 size() const { return map ? map->size : 0; }
+    bool isNull() const { return !map; }
+
+private:
+    friend class MRSimFileSource;
+
+    struct Map {
+        std::unique_ptr<QFile> file;
+        const char* data = nullptr;
+        qint64 size = 0;
+        ~Map();
+    };
+
+    std::shared_ptr<Map> map;
+};
+
+// Recorded image series for MRSimListener, memory-mapped from disk.
+//
+// Supported files:
+//   - NRRD (.nrrd, or .nhdr with a detached raw data file), raw encoding only.
+//     A 4D image is a series of volumes along the last axis; a 3D image whose
+//     last axis has the kind 'time' is a series of 2D frames. Anything else is
+//     a single frame. The geometry is taken from 'space directions'/'space
+//     origin' (LPS is converted to RAS) and the frame interval from the
+//     'spacings' of the time axis, if given.
+//   - Raw: frames of width x height x slices voxels of 'dtype' back to back,
+//     in host byte order, after an optional header of 'headerBytes'.
+//
+// The header is parsed once in open(). Each frame is a QByteArray created
+// with QByteArray::fromRawData() on the mapping, so sending a frame costs a
+// page-cache read and no allocation. The QByteArrays do not keep the mapping:
+// send getMapping() along with a frame (as 'binaryBuffer', like a
+// PooledBuffer) so that it outlives the source while the frame is queued.
+class MRSimFileSource {
+public:
+    // Used for raw files only
+    struct RawSettings {
+        int width = 256;
+        int height = 256;
+        int slices = 1;
+        QString dtype = "uint16";
+        double spacing[3] = {1.0, 1.0, 1.0};  // mm
+        qint64 headerBytes = 0;
+    };
+
+    MRIGTL_LIB_EXPORT MRSimFileSource();
+
+    // Returns false if the file cannot be mapped or parsed; see getError()
+    MRIGTL_LIB_EXPORT bool open(const QString& path, const RawSettings& raw);
+    MRIGTL_LIB_EXPORT const QString& getError() const { return error; }
+
+    MRIGTL_LIB_EXPORT int getFrameCount() const { return frames.size(); }
+    MRIGTL_LIB_EXPORT const QByteArray& getFrame(int index) const { return frames[index % frames.size()]; }
+    // The mapping that the frames point into
+    MRIGTL_LIB_EXPORT const FileMapping& getMapping() const { return mapping; }
+
+    MRIGTL_LIB_EXPORT const QString& getDtype() const { return dtype; }
+    MRIGTL_LIB_EXPORT int getEndian() const { return endian; }  // 1: big, 2: little
+    MRIGTL_LIB_EXPORT const int* getDimensions() const { return dimensions; }
+    MRIGTL_LIB_EXPORT const double* getSpacing() const { return spacing; }
+    // 4x4 image-to-RAS matrix with unit direction columns; the translation is
+    // the center of the image (as in the IGTL IMAGE message)
+    MRIGTL_LIB_EXPORT void getMatrix(double m[4][4]) const;
+    // Seconds between frames in the recording; 0 if unknown
+    MRIGTL_LIB_EXPORT double getFrameInterval() const { return frameInterval; }
+
+private:
+    bool parseNrrd(const QString& path, const char* data, qint64 size, qint64& dataOffset, QString& dataFile,
+                   int& frameCount);
+    bool map(const QString& path, FileMapping& result);
+    bool setFrames(const char* data, qint64 size, int frameCount);
+
+    QString error;
+    FileMapping mapping;
+    QVector<QByteArray> frames;
+    QString dtype;
+    int endian;
+    int dimensions[3];
+    double spacing[3];
+    double matrix[4][4];
+    double frameInterval;
+};
+
+} // namespace mrigtlbridge
+
+Q_DECLARE_METATYPE(mrigtlbridge::FileMapping)
@@ -0,0 +1,79 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QByteArray>
+#include <string>
+#include <vector>
+
+namespace mrigtlbridge {
+
+// Synthetic image source for MRSimListener.
+//
+// All frames are rendered up front into a ring of buffers; during a sequence
+// the simulator only cycles through the ring, so the frame rate is bounded by
+// the IGTL path and not by image synthesis. Consecutive frames differ slightly
+// (breathing-like motion or a moving pattern) so that a viewer shows a live
+// series.
+class MRSimImageGenerator {
+public:
+    struct Settings {
+        int width = 256;
+        int height = 256;
+        int slices = 1;
+        std::string dtype = "uint16";   // See ScalarType in scalar_type.h
+        int echoes = 1;                 // Multi-echo: one image per echo with T2 decay
+        bool multiSlice = false;        // true: each slice is a separate 2D image
+        std::string phantom = "shepplogan";  // 'shepplogan', 'checker', 'gradient' or 'alternating'
+        int ringSize = 4;               // Number of pre-rendered frames
+        double echoSpacing = 10.0;      // ms (echo n is at TE = n * echoSpacing)
+    };
+
+    // One image of a frame (a volume, or a single slice in multi-slice mode)
+    struct Image {
+        QByteArray data;
+        int echo;
+        int slice;   // First slice in the image
+    };
+
+    MRIGTL_LIB_EXPORT MRSimImageGenerator();
+
+    // Returns false (and keeps the previous settings) if the settings are invalid
+    MRIGTL_LIB_EXPORT bool configure(const Settings& settings);
+    MRIGTL_LIB_EXPORT const Settings& getSettings() const { return settings; }
+
+    // Render all frames of the ring. Uses all cores.
+    MRIGTL_LIB_EXPORT void render();
+
+    MRIGTL_LIB_EXPORT int getFrameCount() const { return static_cast<int>(frames.size()); }
+    MRIGTL_LIB_EXPORT const std::vector<Image>& getFrame(int index) const { return frames[index % frames.size()]; }
+    MRIGTL_LIB_EXPORT int getScalarType() const { return scalarType; }
+    MRIGTL_LIB_EXPORT int getScalarSize() const { return scalarSize; }
+    // Bytes per frame (all echoes and slices)
+    MRIGTL_LIB_EXPORT size_t getFrameBytes() const;
+
+private:
+    // Intensity (0 to 1) of the phantom at normalized coordinates (-1 to 1)
+    double sample(double x, double y, double z, int frame, int echo) const;
+    void renderRows(int frame, int echo, int firstSlice, int sliceCount, char* buffer, int rowBegin, int rowEnd) const;
+
+    Settings settings;
+    int scalarType;
+    int scalarSize;
+    std::vector<std::vector<Image>> frames;
+};
+
+} // namespace mrigtlbridge
@@ -15,11 +15,18 @@
 #pragma once
 
 #include "mrigtl_lib_export.h"
+#include "image_buffer_pool.h"
 #include "listener_base.h"
+#include "mrsim_file_source.h"
+#include "mrsim_image_generator.h"
+#include "mrsim_tracking_generator.h"
+#include "volume_reslicer.h"
 #include <QVariant>
 #include <QMutex>
 #include <QVector>
 #include <QString>
+#include <chrono>
+#include <memory>
 
 namespace mrigtlbridge {
 
@@ -46,11 +53,68 @@ protected:
     MRIGTL_LIB_EXPORT void finalize() override;
 
 private:
+    bool loadReferenceVolume();
+    bool openReplayFile();
+    void buildImageParameters();
+    QVector<QVariantList> computeSliceMatrices(const QVariantMap& plane) const;
+    void publishScanPlane(int planeId, const QVariantMap& plane);
+    void sendFrame(const QVector<QVariantList>& matrices);
+    void sendReslicedFrame(const QVector<QVariantMap>& planes);
+    void sendReplayFrame();
+    bool configureTracking();
+
+    // Sequence state (running, frame and tracking counters)
     bool running;
     QMutex mutex;
-    
-    // Scan plane parameters
-    QVector<QVariantMap> scanPlanes;
+
+    // Scan planes and the slice matrices derived from plane 0, published as an
+    // immutable snapshot: onUpdateScanPlane() swaps in a new one and process()
+    // takes one per tick, so an update never waits for a frame and a frame
+    // never sees a partial update. Accessed with std::atomic_load/store.
+    struct PlaneState {
+        QVector<QVariantMap> planes;
+        QVector<QVariantList> sliceMatrices;  // Flattened 4x4 per slice ('ring' source)
+        qint64 updateTime = 0;                // When the last plane was received (BridgeMetrics::now())
+    };
+    static const int ScanPlaneCount = 3;
+    std::shared_ptr<const PlaneState> planeState;
+    qint64 lastPlaneUpdate;   // updateTime of the snapshot last seen by process()
+    qint64 planeTime;         // Set until the first frame after a plane update is sent
+
+    // Pre-rendered frames and the image parameters built for them once
+    MRSimImageGenerator generator;
+    QVector<QVector<QVariantMap>> frameParameters;
+    int frameIndex;
+
+    enum Source {
+        RingSource,     // Pre-rendered frames
+        ResliceSource,  // A reference volume resampled along each scan plane
+        FileSource      // Frames replayed from a memory-mapped file
+    };
+    Source source;
+
+    // 'reslice' source
+    bool interleaved;                  // Planes acquired one after the other within a frame
+    VolumeReslicer reslicer;
+    QVariantMap resliceParameters;     // Image parameters without binary, matrix and name
+    bool pooledFrames;                 // Reslice into ImageBufferPool blocks ('bufferPool')
+    size_t planeBytes;
+    QVector<QByteArray> planeBuffers;  // One output buffer per scan plane (without the pool)
+
+    // 'file' source
+    MRSimFileSource replayFile;
+    QVariantMap replayParameters;      // Image parameters without binary and timestamp
+
+    // Synthetic tracking ('trackingCoils' > 0), paced like the frames
+    MRSimTrackingGenerator tracking;
+    bool trackingEnabled;
+    double trackingInterval;  // Seconds
+    long trackingSent;
+
+    // Frame timing
+    std::chrono::steady_clock::time_point sequenceStart;
+    long framesSent;
+    double frameInterval;  // Seconds
 };
 
 } // namespace mrigtlbridge
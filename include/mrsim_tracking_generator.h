@@ -0,0 +1,65 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QString>
+#include <QVariant>
+#include <QVector>
+#include <string>
+
+namespace mrigtlbridge {
+
+// Synthetic tracking coils for MRSimListener.
+//
+// Positions are a function of time only, so a sample can be generated for
+// any rate (up to 1 kHz in the simulator) without accumulating state:
+//   - 'catheter': elements spaced along a curved catheter that is slowly
+//     advanced and retracted, with breathing-like motion across the path
+//   - 'circle': coils evenly spaced on a circle, stacked along z
+//   - 'lissajous': coils on a 3D Lissajous curve with evenly spaced phases
+class MRSimTrackingGenerator {
+public:
+    struct Settings {
+        int coils = 4;                    // 1 to MaxCoils
+        std::string path = "catheter";    // 'catheter', 'circle' or 'lissajous'
+        double amplitude = 20.0;          // mm
+        double period = 4.0;              // s
+        double spacing = 5.0;             // mm between neighbouring coils
+    };
+
+    static const int MaxCoils = 1024;
+
+    MRIGTL_LIB_EXPORT MRSimTrackingGenerator();
+
+    // Returns false (and keeps the previous settings) if the settings are invalid
+    MRIGTL_LIB_EXPORT bool configure(const Settings& settings);
+    MRIGTL_LIB_EXPORT const Settings& getSettings() const { return settings; }
+    MRIGTL_LIB_EXPORT int getCoilCount() const { return names.size(); }
+
+    // Position (mm, RAS) of coil 'index' at 't' seconds
+    MRIGTL_LIB_EXPORT void position(int index, double t, double p[3]) const;
+
+    // Parameters for 'sendTrackingDataIGTL' at 't' seconds:
+    // {'coils': [{'id': 'coil<n>', 'position': [x, y, z]}, ...]}
+    MRIGTL_LIB_EXPORT QVariantMap sample(double t) const;
+
+private:
+    Settings settings;
+    int pathType;
+    QVector<QString> names;
+};
+
+} // namespace mrigtlbridge
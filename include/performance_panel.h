@@ -0,0 +1,60 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include "bridge_metrics.h"
+#include <QGroupBox>
+#include <QLabel>
+#include <QTimer>
+#include <QVector>
+
+namespace mrigtlbridge {
+
+// Live view of BridgeMetrics for the bridge window. Reads a snapshot once per
+// interval on the GUI thread; rates are taken over the last interval and the
+// latency percentiles over the last HistoryLength intervals.
+class PerformancePanel : public QGroupBox {
+    Q_OBJECT
+
+public:
+    MRIGTL_GUI_EXPORT explicit PerformancePanel(QWidget* parent = nullptr);
+
+    // Sampling interval in ms (default 1000)
+    MRIGTL_GUI_EXPORT void setInterval(int msec);
+
+private slots:
+    void sample();
+
+private:
+    QLabel* addRow(const QString& name);
+
+    QTimer* timer;
+    QLabel* imageLabel;
+    QLabel* trackingLabel;
+    QLabel* transformLabel;
+    QLabel* queueLabel;
+    QLabel* sendTimeLabel;
+    QLabel* latencyLabel;
+    QLabel* poolLabel;
+    QLabel* deltaLabel;
+    QLabel* compressionLabel;
+
+    // Oldest first; the first entry is the base of the percentile window
+    QVector<BridgeMetrics::Snapshot> history;
+    static const int HistoryLength = 10;
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,89 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "scalar_type.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace mrigtlbridge {
+
+// Typed kernels over the scalar types of ScalarTraits. Select the type once
+// per image or row with dispatchScalarType(), not per voxel.
+
+// The value with its bytes reversed
+template <typename T>
+inline T byteSwap(T value) {
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else {
+        using U = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+        static_assert(sizeof(U) == sizeof(T), "Unsupported scalar size");
+        U u;
+        std::memcpy(&u, &value, sizeof(T));
+        U r = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            r = static_cast<U>((r << 8) | ((u >> (8 * i)) & 0xff));
+        }
+        std::memcpy(&value, &r, sizeof(T));
+        return value;
+    }
+}
+
+// A scalar at any alignment, swapped if 'swap'
+template <typename T>
+inline T loadScalar(const void* p, bool swap) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return swap ? byteSwap(value) : value;
+}
+
+// Swaps 'count' scalars in place
+template <typename T>
+inline void swapScalars(T* data, size_t count) {
+    if constexpr (sizeof(T) > 1) {
+        for (size_t i = 0; i < count; i++) {
+            data[i] = byteSwap(data[i]);
+        }
+    }
+}
+
+// Floats (float or double) to T: rounded (half away from zero) and saturated
+// for integer types
+template <typename T, typename F>
+inline void convertFromFloat(const F* in, size_t count, T* out) {
+    if constexpr (std::numeric_limits<T>::is_integer) {
+        // 'lo' is exact, but 'hi' rounds up to max + 1 where F cannot hold max
+        // (int32 in float), so values at or above it are stored as max rather
+        // than cast. NaN becomes min.
+        const F lo = static_cast<F>(std::numeric_limits<T>::min());
+        const F hi = static_cast<F>(std::numeric_limits<T>::max());
+        for (size_t i = 0; i < count; i++) {
+            // The cast truncates toward zero, so negative values are moved down
+            const F x = in[i] < F(0) ? in[i] - F(0.5) : in[i] + F(0.5);
+            out[i] = x >= hi ? std::numeric_limits<T>::max()
+                     : x > lo ? static_cast<T>(x) : std::numeric_limits<T>::min();
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = static_cast<T>(in[i]);
+        }
+    }
+}
+
+} // namespace mrigtlbridge
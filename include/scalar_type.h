@@ -0,0 +1,140 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <QString>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace mrigtlbridge {
+
+// OpenIGTLink scalar types; the values are the IGTL type codes
+enum class ScalarType : int {
+    Invalid = 0,
+    Int8 = 2,
+    UInt8 = 3,
+    Int16 = 4,
+    UInt16 = 5,
+    Int32 = 6,
+    UInt32 = 7,
+    Float32 = 10,
+    Float64 = 11
+};
+
+constexpr ScalarType AllScalarTypes[] = {
+    ScalarType::Int8, ScalarType::UInt8, ScalarType::Int16, ScalarType::UInt16,
+    ScalarType::Int32, ScalarType::UInt32, ScalarType::Float32, ScalarType::Float64
+};
+
+template <ScalarType S, typename T>
+struct ScalarTraitsBase {
+    using Type = T;
+    static constexpr ScalarType type = S;
+    static constexpr int igtlType = static_cast<int>(S);
+    static constexpr int size = sizeof(T);
+    static constexpr bool isSigned = std::is_signed<T>::value;
+    static constexpr bool isFloat = std::is_floating_point<T>::value;
+};
+
+// Compile-time properties of a scalar type; 'name' is the 'dtype' of the
+// image parameters
+template <ScalarType S>
+struct ScalarTraits;
+
+template <> struct ScalarTraits<ScalarType::Int8> : ScalarTraitsBase<ScalarType::Int8, int8_t> {
+    static constexpr const char* name = "int8";
+};
+template <> struct ScalarTraits<ScalarType::UInt8> : ScalarTraitsBase<ScalarType::UInt8, uint8_t> {
+    static constexpr const char* name = "uint8";
+};
+template <> struct ScalarTraits<ScalarType::Int16> : ScalarTraitsBase<ScalarType::Int16, int16_t> {
+    static constexpr const char* name = "int16";
+};
+template <> struct ScalarTraits<ScalarType::UInt16> : ScalarTraitsBase<ScalarType::UInt16, uint16_t> {
+    static constexpr const char* name = "uint16";
+};
+template <> struct ScalarTraits<ScalarType::Int32> : ScalarTraitsBase<ScalarType::Int32, int32_t> {
+    static constexpr const char* name = "int32";
+};
+template <> struct ScalarTraits<ScalarType::UInt32> : ScalarTraitsBase<ScalarType::UInt32, uint32_t> {
+    static constexpr const char* name = "uint32";
+};
+template <> struct ScalarTraits<ScalarType::Float32> : ScalarTraitsBase<ScalarType::Float32, float> {
+    static constexpr const char* name = "float32";
+};
+template <> struct ScalarTraits<ScalarType::Float64> : ScalarTraitsBase<ScalarType::Float64, double> {
+    static constexpr const char* name = "float64";
+};
+
+// Calls f(ScalarTraits<type>()), so that f is instantiated once per type
+// (typically a generic lambda around a typed loop). Returns false if 'type'
+// is not valid.
+template <typename F>
+bool dispatchScalarType(ScalarType type, F&& f) {
+    switch (type) {
+    case ScalarType::Int8:    f(ScalarTraits<ScalarType::Int8>());    return true;
+    case ScalarType::UInt8:   f(ScalarTraits<ScalarType::UInt8>());   return true;
+    case ScalarType::Int16:   f(ScalarTraits<ScalarType::Int16>());   return true;
+    case ScalarType::UInt16:  f(ScalarTraits<ScalarType::UInt16>());  return true;
+    case ScalarType::Int32:   f(ScalarTraits<ScalarType::Int32>());   return true;
+    case ScalarType::UInt32:  f(ScalarTraits<ScalarType::UInt32>());  return true;
+    case ScalarType::Float32: f(ScalarTraits<ScalarType::Float32>()); return true;
+    case ScalarType::Float64: f(ScalarTraits<ScalarType::Float64>()); return true;
+    default: return false;
+    }
+}
+
+// ScalarType::Invalid for an unknown code
+constexpr ScalarType scalarTypeFromIGTL(int code) {
+    switch (code) {
+    case 2: case 3: case 4: case 5: case 6: case 7: case 10: case 11:
+        return static_cast<ScalarType>(code);
+    default:
+        return ScalarType::Invalid;
+    }
+}
+
+// Bytes per scalar; 0 for ScalarType::Invalid
+constexpr int scalarSize(ScalarType type) {
+    switch (type) {
+    case ScalarType::Int8:
+    case ScalarType::UInt8:   return 1;
+    case ScalarType::Int16:
+    case ScalarType::UInt16:  return 2;
+    case ScalarType::Int32:
+    case ScalarType::UInt32:
+    case ScalarType::Float32: return 4;
+    case ScalarType::Float64: return 8;
+    default:                  return 0;
+    }
+}
+
+constexpr bool isFloatType(ScalarType type) {
+    return type == ScalarType::Float32 || type == ScalarType::Float64;
+}
+
+constexpr bool isSignedType(ScalarType type) {
+    return type == ScalarType::Int8 || type == ScalarType::Int16 || type == ScalarType::Int32 || isFloatType(type);
+}
+
+// The 'dtype' name ("uint16", ...), or "" for ScalarType::Invalid
+MRIGTL_LIB_EXPORT const char* scalarTypeName(ScalarType type);
+// ScalarType::Invalid for an unknown name. Neither allocates.
+MRIGTL_LIB_EXPORT ScalarType scalarTypeFromName(const QString& name);
+MRIGTL_LIB_EXPORT ScalarType scalarTypeFromName(const std::string& name);
+
+} // namespace mrigtlbridge
@@ -0,0 +1,80 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <string>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace mrigtlbridge {
+
+// Single-producer/single-consumer byte ring in POSIX shared memory (Linux).
+//
+// Each record carries one OpenIGTLink-framed message (58-byte header + body),
+// so a co-located application can read exactly what would have been sent over
+// TCP. The writer copies the packed message into the ring once; the reader
+// gets a pointer into the mapping and unpacks in place. Waiting on both sides
+// uses process-shared futexes on words in the mapping, so an idle ring costs
+// no CPU.
+class SharedMemoryRing {
+public:
+    MRIGTL_LIB_EXPORT SharedMemoryRing();
+    MRIGTL_LIB_EXPORT ~SharedMemoryRing();
+
+    // Create the ring. 'capacity' is rounded up to a power of two. Fails if a
+    // ring of that name belongs to a process that is still running; a ring
+    // left behind by one that exited is replaced.
+    MRIGTL_LIB_EXPORT bool create(const std::string& name, size_t capacity);
+    // Attach to a ring created by another process
+    MRIGTL_LIB_EXPORT bool open(const std::string& name);
+    MRIGTL_LIB_EXPORT void close();
+
+    MRIGTL_LIB_EXPORT bool isOpen() const { return header != nullptr; }
+    MRIGTL_LIB_EXPORT size_t getCapacity() const;
+    // Largest message that can be written (half the capacity)
+    MRIGTL_LIB_EXPORT size_t getMaxMessageSize() const { return getCapacity() / 2; }
+
+    // Writer side. Copies 'size' bytes as one record. Waits up to 'timeoutMs'
+    // for space (0: do not wait, -1: wait forever). Returns false if the
+    // message did not fit in time or is larger than getMaxMessageSize().
+    MRIGTL_LIB_EXPORT bool write(const void* data, size_t size, int timeoutMs);
+
+    // Reader side. Returns a pointer to the next record (valid until release())
+    // or nullptr if nothing arrived within 'timeoutMs'.
+    MRIGTL_LIB_EXPORT const void* peek(size_t& size, int timeoutMs);
+    MRIGTL_LIB_EXPORT void release();
+
+    // Bytes currently queued
+    MRIGTL_LIB_EXPORT size_t getUsed() const;
+
+private:
+    struct Header;
+
+    bool map(int fd, size_t totalSize);
+    static bool isStale(const std::string& name);
+    static bool futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs);
+    static void futexWake(std::atomic<uint32_t>* word);
+
+    Header* header;
+    unsigned char* data;
+    size_t mappedSize;
+    size_t pendingRelease;  // Record size returned by the last peek()
+    std::string shmName;
+    bool owner;
+};
+
+} // namespace mrigtlbridge
@@ -73,6 +73,9 @@ public:
     void emitSignal(const QString& name, const QVariant& param = QVariant());
     void run() override;
 
+    // Signals waiting to be forwarded to the SignalManager
+    size_t getQueueSize();
+
 private:
     struct SignalData {
         QString name;
@@ -0,0 +1,28 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+
+namespace mrigtlbridge {
+
+// Peak resident set size of the process in KiB (0 if unknown)
+MRIGTL_LIB_EXPORT long getPeakRSS();
+
+// Print '<name> startup: <ms> ms, peak RSS: <MB> MB' to stdout. Used by the
+// GUI and headless executables with --startup-report to compare the two.
+MRIGTL_LIB_EXPORT void printStartupReport(const char* name, qint64 elapsedMs);
+
+} // namespace mrigtlbridge
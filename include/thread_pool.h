@@ -0,0 +1,61 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mrigtlbridge {
+
+// Fixed-size pool of worker threads for CPU-bound work in the simulator
+// (reslicing, per-plane acquisition).
+//
+// parallelFor() runs chunks on the workers and on the calling thread, and
+// the caller only waits for chunks already being executed, so it may be
+// called from inside a pool task without deadlocking.
+class ThreadPool {
+public:
+    // 'threads' = 0: one per hardware thread
+    MRIGTL_LIB_EXPORT explicit ThreadPool(int threads = 0);
+    MRIGTL_LIB_EXPORT ~ThreadPool();
+
+    // Process-wide pool (created on first use)
+    MRIGTL_LIB_EXPORT static ThreadPool* shared();
+
+    MRIGTL_LIB_EXPORT int getThreadCount() const { return static_cast<int>(workers.size()); }
+
+    MRIGTL_LIB_EXPORT std::future<void> submit(std::function<void()> task);
+
+    // Call fn(begin, end) for chunks of [0, count) of at least 'grain' items.
+    // Returns when all chunks are done.
+    MRIGTL_LIB_EXPORT void parallelFor(int count, const std::function<void(int, int)>& fn, int grain = 1);
+
+private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+};
+
+} // namespace mrigtlbridge
@@ -0,0 +1,62 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#pragma once
+
+#include "mrigtl_lib_export.h"
+#include <vector>
+
+namespace mrigtlbridge {
+
+class ThreadPool;
+
+// Trilinear resampling of a 3D reference volume along an arbitrary plane.
+//
+// The volume is centered at the origin of the physical (patient) space. A
+// plane is given by the 4x4 matrix received as TRANSFORM: the first two
+// columns are the in-plane directions and the last column is the center of
+// the plane in mm. Rows are split across a thread pool; on x86-64 each row
+// is processed 8 pixels at a time with AVX2 gathers when the CPU supports it.
+class VolumeReslicer {
+public:
+    MRIGTL_LIB_EXPORT VolumeReslicer();
+
+    // Copy the reference volume (x fastest). 'spacing' is in mm.
+    MRIGTL_LIB_EXPORT void setVolume(const float* data, int nx, int ny, int nz, const double spacing[3]);
+    MRIGTL_LIB_EXPORT bool hasVolume() const { return !volume.empty(); }
+
+    // Resample a width x height image with square pixels of 'pixelSpacing' mm.
+    // 'scalarType' is an OpenIGTLink scalar type (see ScalarType); values
+    // are rounded and clamped to its range. Voxels outside the volume are 0.
+    // With 'pool' = nullptr the calling thread does all the work.
+    MRIGTL_LIB_EXPORT void reslice(const double matrix[4][4], int width, int height, double pixelSpacing,
+                                   int scalarType, void* output, ThreadPool* pool = nullptr) const;
+
+    // Select the AVX2 kernel when available (default) or the scalar one
+    MRIGTL_LIB_EXPORT void setVectorized(bool enable) { vectorized = enable && hasAVX2(); }
+    MRIGTL_LIB_EXPORT bool isVectorized() const { return vectorized; }
+    MRIGTL_LIB_EXPORT static bool hasAVX2();
+
+private:
+    // Sample 'count' pixels starting at voxel position 'start' and advancing by 'step'
+    void sampleRow(const float start[3], const float step[3], int count, float* out) const;
+    void sampleRowAVX2(const float start[3], const float step[3], int count, float* out) const;
+
+    std::vector<float> volume;
+    int dim[3];
+    double spacing[3];
+    bool vectorized;
+};
+
+} // namespace mrigtlbridge
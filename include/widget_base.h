@@ -24,7 +24,7 @@
 #include <QTimer>
 #include <QMutex>
 #include <QQueue>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <memory>
 
 namespace mrigtlbridge {
@@ -32,7 +32,7 @@ namespace mrigtlbridge {
 class SignalManager;
 class ListenerBase;
 
-class MRIGTL_QT_EXPORT WidgetBase : public QObject {
+class MRIGTL_GUI_QT_EXPORT WidgetBase : public QObject {
     Q_OBJECT
 
 public:
@@ -54,6 +54,17 @@ public:
     // Stop the listener
     virtual void stopListener();
 
+    // GUI-thread cost of the console (see flushConsoleBuffer())
+    struct ConsoleStatistics {
+        quint64 flushes = 0;    // Flushes that inserted text
+        quint64 lines = 0;      // Lines inserted
+        quint64 dropped = 0;    // Lines dropped because the buffer was full
+        double lastMs = 0.0;    // Time of the last flush
+        double maxMs = 0.0;
+        double totalMs = 0.0;
+    };
+    ConsoleStatistics getConsoleStatistics();
+
 signals:
     void messageBoxSignal(const QString& message);
 
@@ -76,16 +87,21 @@ protected:
     // Signal list
     QStringList signalList;
     
+    // Read-only plain-text console that keeps the last MAX_CONSOLE_LINES lines
+    QPlainTextEdit* createConsole(QWidget* parent);
+
     // Thread-safe console buffer (protected for derived classes)
-    void addConsoleMessage(QTextEdit* console, const QString& message);
+    void addConsoleMessage(QPlainTextEdit* console, const QString& message);
     
 private:
     // Console buffer implementation
     QQueue<QString> consoleBuffer;
     QMutex consoleBufferMutex;
     QTimer* consoleUpdateTimer;
-    QTextEdit* targetConsole;
+    QPlainTextEdit* targetConsole;
+    ConsoleStatistics consoleStatistics;
     static const int MAX_CONSOLE_BUFFER_SIZE = 1000;
+    static const int MAX_CONSOLE_LINES = 5000;
 };
 
 } // namespace mrigtlbridge
\ No newline at end of file
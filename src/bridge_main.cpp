@@ -0,0 +1,154 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Headless MR-OpenIGTLink bridge (QtCore only).
+//
+//   mrigtl_bridge [--config bridge.ini] [--igtl key=value ...] [--mrsim key=value ...]
+//
+// The config file is an INI file with the groups [igtl] and [mrsim] for the
+// listener parameters and [bridge] for the options below (autoStart, quiet,
+// duration). Command line options override the file.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QSettings>
+#include <QStringList>
+#include <QTimer>
+#include <csignal>
+#include <cstdio>
+
+#include "headless_bridge.h"
+#include "startup_report.h"
+
+namespace {
+
+QVariantMap readGroup(QSettings& settings, const QString& group) {
+    QVariantMap param;
+    settings.beginGroup(group);
+    for (const QString& key : settings.childKeys()) {
+        param[key] = settings.value(key);
+    }
+    settings.endGroup();
+    return param;
+}
+
+// 'key=value' pairs; returns false on a malformed pair
+bool readPairs(const QStringList& pairs, QVariantMap& param) {
+    for (const QString& pair : pairs) {
+        int separator = pair.indexOf('=');
+        if (separator <= 0) {
+            fprintf(stderr, "Invalid parameter '%s' (expected key=value)\n", pair.toUtf8().constData());
+            return false;
+        }
+        param[pair.left(separator)] = pair.mid(separator + 1);
+    }
+    return true;
+}
+
+// Set by SIGINT/SIGTERM and polled from the event loop (quit() is not
+// async-signal-safe)
+volatile std::sig_atomic_t terminateRequested = 0;
+
+void onTerminate(int) {
+    terminateRequested = 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QElapsedTimer startup;
+    startup.start();
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mrigtl_bridge");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless MR-OpenIGTLink bridge");
+    parser.addHelpOption();
+    QCommandLineOption configOption(QStringList() << "c" << "config", "INI file with [igtl], [mrsim] and [bridge] groups.", "file");
+    QCommandLineOption igtlOption("igtl", "IGTL listener parameter, e.g. --igtl port=18944 (repeatable).", "key=value");
+    QCommandLineOption mrSimOption("mrsim", "MR simulator parameter, e.g. --mrsim fps=10 (repeatable).", "key=value");
+    QCommandLineOption noStartOption("no-start", "Do not start the sequence when the listeners are up.");
+    QCommandLineOption durationOption("duration", "Exit after the given number of seconds.", "seconds");
+    QCommandLineOption quietOption(QStringList() << "q" << "quiet", "Do not print console text.");
+    QCommandLineOption verboseOption("verbose", "Print debug messages.");
+    QCommandLineOption startupOption("startup-report", "Print the startup time and peak RSS, then exit.");
+    parser.addOption(configOption);
+    parser.addOption(igtlOption);
+    parser.addOption(mrSimOption);
+    parser.addOption(noStartOption);
+    parser.addOption(durationOption);
+    parser.addOption(quietOption);
+    parser.addOption(verboseOption);
+    parser.addOption(startupOption);
+    parser.process(app);
+
+    QVariantMap igtlParameter;
+    QVariantMap mrSimParameter;
+    QVariantMap bridgeParameter;
+    if (parser.isSet(configOption)) {
+        QSettings settings(parser.value(configOption), QSettings::IniFormat);
+        igtlParameter = readGroup(settings, "igtl");
+        mrSimParameter = readGroup(settings, "mrsim");
+        bridgeParameter = readGroup(settings, "bridge");
+    }
+    if (!readPairs(parser.values(igtlOption), igtlParameter) || !readPairs(parser.values(mrSimOption), mrSimParameter)) {
+        return 1;
+    }
+
+    bool autoStart = bridgeParameter.value("autoStart", true).toBool() && !parser.isSet(noStartOption);
+    bool quiet = bridgeParameter.value("quiet", false).toBool() || parser.isSet(quietOption);
+    double duration = parser.isSet(durationOption) ? parser.value(durationOption).toDouble()
+                                                   : bridgeParameter.value("duration", 0.0).toDouble();
+
+    // The GUI enables debug output; here it is opt-in, since the listeners
+    // log every message they send
+    QLoggingCategory::defaultCategory()->setEnabled(QtDebugMsg, parser.isSet(verboseOption));
+
+    mrigtlbridge::HeadlessBridge bridge;
+    bridge.setIGTLParameters(igtlParameter);
+    bridge.setMRSimParameters(mrSimParameter);
+    bridge.setAutoStart(autoStart);
+    bridge.setQuiet(quiet);
+    QObject::connect(&bridge, &mrigtlbridge::HeadlessBridge::finished, &app, &QCoreApplication::quit);
+
+    std::signal(SIGINT, onTerminate);
+    std::signal(SIGTERM, onTerminate);
+    QTimer terminateTimer;
+    QObject::connect(&terminateTimer, &QTimer::timeout, &app, []() {
+        if (terminateRequested) {
+            QCoreApplication::quit();
+        }
+    });
+    terminateTimer.start(200);
+
+    if (parser.isSet(startupOption)) {
+        // Up to the first pass of the event loop, as for the GUI
+        QTimer::singleShot(0, &app, [&startup]() {
+            mrigtlbridge::printStartupReport("mrigtl_bridge", startup.elapsed());
+            QCoreApplication::quit();
+        });
+    } else {
+        bridge.start();
+        if (duration > 0.0) {
+            QTimer::singleShot(static_cast<int>(duration * 1000.0), &app, &QCoreApplication::quit);
+        }
+    }
+
+    int result = app.exec();
+    bridge.stop();
+    return result;
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "bridge_metrics.h"
+#include <chrono>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// Bucket 1 + 4 * octave + quarter for durations of 1 us and more
+int bucketIndex(qint64 ns) {
+    quint64 us = ns > 0 ? static_cast<quint64>(ns) / 1000 : 0;
+    if (us == 0) {
+        return 0;
+    }
+    int octave = 0;
+    while (us >> (octave + 1)) {
+        octave++;
+    }
+    int quarter = (octave >= 2) ? static_cast<int>((us >> (octave - 2)) & 3)
+                                : (octave == 1) ? static_cast<int>(us & 1) * 2 : 0;
+    int index = 1 + 4 * octave + quarter;
+    return index < BridgeMetrics::Histogram::BucketCount ? index : BridgeMetrics::Histogram::BucketCount - 1;
+}
+
+// Lower bound of a bucket in us
+double bucketStart(int index) {
+    if (index <= 0) {
+        return 0.0;
+    }
+    int octave = (index - 1) / 4;
+    int quarter = (index - 1) % 4;
+    return static_cast<double>(1ULL << octave) * (1.0 + quarter / 4.0);
+}
+
+} // namespace
+
+void BridgeMetrics::Histogram::record(qint64 ns) {
+    buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void BridgeMetrics::Histogram::read(quint64 counts[BucketCount]) const {
+    for (int i = 0; i < BucketCount; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+double BridgeMetrics::Histogram::percentile(const quint64* now, const quint64* before, double p) {
+    quint64 total = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        total += now[i] - before[i];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    // Middle of the bucket that holds the requested rank
+    quint64 rank = static_cast<quint64>(p * (total - 1)) + 1;
+    quint64 count = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        count += now[i] - before[i];
+        if (count >= rank) {
+            double end = (i + 1 < BucketCount) ? bucketStart(i + 1) : bucketStart(i) * 1.25;
+            return (bucketStart(i) + end) / 2.0 / 1000.0;
+        }
+    }
+    return 0.0;
+}
+
+double BridgeMetrics::Histogram::lowerBound(int bucket) {
+    return bucketStart(bucket) / 1000.0;
+}
+
+BridgeMetrics& BridgeMetrics::instance() {
+    static BridgeMetrics metrics;
+    return metrics;
+}
+
+qint64 BridgeMetrics::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BridgeMetrics::Snapshot BridgeMetrics::snapshot() const {
+    Snapshot s;
+    s.time = now();
+    s.imagesSent = imagesSent.load(std::memory_order_relaxed);
+    s.imageBytesSent = imageBytesSent.load(std::memory_order_relaxed);
+    s.trackingSent = trackingSent.load(std::memory_order_relaxed);
+    s.transformsReceived = transformsReceived.load(std::memory_order_relaxed);
+    s.messagesDropped = messagesDropped.load(std::memory_order_relaxed);
+    s.queuedMessages = queuedMessages.load(std::memory_order_relaxed);
+    s.deltaFrames = deltaFrames.load(std::memory_order_relaxed);
+    s.deltaKeyframes = deltaKeyframes.load(std::memory_order_relaxed);
+    s.deltaBytesSaved = deltaBytesSaved.load(std::memory_order_relaxed);
+    s.imagesCompressed = imagesCompressed.load(std::memory_order_relaxed);
+    s.compressInBytes = compressInBytes.load(std::memory_order_relaxed);
+    s.compressOutBytes = compressOutBytes.load(std::memory_order_relaxed);
+    sendTime.read(s.sendTime);
+    planeLatency.read(s.planeLatency);
+    diffTime.read(s.diffTime);
+    compressTime.read(s.compressTime);
+    return s;
+}
+
+} // namespace mrigtlbridge
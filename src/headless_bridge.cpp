@@ -0,0 +1,128 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "headless_bridge.h"
+#include "signal_manager.h"
+#include "igtl_listener.h"
+#include "mrsim_listener.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QThread>
+#include <cstdio>
+
+namespace mrigtlbridge {
+
+HeadlessBridge::HeadlessBridge(QObject* parent)
+    : QObject(parent),
+      signalManager(new SignalManager(this)),
+      igtlListener(nullptr),
+      mrSimListener(nullptr),
+      autoStart(true),
+      quiet(false),
+      stopping(false) {
+    signalManager->connectSlot("consoleTextIGTL", this, SLOT(onConsoleTextIGTL(QString)));
+    signalManager->connectSlot("consoleTextMR", this, SLOT(onConsoleTextMR(QString)));
+    signalManager->connectSlot("listenerConnected", this, SLOT(onListenerConnected(QString)));
+    signalManager->connectSlot("listenerTerminated", this, SLOT(onListenerTerminated(QString)));
+}
+
+HeadlessBridge::~HeadlessBridge() {
+    stop();
+}
+
+void HeadlessBridge::start() {
+    try {
+        // Same order as the GUI: the IGTL side first, so that the simulator's
+        // first images have somewhere to go
+        if (!igtlListener) {
+            igtlListener = new IGTLListener();
+            igtlListener->connectSlots(signalManager);
+            igtlListener->configure(igtlParameter);
+            igtlListener->start();
+        }
+        if (!mrSimListener) {
+            mrSimListener = new MRSimListener();
+            mrSimListener->connectSlots(signalManager);
+            mrSimListener->configure(mrSimParameter);
+            mrSimListener->start();
+        }
+    } catch (const std::exception& e) {
+        qCritical() << "Failed to start the listeners: " << e.what();
+        stop();
+        emit finished();
+    }
+}
+
+void HeadlessBridge::stop() {
+    if (stopping) {
+        return;
+    }
+    stopping = true;
+
+    // As IGTLWidget::onDisconnectButtonClicked(): stop the sequence, then
+    // close the connection, then the threads
+    if (igtlListener || mrSimListener) {
+        signalManager->emitSignal("stopSequence");
+        signalManager->emitSignal("disconnectIGTL");
+        QThread::msleep(100);
+    }
+    if (mrSimListener) {
+        mrSimListener->stop();
+        delete mrSimListener;
+        mrSimListener = nullptr;
+    }
+    if (igtlListener) {
+        igtlListener->stop();
+        delete igtlListener;
+        igtlListener = nullptr;
+    }
+    connected.clear();
+}
+
+void HeadlessBridge::print(const char* source, const QString& text) {
+    if (quiet) {
+        return;
+    }
+    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
+    fprintf(stdout, "[%s] %s: %s\n", timestamp.toUtf8().constData(), source, text.toUtf8().constData());
+    fflush(stdout);
+}
+
+void HeadlessBridge::onConsoleTextIGTL(const QString& text) {
+    print("IGTL", text);
+}
+
+void HeadlessBridge::onConsoleTextMR(const QString& text) {
+    print("MR", text);
+}
+
+void HeadlessBridge::onListenerConnected(const QString& className) {
+    connected.insert(className);
+    if (autoStart && connected.contains(IGTLListener::staticMetaObject.className()) &&
+        connected.contains(MRSimListener::staticMetaObject.className())) {
+        signalManager->emitSignal("startSequence");
+    }
+}
+
+void HeadlessBridge::onListenerTerminated(const QString& className) {
+    // Emitted by a listener thread that has ended (e.g. the connection could
+    // not be established or was closed), and again when it is deleted
+    if (stopping) {
+        return;
+    }
+    print("Bridge", QString("%1 terminated").arg(className));
+    emit finished();
+}
+
+} // namespace mrigtlbridge
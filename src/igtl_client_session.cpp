@@ -0,0 +1,161 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtl_client_session.h"
+#include "bridge_metrics.h"
+#include <QDebug>
+#include <chrono>
+
+namespace mrigtlbridge {
+
+IGTLClientSession::IGTLClientSession(igtl::ClientSocket::Pointer clientSocket, const QString& name,
+                                     const QString& address, QObject* parent)
+    : QThread(parent),
+      socket(clientSocket),
+      peerName(name),
+      peerAddress(address),
+      stopRequested(false),
+      alive(true),
+      slowConsumerPolicy(DropOldest),
+      maxQueueDepth(4),
+      blockTimeout(100),
+      sentCount(0),
+      droppedCount(0),
+      customReduction(false),
+      imageCompression(false),
+      customCompression(false),
+      udpDestination(-1) {
+}
+
+IGTLClientSession::~IGTLClientSession() {
+    close();
+}
+
+IGTLClientSession::SlowConsumerPolicy IGTLClientSession::policyFromString(const QString& name) {
+    if (name == "dropNewest") {
+        return DropNewest;
+    } else if (name == "block") {
+        return Block;
+    } else if (name == "disconnect") {
+        return Disconnect;
+    }
+    return DropOldest;
+}
+
+bool IGTLClientSession::enqueue(const igtl::MessageBase::Pointer& msg) {
+    if (!alive || stopRequested) {
+        return false;
+    }
+
+    BridgeMetrics& metrics = BridgeMetrics::instance();
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (static_cast<int>(sendQueue.size()) >= maxQueueDepth) {
+            switch (slowConsumerPolicy) {
+            case DropOldest:
+                sendQueue.pop_front();
+                droppedCount++;
+                metrics.queuedMessages--;
+                metrics.messagesDropped++;
+                break;
+            case DropNewest:
+            case Block:
+                // Block: the producer has already waited in waitForSpace()
+                droppedCount++;
+                metrics.messagesDropped++;
+                return false;
+            case Disconnect:
+                qDebug() << "IGTLClientSession: client" << peerName << "is too slow. Disconnecting.";
+                alive = false;
+                droppedCount++;
+                metrics.messagesDropped++;
+                lock.unlock();
+                queueCondition.notify_all();
+                return false;
+            }
+        }
+        sendQueue.push_back(msg);
+        metrics.queuedMessages++;
+    }
+    queueCondition.notify_all();
+    return true;
+}
+
+bool IGTLClientSession::waitForSpace(std::chrono::steady_clock::time_point start) {
+    if (slowConsumerPolicy != Block) {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(queueMutex);
+    return queueCondition.wait_until(lock, start + std::chrono::milliseconds(blockTimeout), [this]() {
+        return static_cast<int>(sendQueue.size()) < maxQueueDepth || stopRequested || !alive;
+    });
+}
+
+int IGTLClientSession::getQueueDepth() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return static_cast<int>(sendQueue.size());
+}
+
+void IGTLClientSession::close() {
+    stopRequested = true;
+    queueCondition.notify_all();
+    if (isRunning()) {
+        wait();
+    }
+    alive = false;
+    if (socket) {
+        socket->CloseSocket();
+    }
+}
+
+void IGTLClientSession::run() {
+    // Keep draining after a stop request so that messages queued before close()
+    // (e.g. the DISCONNECT notification) still reach the client.
+    while (alive) {
+        igtl::MessageBase::Pointer msg;
+
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (sendQueue.empty() && !stopRequested) {
+                queueCondition.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            if (sendQueue.empty()) {
+                if (stopRequested) {
+                    break;
+                }
+                continue;
+            }
+            msg = sendQueue.front();
+            sendQueue.pop_front();
+            BridgeMetrics::instance().queuedMessages--;
+        }
+        // Wake up a producer waiting under the 'Block' policy
+        queueCondition.notify_all();
+
+        // The message has been packed by the producer; only the pack buffer is read here.
+        if (socket->Send(msg->GetPackPointer(), msg->GetPackSize()) > 0) {
+            sentCount++;
+        } else {
+            qDebug() << "IGTLClientSession: send to" << peerName << "failed. Closing session.";
+            alive = false;
+        }
+    }
+
+    // Release the references held by the queue
+    std::lock_guard<std::mutex> lock(queueMutex);
+    BridgeMetrics::instance().queuedMessages -= static_cast<qint64>(sendQueue.size());
+    sendQueue.clear();
+}
+
+} // namespace mrigtlbridge
@@ -0,0 +1,624 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtl_io_engine.h"
+#include "bridge_metrics.h"
+#include <igtl_header.h>
+#include <QDebug>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace mrigtlbridge {
+
+// epoll user data for the wake-up eventfd. Connection IDs start at 1.
+static const uint64_t WAKE_ID = 0;
+static const int MAX_EVENTS = 64;
+
+static bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+IGTLIOEngine::IGTLIOEngine()
+    : epollFd(-1),
+      wakeFd(-1),
+      running(false),
+      nextId(1),
+      maxQueueDepth(0) {
+}
+
+IGTLIOEngine::~IGTLIOEngine() {
+    stop();
+}
+
+IGTLIOEngine* IGTLIOEngine::shared() {
+    // Listeners attach from their own threads; the initializer runs start() once
+    static IGTLIOEngine engine;
+    static const bool started = engine.start();
+    (void)started;
+    return &engine;
+}
+
+bool IGTLIOEngine::start() {
+    if (running) {
+        return true;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        qCritical() << "IGTLIOEngine::start(): Could not create epoll/eventfd:" << strerror(errno);
+        stop();
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_ID;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+    // Sockets registered before start() were added to a previous epoll set
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : connections) {
+            epoll_event cev{};
+            cev.events = EPOLLIN;
+            cev.data.u64 = static_cast<uint64_t>(entry.first);
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, entry.second->fd, &cev);
+            entry.second->writeArmed = false;
+        }
+    }
+
+    running = true;
+    thread = std::thread(&IGTLIOEngine::run, this);
+    return true;
+}
+
+void IGTLIOEngine::stop() {
+    if (running) {
+        running = false;
+        wake();
+    }
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : connections) {
+        ::close(entry.second->fd);
+    }
+    connections.clear();
+    pendingClose.clear();
+
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    if (epollFd >= 0) {
+        ::close(epollFd);
+        epollFd = -1;
+    }
+}
+
+void IGTLIOEngine::setMessageHandler(const std::string& deviceType, MessageHandler handler) {
+    std::lock_guard<std::mutex> lock(handlerMutex);
+    handlers[deviceType] = handler;
+}
+
+void IGTLIOEngine::setConnectionMessageHandler(ConnectionId id, MessageHandler handler) {
+    std::lock_guard<std::recursive_mutex> dispatchLock(dispatchMutex);
+    std::lock_guard<std::mutex> lock(handlerMutex);
+    if (handler) {
+        connectionHandlers[id] = handler;
+    } else {
+        connectionHandlers.erase(id);
+    }
+}
+
+void IGTLIOEngine::setConnectionHandler(ConnectionHandler handler) {
+    std::lock_guard<std::mutex> lock(handlerMutex);
+    connectionHandler = handler;
+}
+
+IGTLIOEngine::ConnectionId IGTLIOEngine::connectTo(const std::string& host, int port) {
+    return connectTo(host, port, ConnectionSettings());
+}
+
+IGTLIOEngine::ConnectionId IGTLIOEngine::connectTo(const std::string& host, int port,
+                                                   const ConnectionSettings& settings) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        qWarning() << "IGTLIOEngine::connectTo(): Could not resolve" << host.c_str();
+        return -1;
+    }
+
+    // The connection itself is blocking (it is done once); all I/O after that is not.
+    int fd = socket(result->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+        qWarning() << "IGTLIOEngine::connectTo(): Connection to" << host.c_str() << port << "failed:" << strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        freeaddrinfo(result);
+        return -1;
+    }
+    freeaddrinfo(result);
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setNonBlocking(fd);
+    return addConnection(fd, false, -1, settings);
+}
+
+IGTLIOEngine::ConnectionId IGTLIOEngine::listenOn(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+        qWarning() << "IGTLIOEngine::listenOn(): Could not listen on port" << port << ":" << strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    setNonBlocking(fd);
+    return addConnection(fd, true, -1, ConnectionSettings());
+}
+
+IGTLIOEngine::ConnectionId IGTLIOEngine::addConnection(int fd, bool listening, ConnectionId parent,
+                                                       const ConnectionSettings& settings) {
+    auto conn = std::make_unique<Connection>();
+    conn->fd = fd;
+    conn->listening = listening;
+    conn->parent = parent;
+    conn->maxQueueDepth = settings.maxQueueDepth;
+
+    ConnectionId id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = nextId++;
+        conn->id = id;
+        connections[id] = std::move(conn);
+    }
+    {
+        // Before the socket is polled
+        std::lock_guard<std::mutex> lock(handlerMutex);
+        if (settings.messageHandler) {
+            connectionHandlers[id] = settings.messageHandler;
+        }
+        if (settings.connectionHandler) {
+            connectionStateHandlers[id] = settings.connectionHandler;
+        }
+    }
+
+    if (epollFd >= 0) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = static_cast<uint64_t>(id);
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    return id;
+}
+
+void IGTLIOEngine::close(ConnectionId id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingClose.push_back(id);
+    }
+    wake();
+}
+
+void IGTLIOEngine::detach(ConnectionId id) {
+    {
+        std::lock_guard<std::recursive_mutex> dispatchLock(dispatchMutex);
+        std::lock_guard<std::mutex> lock(handlerMutex);
+        connectionHandlers.erase(id);
+        connectionStateHandlers.erase(id);
+    }
+    close(id);
+}
+
+bool IGTLIOEngine::send(ConnectionId id, const igtl::MessageBase::Pointer& msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = connections.find(id);
+        if (it == connections.end() || it->second->listening) {
+            return false;
+        }
+        enqueueLocked(it->second.get(), msg);
+    }
+    wake();
+    return true;
+}
+
+int IGTLIOEngine::broadcast(const igtl::MessageBase::Pointer& msg) {
+    int queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : connections) {
+            if (!entry.second->listening) {
+                enqueueLocked(entry.second.get(), msg);
+                queued++;
+            }
+        }
+    }
+    if (queued > 0) {
+        wake();
+    }
+    return queued;
+}
+
+void IGTLIOEngine::enqueueLocked(Connection* conn, const igtl::MessageBase::Pointer& msg) {
+    int depth = (conn->maxQueueDepth >= 0) ? conn->maxQueueDepth : maxQueueDepth.load();
+    if (depth > 0 && static_cast<int>(conn->outQueue.size()) >= depth) {
+        // The front message may be partially written; it must go out intact.
+        auto victim = conn->outQueue.begin();
+        if (conn->outOffset > 0) {
+            ++victim;
+        }
+        if (victim != conn->outQueue.end()) {
+            conn->outQueue.erase(victim);
+            stats.messagesDropped++;
+            BridgeMetrics::instance().messagesDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    conn->outQueue.push_back(msg);
+}
+
+bool IGTLIOEngine::isConnected(ConnectionId id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return connections.find(id) != connections.end();
+}
+
+int IGTLIOEngine::getConnectionCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (auto& entry : connections) {
+        if (!entry.second->listening) {
+            count++;
+        }
+    }
+    return count;
+}
+
+IGTLIOEngine::Statistics IGTLIOEngine::getStatistics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void IGTLIOEngine::wake() {
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t r = ::write(wakeFd, &one, sizeof(one));
+        (void)r;
+    }
+}
+
+void IGTLIOEngine::run() {
+    epoll_event events[MAX_EVENTS];
+    std::vector<igtl::MessageBase::Pointer> complete;
+
+    while (running) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, 100);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCritical() << "IGTLIOEngine::run(): epoll_wait failed:" << strerror(errno);
+            break;
+        }
+
+        bool flushAll = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.wakeups++;
+        }
+
+        for (int i = 0; i < n; i++) {
+            ConnectionId id = static_cast<ConnectionId>(events[i].data.u64);
+            if (events[i].data.u64 == WAKE_ID) {
+                uint64_t value;
+                while (::read(wakeFd, &value, sizeof(value)) > 0) {
+                }
+                flushAll = true;
+                continue;
+            }
+
+            // Connections are only removed on this thread, so the pointer stays
+            // valid after the lookup.
+            Connection* conn = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = connections.find(id);
+                if (it != connections.end()) {
+                    conn = it->second.get();
+                }
+            }
+            if (!conn) {
+                continue;
+            }
+
+            if (conn->listening) {
+                handleAccept(conn);
+                continue;
+            }
+
+            bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+            if (alive && (events[i].events & EPOLLIN)) {
+                complete.clear();
+                alive = handleReadable(conn, complete);
+                for (const auto& msg : complete) {
+                    dispatch(id, msg);
+                }
+            }
+            if (alive && (events[i].events & EPOLLOUT)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                alive = flushOutput(conn);
+            }
+            if (!alive) {
+                removeConnection(id);
+            }
+        }
+
+        // Apply requests made from other threads
+        std::vector<ConnectionId> closing;
+        std::vector<ConnectionId> failed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing.swap(pendingClose);
+            if (flushAll) {
+                for (auto& entry : connections) {
+                    Connection* conn = entry.second.get();
+                    if (!conn->listening && !conn->outQueue.empty() && !conn->writeArmed) {
+                        if (!flushOutput(conn)) {
+                            failed.push_back(entry.first);
+                        }
+                    }
+                }
+            }
+        }
+        for (ConnectionId id : failed) {
+            removeConnection(id);
+        }
+        for (ConnectionId id : closing) {
+            removeConnection(id);
+        }
+    }
+}
+
+void IGTLIOEngine::handleAccept(Connection* server) {
+    for (;;) {
+        int fd = accept4(server->fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                qWarning() << "IGTLIOEngine: accept failed:" << strerror(errno);
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        ConnectionId id = addConnection(fd, false, server->id, ConnectionSettings());
+
+        std::lock_guard<std::recursive_mutex> dispatchLock(dispatchMutex);
+        ConnectionHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(handlerMutex);
+            auto it = connectionHandlers.find(server->id);
+            if (it != connectionHandlers.end()) {
+                connectionHandlers[id] = it->second;
+            }
+            handler = connectionHandler;
+        }
+        if (handler) {
+            handler(id, true);
+        }
+    }
+}
+
+bool IGTLIOEngine::handleReadable(Connection* conn, std::vector<igtl::MessageBase::Pointer>& complete) {
+    // Read as much as is available without blocking. The header is read into the
+    // 58-byte header buffer; once it has been unpacked the body buffer is allocated
+    // and the rest of the message is read directly into it (no staging copy).
+    uint64_t received = 0;
+    bool alive = true;
+
+    for (;;) {
+        if (conn->inMsg.IsNull()) {
+            conn->inMsg = igtl::MessageBase::New();
+            conn->inMsg->InitPack();
+            conn->inHeaderDone = false;
+            conn->inReceived = 0;
+            conn->inBodySize = 0;
+        }
+
+        unsigned char* target;
+        size_t wanted;
+        if (!conn->inHeaderDone) {
+            target = static_cast<unsigned char*>(conn->inMsg->GetPackPointer()) + conn->inReceived;
+            wanted = IGTL_HEADER_SIZE - conn->inReceived;
+        } else {
+            target = static_cast<unsigned char*>(conn->inMsg->GetPackBodyPointer()) + conn->inReceived;
+            wanted = conn->inBodySize - conn->inReceived;
+        }
+
+        if (wanted > 0) {
+            ssize_t n = ::recv(conn->fd, target, wanted, 0);
+            if (n == 0) {
+                alive = false;  // Peer closed the connection
+                break;
+            }
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                alive = (errno == EAGAIN || errno == EWOULDBLOCK);
+                break;
+            }
+            conn->inReceived += static_cast<size_t>(n);
+            received += static_cast<uint64_t>(n);
+            if (static_cast<size_t>(n) < wanted) {
+                continue;
+            }
+        }
+
+        if (!conn->inHeaderDone) {
+            conn->inMsg->Unpack();
+            conn->inMsg->AllocatePack();  // Keeps the header, allocates the body
+            conn->inBodySize = static_cast<size_t>(conn->inMsg->GetPackBodySize());
+            conn->inHeaderDone = true;
+            conn->inReceived = 0;
+            continue;
+        }
+
+        complete.push_back(conn->inMsg);
+        conn->inMsg = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.bytesReceived += received;
+    stats.messagesReceived += complete.size();
+    return alive;
+}
+
+bool IGTLIOEngine::flushOutput(Connection* conn) {
+    // Called with 'mutex' held
+    while (!conn->outQueue.empty()) {
+        const igtl::MessageBase::Pointer& msg = conn->outQueue.front();
+        const char* data = static_cast<const char*>(msg->GetPackPointer());
+        size_t size = static_cast<size_t>(msg->GetPackSize());
+
+        ssize_t n = ::send(conn->fd, data + conn->outOffset, size - conn->outOffset, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                updateWriteInterest(conn, true);
+                return true;
+            }
+            return false;
+        }
+        conn->outOffset += static_cast<size_t>(n);
+        stats.bytesSent += static_cast<uint64_t>(n);
+        if (conn->outOffset == size) {
+            conn->outQueue.pop_front();
+            conn->outOffset = 0;
+            stats.messagesSent++;
+        }
+    }
+    updateWriteInterest(conn, false);
+    return true;
+}
+
+void IGTLIOEngine::updateWriteInterest(Connection* conn, bool enable) {
+    if (conn->writeArmed == enable) {
+        return;
+    }
+    epoll_event ev{};
+    ev.events = enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u64 = static_cast<uint64_t>(conn->id);
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->writeArmed = enable;
+}
+
+void IGTLIOEngine::removeConnection(ConnectionId id) {
+    bool wasClient = false;
+    std::vector<ConnectionId> children;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = connections.find(id);
+        if (it == connections.end()) {
+            return;
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second->fd, nullptr);
+        ::close(it->second->fd);
+        wasClient = !it->second->listening;
+        connections.erase(it);
+
+        // Closing a server also closes the connections it accepted
+        if (!wasClient) {
+            for (auto& entry : connections) {
+                if (entry.second->parent == id) {
+                    children.push_back(entry.first);
+                }
+            }
+        }
+    }
+    for (ConnectionId child : children) {
+        removeConnection(child);
+    }
+
+    std::lock_guard<std::recursive_mutex> dispatchLock(dispatchMutex);
+    ConnectionHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(handlerMutex);
+        connectionHandlers.erase(id);
+        auto it = connectionStateHandlers.find(id);
+        if (it != connectionStateHandlers.end()) {
+            handler = it->second;
+            connectionStateHandlers.erase(it);
+        } else {
+            handler = connectionHandler;
+        }
+    }
+    if (handler && wasClient) {
+        handler(id, false);
+    }
+}
+
+void IGTLIOEngine::dispatch(ConnectionId id, const igtl::MessageBase::Pointer& msg) {
+    std::lock_guard<std::recursive_mutex> dispatchLock(dispatchMutex);
+    MessageHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(handlerMutex);
+        auto cit = connectionHandlers.find(id);
+        if (cit != connectionHandlers.end()) {
+            handler = cit->second;
+        } else {
+            auto it = handlers.find(msg->GetDeviceType());
+            if (it == handlers.end()) {
+                it = handlers.find("");
+            }
+            if (it != handlers.end()) {
+                handler = it->second;
+            }
+        }
+    }
+    if (handler) {
+        handler(id, msg);
+    }
+}
+
+} // namespace mrigtlbridge
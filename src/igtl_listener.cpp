@@ -13,8 +13,18 @@
 =========================================================================*/
 
 #include "igtl_listener.h"
+#include "bridge_metrics.h"
+#include "image_assembly.h"
+#include "image_buffer_pool.h"
+#include "image_tap.h"
 #include "signal_manager.h"
-#include "common.h"
+#include "thread_pool.h"
+#include "scalar_type.h"
+#include "shm_ring.h"
+#include "igtl_udp_channel.h"
+#ifdef MRIGTL_WITH_IO_ENGINE
+#include "igtl_io_engine.h"
+#endif
 #include <QDebug>
 #include <QThread>
 #include <QTime>
@@ -26,6 +36,17 @@ namespace mrigtlbridge {
 
 IGTLListener::IGTLListener(QObject* parent)
     : ListenerBase(parent),
+      sessionCount(0),
+      ioEngine(nullptr),
+      ioConnection(-1),
+      ioClosed(false),
+      defaultCompression(false),
+      peerCompression(false),
+      deltaDropCount(0),
+      useBufferPool(true),
+      parallelCopyBytes(0),
+      deltaUpdates(false),
+      sendTimestamp(true),
       imgIntvQueueIndex(0),
       imgIntv(1.0),
       prevImgTime(0.0),
@@ -38,6 +59,21 @@ IGTLListener::IGTLListener(QObject* parent)
     parameter["ip"] = "localhost";
     parameter["port"] = "18944";
     parameter["sendTimestamp"] = 1;
+    parameter["mode"] = "client";                    // 'client' or 'server'
+    parameter["maxQueueDepth"] = 4;                  // Per-client send queue depth (server mode)
+    parameter["slowConsumerPolicy"] = "dropOldest";  // 'dropOldest', 'dropNewest', 'block' or 'disconnect'
+    parameter["ioEngine"] = 0;                       // 1: share one epoll I/O thread between listeners (client mode)
+    parameter["transport"] = "tcp";                  // 'tcp' or 'shm' (co-located application)
+    parameter["shmName"] = "/mrigtl";                // Shared memory rings: <shmName>_tx and <shmName>_rx
+    parameter["shmSize"] = 128;                      // Size of the outbound ring in MB
+    parameter["udpTracking"] = 0;                    // 1: send/receive TDATA and TRANSFORM over UDP (latest only)
+    parameter["udpPort"] = 18945;                    // Remote UDP port (client mode) or local UDP port (server mode)
+    parameter["bufferPool"] = 1;                     // 1: reuse IMAGE messages and their pack buffers (ImageBufferPool)
+    parameter["parallelCopyMB"] = 4;                 // Images of at least this size are assembled on the thread pool (0: never)
+    parameter["imageReduction"] = "";                // Crop/downsampling for every client, e.g. 'roi=64,64,0,128,128,0 factor=2 filter=box'
+    parameter["deltaUpdates"] = 0;                   // 1: send only the changed subvolume of consecutive images
+    parameter["keyframeInterval"] = 30;              // A full image at least every n images ('deltaUpdates')
+    parameter["imageCompression"] = 0;               // 1: send images to every client as lossless COMP_IMAGE
     
     // Initialize image interval queue
     imgIntvQueue.resize(5);
@@ -74,63 +110,178 @@ bool IGTLListener::initialize() {
     pendingTransMsg = false;
 
 
+    {
+        // The senders read these under the send lock; the parameter map must not
+        // be read from their threads
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        QString reductionError;
+        if (!defaultReduction.parse(parameter["imageReduction"].toString(), reductionError)) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: imageReduction: %1").arg(reductionError));
+        }
+        peerReduction = defaultReduction;
+        defaultCompression = (parameter["imageCompression"].toInt() == 1);
+        peerCompression = defaultCompression;
+        deltaEncoder.reset();
+        deltaEncoder.setKeyframeInterval(parameter["keyframeInterval"].toInt());
+        useBufferPool = (parameter["bufferPool"].toInt() == 1);
+        parallelCopyBytes = parameter["parallelCopyMB"].toLongLong() * 1024 * 1024;
+        deltaUpdates = (parameter["deltaUpdates"].toInt() == 1);
+        sendTimestamp = (parameter["sendTimestamp"].toInt() == 1);
+    }
+
     QString socketIP = parameter["ip"].toString();
     int socketPort = parameter["port"].toString().toInt();
 
-    return connect(socketIP, socketPort);
+    if (parameter["transport"].toString() == "shm") {
+        return openSharedMemory(parameter["shmName"].toString(), parameter["shmSize"].toInt());
+    }
+
+    bool connected;
+    if (parameter["mode"].toString() == "server") {
+        connected = listen(socketPort);
+    } else if (parameter["ioEngine"].toInt() == 1) {
+        connected = attachToIOEngine(socketIP, socketPort);
+    } else {
+        connected = connect(socketIP, socketPort);
+    }
+    if (connected && parameter["udpTracking"].toInt() == 1) {
+        openUdpChannel(socketIP, parameter["udpPort"].toInt());
+    }
+    return connected;
 }
 
 void IGTLListener::process() {
 
+    flushStreams();
+
+    if (udpChannel) {
+        // Only the newest sample per device reaches handleMessage(), and only
+        // from destinations: the server, or clients that sent UDP_TRACKING.
+        // Datagrams are not tied to a connection, so control messages must
+        // come over TCP.
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        for (const auto& msg : udpChannel->receiveLatest(0)) {
+            std::string type = msg->GetDeviceType();
+            if (type == "TDATA" || type == "TRANSFORM") {
+                handleMessage(msg);
+            }
+        }
+    }
+
+    if (ioEngine) {
+        if (!receiveIOEngineMessages()) {
+            {
+                std::lock_guard<std::recursive_mutex> lock(sendMutex);
+                detachFromIOEngine();
+            }
+            signalManager->emitSignal("consoleTextIGTL", "Connection closed by the server");
+            signalManager->emitSignal("disconnectIGTL");
+            return;
+        }
+        flushPendingTransform();
+        return;
+    }
+
+    if (shmRx) {
+        if (receiveSharedMemoryMessage() == 0) {
+            flushPendingTransform();
+        }
+        return;
+    }
+
+    if (isServerMode()) {
+        acceptClients();
+
+        // Poll each client for incoming messages and drop the ones that went away
+        bool received = false;
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            IGTLClientSession* session = it->get();
+            int result = session->isAlive() ? receiveMessage(session->getSocket(), session) : -1;
+            if (result < 0) {
+                signalManager->emitSignal("consoleTextIGTL", QString("Client %1 disconnected").arg(session->getPeerName()));
+                session->close();
+                std::lock_guard<std::recursive_mutex> lock(sendMutex);
+                if (udpChannel) {
+                    udpChannel->removeDestination(session->getUdpDestination());
+                }
+                it = sessions.erase(it);
+            } else {
+                received = received || (result > 0);
+                ++it;
+            }
+        }
+        if (!received) {
+            flushPendingTransform();
+        }
+        return;
+    }
+
+    if (receiveMessage(clientServer) == 0) {
+        flushPendingTransform();
+    }
+}
+
+int IGTLListener::receiveMessage(igtl::ClientSocket::Pointer socket, IGTLClientSession* session) {
     // Initialize receive buffer
     igtl::MessageBase::Pointer headerMsg = igtl::MessageBase::New();
     headerMsg->InitPack();
 
-    clientServer->SetReceiveTimeout(10); // Milliseconds
+    // In server mode every client is polled in turn, and with UDP enabled the
+    // datagram socket is polled between receives, so keep the per-socket wait short
+    socket->SetReceiveTimeout((session || udpChannel) ? 1 : 10); // Milliseconds
     bool timeout = true;
     
     // Call Receive and get the result (don't use std::tie)
-    int result = clientServer->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize(), timeout);
-    
-    double msgTime = QTime::currentTime().msecsSinceStartOfDay() / 1000.0;
+    int result = socket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize(), timeout);
     
     if (result == 0 && timeout) {
         // Time out
-        if (pendingTransMsg) {
-            if (msgTime - prevTransMsgTime > minTransMsgInterval) {
-                signalManager->emitSignal("consoleTextIGTL", "Sending out pending transform.");
-                transMsg->Unpack();
-                onReceiveTransform(transMsg);
-                prevTransMsgTime = msgTime;
-                pendingTransMsg = false;
-            }
-        }
-        return;
+        return 0;
     }
     
     if (result != headerMsg->GetPackSize()) {
+        if (result == 0) {
+            return -1;
+        }
         signalManager->emitSignal("consoleTextIGTL", "Incorrect pack size!");
-        return;
+        return 1;
     }
     
-    // Deserialize the header
+    // Deserialize the header and receive the body in one piece. The body is
+    // always consumed, so unhandled message types do not desynchronize the stream.
     headerMsg->Unpack();
+    headerMsg->AllocatePack();
+    if (headerMsg->GetPackBodySize() > 0) {
+        timeout = false;
+        result = socket->Receive(headerMsg->GetPackBodyPointer(), headerMsg->GetPackBodySize(), timeout);
+        if (result != headerMsg->GetPackBodySize()) {
+            signalManager->emitSignal("consoleTextIGTL", "Incorrect body size!");
+            return (result == 0) ? -1 : 1;
+        }
+    }
+
+    handleMessage(headerMsg, session);
+    return 1;
+}
+
+void IGTLListener::handleMessage(igtl::MessageBase::Pointer msg, IGTLClientSession* session) {
+    double msgTime = QTime::currentTime().msecsSinceStartOfDay() / 1000.0;
 
     // Check data type and respond accordingly
-    std::string msgType = headerMsg->GetDeviceType();
+    std::string msgType = msg->GetDeviceType();
     if (!msgType.empty()) {
         signalManager->emitSignal("consoleTextIGTL", QString("Received: %1").arg(msgType.c_str()));
     }
     
+    // ---------------------- STT_/STP_/GET_ ----------------------------
+    if (msgType == "STT_TDATA" || msgType == "STP_TDATA" ||
+        msgType == "STT_IMAGE" || msgType == "STP_IMAGE" || msgType == "GET_IMAGE") {
+        onStreamControl(msg, session);
+    }
     // ---------------------- TRANSFORM ----------------------------
-    if (msgType == "TRANSFORM") {
+    else if (msgType == "TRANSFORM") {
         transMsg = igtl::TransformMessage::New();
-        transMsg->Copy(headerMsg); // Copy header 
-        transMsg->AllocatePack();
-
-        // Receive transform data from the socket
-        timeout = false;
-        result = clientServer->Receive(transMsg->GetPackBodyPointer(), transMsg->GetPackBodySize(), timeout);
+        transMsg->Copy(msg); // Copy header and body
 
         // Check the time interval. Send the transform to MRI only if there was enough interval.
         if (msgTime - prevTransMsgTime > minTransMsgInterval) {
@@ -144,33 +295,91 @@ void IGTLListener::process() {
     }
     // ---------------------- STRING ----------------------------
     else if (msgType == "STRING") {
-        // Create a message buffer to receive string data
         igtl::StringMessage::Pointer stringMsg = igtl::StringMessage::New();
-        stringMsg->Copy(headerMsg); // Copy header
-        stringMsg->AllocatePack();
-
-        // Receive string data from the socket
-        timeout = false;
-        result = clientServer->Receive(stringMsg->GetPackBodyPointer(), stringMsg->GetPackBodySize(), timeout);
+        stringMsg->Copy(msg); // Copy header and body
         stringMsg->Unpack();
         
-        onReceiveString(stringMsg);
+        onReceiveString(stringMsg, session);
     }
     else if (msgType == "POINT") {
         // Handle POINT messages if needed
     }
+}
 
-    //double endTime = QTime::currentTime().msecsSinceStartOfDay() / 1000.0;
-    //double sleepTime = minTransMsgInterval - (endTime - msgTime);
-    //qDebug() << "sleep time =" << sleepTime;
-    //if (sleepTime < 0) {
-    //    sleepTime = 0;
-    //}
+int IGTLListener::receiveSharedMemoryMessage() {
+    size_t size = 0;
+    const char* record = static_cast<const char*>(shmRx->peek(size, 10)); // Milliseconds
+    if (!record) {
+        return 0;
+    }
 
-    //QThread::msleep(static_cast<unsigned long>(1000.0 * sleepTime));
+    igtl::MessageBase::Pointer msg = igtl::MessageBase::New();
+    msg->InitPack();
+    size_t headerSize = static_cast<size_t>(msg->GetPackSize());
+    if (size >= headerSize) {
+        std::memcpy(msg->GetPackPointer(), record, headerSize);
+        msg->Unpack();
+        msg->AllocatePack();
+        if (static_cast<size_t>(msg->GetPackBodySize()) == size - headerSize) {
+            std::memcpy(msg->GetPackBodyPointer(), record + headerSize, size - headerSize);
+            shmRx->release();
+            handleMessage(msg);
+            return 1;
+        }
+    }
+    shmRx->release();
+    signalManager->emitSignal("consoleTextIGTL", "Incorrect pack size!");
+    return 1;
+}
+
+void IGTLListener::flushPendingTransform() {
+    if (pendingTransMsg) {
+        double msgTime = QTime::currentTime().msecsSinceStartOfDay() / 1000.0;
+        if (msgTime - prevTransMsgTime > minTransMsgInterval) {
+            signalManager->emitSignal("consoleTextIGTL", "Sending out pending transform.");
+            transMsg->Unpack();
+            onReceiveTransform(transMsg);
+            prevTransMsgTime = msgTime;
+            pendingTransMsg = false;
+        }
+    }
 }
 
 void IGTLListener::finalize() {
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+
+    if (isServerMode()) {
+        // Notify all clients, let the session queues drain, then close the server
+        igtl::StringMessage::Pointer disconnectMsg = igtl::StringMessage::New();
+        disconnectMsg->SetDeviceName("DISCONNECT");
+        disconnectMsg->SetString("SERVER_FINALIZING");
+        disconnectMsg->Pack();
+        sendMessage(disconnectMsg);
+
+        closeClients();
+        serverSocket->CloseSocket();
+        signalManager->emitSignal("consoleTextIGTL", "Server closed");
+    }
+
+    if (shmTx) {
+        igtl::StringMessage::Pointer disconnectMsg = igtl::StringMessage::New();
+        disconnectMsg->SetDeviceName("DISCONNECT");
+        disconnectMsg->SetString("CLIENT_FINALIZING");
+        disconnectMsg->Pack();
+        sendMessage(disconnectMsg);
+        closeSharedMemory();
+    }
+
+    if (ioEngine) {
+        igtl::StringMessage::Pointer disconnectMsg = igtl::StringMessage::New();
+        disconnectMsg->SetDeviceName("DISCONNECT");
+        disconnectMsg->SetString("CLIENT_FINALIZING");
+        disconnectMsg->Pack();
+        sendMessage(disconnectMsg);
+        detachFromIOEngine();
+        signalManager->emitSignal("consoleTextIGTL", "Sent finalization notification to server");
+    }
+
     // Send explicit disconnection message to the server if not already done
     if (clientServer && clientServer->GetConnected()) {
         try {
@@ -191,6 +400,8 @@ void IGTLListener::finalize() {
             signalManager->emitSignal("consoleTextIGTL", QString("Error sending finalize message: %1").arg(e.what()));
         }
     }
+
+    udpChannel.reset();
     
     // Call parent class finalize
     ListenerBase::finalize();
@@ -210,12 +421,431 @@ bool IGTLListener::connect(const QString& ip, int port) {
     }
 }
 
-int IGTLListener::onReceiveTransform(igtl::TransformMessage::Pointer transMsg) {
-    igtl::Matrix4x4 matrix;
-    transMsg->GetMatrix(matrix);
+bool IGTLListener::openUdpChannel(const QString& ip, int port) {
+    udpChannel = std::make_unique<IGTLUdpChannel>();
+    if (isServerMode()) {
+        // Clients are added when they ask for UDP_TRACKING over their connection
+        if (!udpChannel->open(port)) {
+            signalManager->emitSignal("consoleTextIGTL", QString("Could not open UDP port %1").arg(port));
+            udpChannel.reset();
+            return false;
+        }
+        signalManager->emitSignal("consoleTextIGTL", QString("UDP tracking channel on port %1").arg(port));
+    } else {
+        if (!udpChannel->open(0) || udpChannel->addDestination(ip.toStdString(), port) < 0) {
+            signalManager->emitSignal("consoleTextIGTL", QString("Could not open UDP channel to %1:%2").arg(ip).arg(port));
+            udpChannel.reset();
+            return false;
+        }
+        // Ask the server to send our tracking to the port we receive on
+        igtl::StringMessage::Pointer requestMsg = igtl::StringMessage::New();
+        requestMsg->SetDeviceName("UDP_TRACKING");
+        requestMsg->SetString(std::to_string(udpChannel->getLocalPort()).c_str());
+        requestMsg->Pack();
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        sendToPeer(requestMsg);
+        signalManager->emitSignal("consoleTextIGTL", QString("UDP tracking channel to %1:%2").arg(ip).arg(port));
+    }
+    return true;
+}
+
+bool IGTLListener::openSharedMemory(const QString& name, int sizeMB) {
+    // Outbound images can be large; inbound traffic is control messages only.
+    if (sizeMB <= 0) {
+        signalManager->emitSignal("consoleTextIGTL", QString("ERROR: shmSize must be at least 1 MB (got %1)").arg(sizeMB));
+        return false;
+    }
+    shmTx = std::make_unique<SharedMemoryRing>();
+    shmRx = std::make_unique<SharedMemoryRing>();
+    std::string base = name.toStdString();
+    if (!shmTx->create(base + "_tx", static_cast<size_t>(sizeMB) * 1024 * 1024) ||
+        !shmRx->create(base + "_rx", 1024 * 1024)) {
+        signalManager->emitSignal("consoleTextIGTL", QString("Could not create shared memory rings %1_tx/%1_rx").arg(name));
+        closeSharedMemory();
+        return false;
+    }
+    // A record may take at most half of the ring; larger images are refused
+    signalManager->emitSignal("consoleTextIGTL", QString("Shared memory transport ready: %1_tx (%2 MB, messages up to %3 MB), %1_rx")
+        .arg(name).arg(sizeMB).arg(shmTx->getMaxMessageSize() / (1024.0 * 1024.0), 0, 'f', 1));
+    return true;
+}
+
+void IGTLListener::closeSharedMemory() {
+    shmTx.reset();
+    shmRx.reset();
+}
+
+bool IGTLListener::attachToIOEngine(const QString& ip, int port) {
+#ifdef MRIGTL_WITH_IO_ENGINE
+    // The socket is owned by the shared epoll engine; this listener no longer polls it.
+    IGTLIOEngine* engine = IGTLIOEngine::shared();
+    {
+        std::lock_guard<std::mutex> lock(ioInboxMutex);
+        ioInbox.clear();
+        ioClosed = false;
+    }
+    // Both handlers are called on the engine thread and only hand over to process()
+    IGTLIOEngine::ConnectionSettings settings;
+    settings.messageHandler = [this](IGTLIOEngine::ConnectionId, igtl::MessageBase::Pointer msg) {
+        std::lock_guard<std::mutex> lock(ioInboxMutex);
+        ioInbox.push_back(msg);
+    };
+    settings.connectionHandler = [this](IGTLIOEngine::ConnectionId, bool connected) {
+        std::lock_guard<std::mutex> lock(ioInboxMutex);
+        ioClosed = ioClosed || !connected;
+    };
+    settings.maxQueueDepth = parameter["maxQueueDepth"].toInt();
+    int id = engine->connectTo(ip.toStdString(), port, settings);
+    if (id < 0) {
+        signalManager->emitSignal("consoleTextIGTL", "Connection failed");
+        return false;
+    }
+    ioEngine = engine;
+    ioConnection = id;
+    signalManager->emitSignal("consoleTextIGTL", "Connection successful (shared I/O engine)");
+    return true;
+#else
+    signalManager->emitSignal("consoleTextIGTL", "Shared I/O engine is not available on this platform. Using a dedicated socket.");
+    return connect(ip, port);
+#endif
+}
+
+void IGTLListener::detachFromIOEngine() {
+#ifdef MRIGTL_WITH_IO_ENGINE
+    if (ioEngine) {
+        // Waits for a handler that is running, so none touches this listener afterwards
+        ioEngine->detach(ioConnection);
+    }
+#endif
+    ioEngine = nullptr;
+    ioConnection = -1;
+    std::lock_guard<std::mutex> lock(ioInboxMutex);
+    ioInbox.clear();
+}
+
+bool IGTLListener::receiveIOEngineMessages() {
+    std::deque<igtl::MessageBase::Pointer> messages;
+    bool closed;
+    {
+        std::lock_guard<std::mutex> lock(ioInboxMutex);
+        messages.swap(ioInbox);
+        closed = ioClosed;
+    }
+    for (const auto& msg : messages) {
+        handleMessage(msg);
+    }
+    return !closed;
+}
+
+bool IGTLListener::listen(int port) {
+    serverSocket = IGTLServerSocket::New();
     
+    int ret = serverSocket->CreateServer(port);
+    if (ret < 0) {
+        signalManager->emitSignal("consoleTextIGTL", QString("Could not create a server socket on port %1").arg(port));
+        serverSocket = nullptr;
+        return false;
+    }
+    signalManager->emitSignal("consoleTextIGTL", QString("Listening on port %1").arg(port));
+    return true;
+}
+
+bool IGTLListener::isConnected() {
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    if (shmTx) {
+        return true;
+    }
+#ifdef MRIGTL_WITH_IO_ENGINE
+    if (ioEngine) {
+        return ioEngine->isConnected(ioConnection);
+    }
+#endif
+    if (isServerMode()) {
+        for (const auto& session : sessions) {
+            if (session->isAlive()) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return clientServer && clientServer->GetConnected();
+}
+
+void IGTLListener::acceptClients() {
+    // Accept all pending connections without holding up the process loop
+    std::string address;
+    igtl::ClientSocket::Pointer socket = serverSocket->waitForClient(1, address);
+    while (socket.IsNotNull()) {
+        auto session = std::make_shared<IGTLClientSession>(socket, QString("client%1").arg(sessionCount++),
+                                                           QString::fromStdString(address));
+        session->setPolicy(IGTLClientSession::policyFromString(parameter["slowConsumerPolicy"].toString()));
+        session->setMaxQueueDepth(parameter["maxQueueDepth"].toInt());
+        session->start();
+        signalManager->emitSignal("consoleTextIGTL", QString("Client %1 connected").arg(session->getPeerName()));
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        sessions.push_back(std::move(session));
+        deltaEncoder.reset();  // Updates need the previous image, which the new client does not have
+
+        socket = serverSocket->waitForClient(1, address);
+    }
+}
+
+void IGTLListener::closeClients() {
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    for (const auto& session : sessions) {
+        session->close();
+    }
+    sessions.clear();
+}
+
+void IGTLListener::waitForSlowClients() {
+    std::vector<std::shared_ptr<IGTLClientSession>> blocking;
+    {
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        for (const auto& session : sessions) {
+            if (session->getPolicy() == IGTLClientSession::Block) {
+                blocking.push_back(session);
+            }
+        }
+    }
+    // The listener thread and the other clients are not held up meanwhile
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& session : blocking) {
+        session->waitForSpace(start);
+    }
+}
+
+int IGTLListener::sendMessage(igtl::MessageBase* msg, igtl::MessageBase* delta) {
+    // 'msg' must already be packed. Streams that a client has asked for with
+    // STT_TDATA/STT_IMAGE are downsampled here to the requested resolution.
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    std::string type = msg->GetDeviceType();
+    std::map<QString, igtl::MessageBase::Pointer> reduced;
+    int result;
+    if (isServerMode()) {
+        // The pack buffer is shared by reference across the client queues, so
+        // the message is packed once regardless of the number of clients.
+        int accepted = 0;
+        for (const auto& session : sessions) {
+            igtl::MessageBase::Pointer out = forClient(msg, session.get(), reduced, delta);
+            if (!session->getStream(type).offer(out) || sendToSession(session.get(), out)) {
+                accepted++;
+            }
+        }
+        result = accepted;
+    } else {
+        igtl::MessageBase::Pointer out = forClient(msg, nullptr, reduced, delta);
+        if (!peerStreams[type].offer(out)) {
+            // Held back as the pending sample (or the stream was stopped by the peer)
+            return msg->GetPackSize();
+        }
+        result = sendToPeer(out);
+    }
+
+    if (result > 0) {
+        BridgeMetrics& metrics = BridgeMetrics::instance();
+        if (type == "IMAGE") {
+            metrics.imagesSent.fetch_add(1, std::memory_order_relaxed);
+            metrics.imageBytesSent.fetch_add(msg->GetPackSize(), std::memory_order_relaxed);
+        } else if (type == "TDATA") {
+            metrics.trackingSent.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+igtl::MessageBase::Pointer IGTLListener::forClient(igtl::MessageBase* msg, IGTLClientSession* session,
+                                                   std::map<QString, igtl::MessageBase::Pointer>& reduced,
+                                                   igtl::MessageBase* delta) {
+    const ImageReduction& reduction = !session ? peerReduction
+                                      : session->hasImageReduction() ? session->getImageReduction() : defaultReduction;
+    igtl::ImageMessage* imageMsg = dynamic_cast<igtl::ImageMessage*>(msg);
+    if (!imageMsg) {
+        return msg;
+    }
+    QString key;
+    igtl::MessageBase::Pointer result = msg;
+    if (reduction.isIdentity()) {
+        // An update is only valid for a client that got the previous image, so
+        // clients whose stream is rate limited (STT_IMAGE) get full images
+        IGTLStreamLimiter& stream = session ? session->getStream("IMAGE") : peerStreams["IMAGE"];
+        if (delta && stream.getMode() == IGTLStreamLimiter::Push) {
+            result = delta;
+            key = "delta";
+        } else {
+            key = "none";
+        }
+    } else {
+        key = reduction.toString();
+        auto it = reduced.find(key);
+        if (it != reduced.end()) {
+            result = it->second;
+        } else {
+            int dimension[3];
+            imageMsg->GetDimensions(dimension);
+            ReductionPlan plan;
+            if (planReduction(dimension, reduction, plan)) {
+                igtl::ImageMessage::Pointer reducedMsg = newImageMessage(plan.dimension, imageMsg->GetScalarType(),
+                                                                         imageMsg->GetNumComponents());
+                reduceImage(imageMsg, plan, reducedMsg, ThreadPool::shared());
+                reducedMsg->Pack();
+                result = reducedMsg.GetPointer();
+            }
+            // Otherwise the ROI is outside this image, which is sent as it is
+            reduced[key] = result;
+        }
+    }
+
+    const bool compress = !session ? peerCompression
+                          : session->hasImageCompression() ? session->getImageCompression() : defaultCompression;
+    if (!compress) {
+        return result;
+    }
+    key += " compressed";
+    auto it = reduced.find(key);
+    if (it != reduced.end()) {
+        return it->second;
+    }
+    // An image that does not get smaller is sent as IMAGE
+    igtl::MessageBase::Pointer compressed = compressImage(result, ThreadPool::shared());
+    if (compressed.IsNotNull()) {
+        result = compressed;
+    }
+    reduced[key] = result;
+    return result;
+}
+
+bool IGTLListener::isUdpMessage(igtl::MessageBase* msg) {
+    if (!udpChannel) {
+        return false;
+    }
+    std::string type = msg->GetDeviceType();
+    return (type == "TDATA" || type == "TRANSFORM") && msg->GetPackSize() <= static_cast<int>(IGTLUdpChannel::MaxMessageSize);
+}
+
+int IGTLListener::sendToPeer(igtl::MessageBase* msg) {
+    int sent = 0;
+    if (isUdpMessage(msg) && udpChannel->getDestinationCount() > 0) {
+        // Tracking samples bypass the TCP stream, so they are never queued behind an image
+        sent = udpChannel->send(msg) ? msg->GetPackSize() : 0;
+    } else if (shmTx) {
+        // One copy into the ring; the reader unpacks in place. Drop the message if
+        // the reader has not made room within 10 ms rather than stall the producer.
+        if (static_cast<size_t>(msg->GetPackSize()) > shmTx->getMaxMessageSize()) {
+            // Would never fit, however long the producer waited
+            signalManager->emitSignal("consoleTextIGTL",
+                QString("ERROR: %1 message of %2 MB is larger than the shared memory ring allows (%3 MB); increase shmSize")
+                    .arg(msg->GetDeviceType()).arg(msg->GetPackSize() / (1024.0 * 1024.0), 0, 'f', 1)
+                    .arg(shmTx->getMaxMessageSize() / (1024.0 * 1024.0), 0, 'f', 1));
+        } else {
+            sent = shmTx->write(msg->GetPackPointer(), msg->GetPackSize(), 10) ? msg->GetPackSize() : 0;
+        }
+#ifdef MRIGTL_WITH_IO_ENGINE
+    } else if (ioEngine) {
+        // Queued on the engine; the message is written without blocking this thread
+        sent = ioEngine->send(ioConnection, msg) ? msg->GetPackSize() : 0;
+#endif
+    } else if (clientServer) {
+        sent = clientServer->Send(msg->GetPackPointer(), msg->GetPackSize());
+    } else {
+        return 0;
+    }
+    if (sent <= 0) {
+        // Counted with the queue drops, which restart the subvolume updates
+        BridgeMetrics::instance().messagesDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return sent;
+}
+
+bool IGTLListener::sendToSession(IGTLClientSession* session, igtl::MessageBase* msg) {
+    if (session->getUdpDestination() >= 0 && isUdpMessage(msg)) {
+        return udpChannel->send(msg, session->getUdpDestination());
+    }
+    return session->enqueue(msg);
+}
+
+int IGTLListener::reply(igtl::MessageBase* msg, IGTLClientSession* session) {
+    // Control responses go to the requesting client only and are never rate limited
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    if (session) {
+        return session->enqueue(msg) ? msg->GetPackSize() : 0;
+    }
+    return sendToPeer(msg);
+}
+
+void IGTLListener::flushStreams() {
+    // Send the samples that were held back once their interval has elapsed
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    for (auto& entry : peerStreams) {
+        igtl::MessageBase::Pointer msg = entry.second.takeDue();
+        if (msg.IsNotNull()) {
+            sendToPeer(msg);
+        }
+    }
+    for (const auto& session : sessions) {
+        for (auto& entry : session->getStreams()) {
+            igtl::MessageBase::Pointer msg = entry.second.takeDue();
+            if (msg.IsNotNull()) {
+                sendToSession(session.get(), msg);
+            }
+        }
+    }
+}
+
+void IGTLListener::onStreamControl(igtl::MessageBase::Pointer msg, IGTLClientSession* session) {
+    // STT_<type>, STP_<type> or GET_<type>
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    std::string msgType = msg->GetDeviceType();
+    std::string command = msgType.substr(0, 4);
+    std::string type = msgType.substr(4);
+    IGTLStreamLimiter& stream = session ? session->getStream(type) : peerStreams[type];
+    QString peer = session ? session->getPeerName() : QString("peer");
+
+    if (command == "STT_") {
+        int resolution = 0;
+        if (type == "TDATA") {
+            igtl::StartTrackingDataMessage::Pointer startMsg = igtl::StartTrackingDataMessage::New();
+            startMsg->Copy(msg);
+            if (startMsg->Unpack() & igtl::MessageBase::UNPACK_BODY) {
+                resolution = startMsg->GetResolution();
+            }
+        } else if (msg->GetPackBodySize() >= 4) {
+            // STT_IMAGE has no message class; the body starts with the resolution
+            // (ms, big endian) like STT_TDATA
+            const unsigned char* body = static_cast<const unsigned char*>(msg->GetPackBodyPointer());
+            resolution = (body[0] << 24) | (body[1] << 16) | (body[2] << 8) | body[3];
+        }
+        stream.start(resolution);
+        if (type == "IMAGE") {
+            deltaEncoder.reset();  // The client may have missed images; start from a full one
+        }
+        signalManager->emitSignal("consoleTextIGTL", QString("%1 requested %2 every %3 ms").arg(peer, type.c_str()).arg(resolution));
+    } else if (command == "STP_") {
+        stream.stop();
+        signalManager->emitSignal("consoleTextIGTL", QString("%1 stopped %2").arg(peer, type.c_str()));
+    } else if (command == "GET_" && type == "IMAGE") {
+        if (lastImageMsg.IsNotNull()) {
+            std::map<QString, igtl::MessageBase::Pointer> reduced;
+            reply(forClient(lastImageMsg, session, reduced), session);
+        } else {
+            signalManager->emitSignal("consoleTextIGTL", "GET_IMAGE: No image has been sent yet");
+        }
+        return;
+    } else {
+        return;
+    }
+
+    if (type == "TDATA") {
+        igtl::RTSTrackingDataMessage::Pointer rtsMsg = igtl::RTSTrackingDataMessage::New();
+        rtsMsg->SetDeviceName(msg->GetDeviceName());
+        rtsMsg->SetStatus(igtl::RTSTrackingDataMessage::STATUS_SUCCESS);
+        rtsMsg->Pack();
+        reply(rtsMsg, session);
+    }
+}
+
+QVariantMap IGTLListener::scanPlaneParam(const igtl::Matrix4x4& matrix, const std::string& deviceName) {
     QVariantMap param;
-    std::string deviceName = transMsg->GetDeviceName();
     if (deviceName == "PLANE_0" || deviceName == "PLANE") {
         param["plane_id"] = 0;
     } else if (deviceName == "PLANE_1") {
@@ -234,6 +864,16 @@ int IGTLListener::onReceiveTransform(igtl::TransformMessage::Pointer transMsg) {
         matrixList.append(row);
     }
     param["matrix"] = matrixList;
+    return param;
+}
+
+int IGTLListener::onReceiveTransform(igtl::TransformMessage::Pointer transMsg) {
+    igtl::Matrix4x4 matrix;
+    transMsg->GetMatrix(matrix);
+    
+    QVariantMap param = scanPlaneParam(matrix, transMsg->GetDeviceName());
+    param["receivedTime"] = BridgeMetrics::now();  // For the scan-plane-to-image latency
+    BridgeMetrics::instance().transformsReceived.fetch_add(1, std::memory_order_relaxed);
     
     signalManager->emitSignal("consoleTextIGTL", QString::fromStdString(std::to_string(matrix[0][0]) + " " +
                                                               std::to_string(matrix[0][1]) + " " +
@@ -244,7 +884,7 @@ int IGTLListener::onReceiveTransform(igtl::TransformMessage::Pointer transMsg) {
     return 1;
 }
 
-void IGTLListener::onReceiveString(igtl::StringMessage::Pointer stringMsg) {
+void IGTLListener::onReceiveString(igtl::StringMessage::Pointer stringMsg, IGTLClientSession* session) {
     std::string str = stringMsg->GetString();
     std::string deviceName = stringMsg->GetDeviceName();
     
@@ -256,6 +896,83 @@ void IGTLListener::onReceiveString(igtl::StringMessage::Pointer stringMsg) {
         signalManager->emitSignal("stopSequence");
     } else if (str == "START_UP") {   // Initialize
         state = "IDLE";
+    } else if (session && deviceName == "SEND_POLICY") {
+        // Server mode: a client may choose how it is treated when it falls behind
+        session->setPolicy(IGTLClientSession::policyFromString(QString::fromStdString(str)));
+        signalManager->emitSignal("consoleTextIGTL", QString("Client %1 send policy: %2").arg(session->getPeerName(), str.c_str()));
+    } else if (deviceName == "IMAGE_REDUCTION") {
+        // A client (or the peer in client mode) wants cropped or downsampled
+        // images; 'default' goes back to the listener's 'imageReduction'
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        QString text = QString::fromStdString(str);
+        ImageReduction reduction = defaultReduction;
+        QString error;
+        if (text.trimmed() != "default" && !reduction.parse(text, error)) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: IMAGE_REDUCTION: %1").arg(error));
+            return;
+        }
+        if (!session) {
+            peerReduction = reduction;
+        } else if (text.trimmed() == "default") {
+            session->clearImageReduction();
+        } else {
+            session->setImageReduction(reduction);
+        }
+        deltaEncoder.reset();
+        signalManager->emitSignal("consoleTextIGTL", QString("%1 image reduction: %2")
+            .arg(session ? session->getPeerName() : QString("Peer"), reduction.toString()));
+    } else if (deviceName == "IMAGE_COMPRESSION") {
+        // 'on': images as COMP_IMAGE, 'off': as IMAGE, 'default': the
+        // listener's 'imageCompression'
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        QString text = QString::fromStdString(str).trimmed();
+        if (text != "on" && text != "off" && text != "default") {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: IMAGE_COMPRESSION: '%1' is not on, off or default").arg(text));
+            return;
+        }
+        bool enable = (text == "default") ? defaultCompression : (text == "on");
+        if (!session) {
+            peerCompression = enable;
+        } else if (text == "default") {
+            session->clearImageCompression();
+        } else {
+            session->setImageCompression(enable);
+        }
+        signalManager->emitSignal("consoleTextIGTL", QString("%1 image compression: %2")
+            .arg(session ? session->getPeerName() : QString("Peer"), enable ? "on" : "off"));
+    } else if (session && deviceName == "UDP_TRACKING") {
+        // Server mode: '<port>' sends the client's TDATA/TRANSFORM over UDP to
+        // that port at the client's address, 'off' back over TCP
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        QString text = QString::fromStdString(str).trimmed();
+        bool ok = false;
+        int port = text.toInt(&ok);
+        if (!udpChannel) {
+            signalManager->emitSignal("consoleTextIGTL", "ERROR: UDP_TRACKING: udpTracking is not enabled");
+            return;
+        }
+        if (text != "off" && (!ok || port <= 0 || port > 65535)) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: UDP_TRACKING: '%1' is not a port or off").arg(text));
+            return;
+        }
+        udpChannel->removeDestination(session->getUdpDestination());
+        session->setUdpDestination(-1);
+        if (text == "off") {
+            signalManager->emitSignal("consoleTextIGTL", QString("%1 UDP tracking: off").arg(session->getPeerName()));
+            return;
+        }
+        QString address = session->getPeerAddress();
+        int id = address.isEmpty() ? -1 : udpChannel->addDestination(address.toStdString(), port);
+        if (id < 0) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: UDP_TRACKING: could not add %1:%2").arg(address).arg(port));
+            return;
+        }
+        session->setUdpDestination(id);
+        signalManager->emitSignal("consoleTextIGTL", QString("%1 UDP tracking: %2:%3")
+            .arg(session->getPeerName(), address).arg(port));
+    } else if (session && deviceName == "DISCONNECT") {
+        // Server mode: only this client is leaving
+        session->close();
     } else if (deviceName == "DISCONNECT") {
         // Server is notifying us that it's disconnecting
         signalManager->emitSignal("consoleTextIGTL", QString("Server requested disconnect: %1").arg(str.c_str()));
@@ -268,13 +985,24 @@ void IGTLListener::onReceiveString(igtl::StringMessage::Pointer stringMsg) {
 void IGTLListener::disconnectOpenIGTEvent() {
     // This method is called when disconnectIGTL signal is emitted
     signalManager->emitSignal("consoleTextIGTL", "Received disconnection request");
-    
-    // Send explicit disconnection message to the server
-    if (clientServer && clientServer->GetConnected()) {
-        try {
-            clientServer->CloseSocket();
-        } catch (const std::exception& e) {
-            signalManager->emitSignal("consoleTextIGTL", QString("Error sending disconnect message: %1").arg(e.what()));
+
+    {
+        // Released before stop(), which waits for finalize() in the listener thread
+        std::lock_guard<std::recursive_mutex> lock(sendMutex);
+        detachFromIOEngine();
+        closeSharedMemory();
+        udpChannel.reset();
+
+        // Send explicit disconnection message to the server
+        if (clientServer && clientServer->GetConnected()) {
+            try {
+                clientServer->CloseSocket();
+            } catch (const std::exception& e) {
+                signalManager->emitSignal("consoleTextIGTL", QString("Error sending disconnect message: %1").arg(e.what()));
+            }
+        }
+        if (isServerMode()) {
+            closeClients();
         }
     }
     
@@ -301,8 +1029,8 @@ void IGTLListener::sendImageIGTL(const QVariantMap& param) {
      */
 
     try {
-        // Check if we have a valid connection
-        if (!clientServer || !clientServer->GetConnected()) {
+        // Check if we have a valid connection (or, in server mode, at least one client)
+        if (!isConnected()) {
             signalManager->emitSignal("consoleTextIGTL", "ERROR: Not connected to OpenIGTLink server");
             return;
         }
@@ -376,24 +1104,21 @@ void IGTLListener::sendImageIGTL(const QVariantMap& param) {
 
         // Debug: creating image message
 
-        // Create the image message
-        igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
-        imageMsg->SetDimensions(dimension[0], dimension[1], dimension[2]);
-
-        int pixelSize = 0;
-        if (DataTypeTable.find(dtype.toStdString()) != DataTypeTable.end()) {
-            const auto& typeInfo = DataTypeTable[dtype.toStdString()];
-            imageMsg->SetScalarType(typeInfo[0]);
-            pixelSize = typeInfo[1];
-        } else {
+        const ScalarType type = scalarTypeFromName(dtype);
+        if (type == ScalarType::Invalid) {
             signalManager->emitSignal("consoleTextIGTL", QString("ERROR: Invalid data type: %1").arg(dtype));
             return;
         }
+        const int scalarType = static_cast<int>(type);
+        const int pixelSize = scalarSize(type);
+
+        // Create the image message (scalars allocated)
+        const int dims[3] = {dimension[0], dimension[1], dimension[2]};
+        igtl::ImageMessage::Pointer imageMsg = newImageMessage(dims, scalarType, numberOfComponents);
 
         // Debug: image parameters logged
 
         imageMsg->SetDeviceName(name.toStdString());
-        imageMsg->SetNumComponents(numberOfComponents);
         imageMsg->SetEndian(endian); // little is 2, big is 1
         imageMsg->SetSpacing(spacing[0], spacing[1], spacing[2]);
 
@@ -405,54 +1130,48 @@ void IGTLListener::sendImageIGTL(const QVariantMap& param) {
         imageMsg->SetSpacing(spacing[0], spacing[1], spacing[2]);
         imageMsg->SetMatrix(matrix);
 
-        // Allocate memory for the image
-        imageMsg->AllocateScalars();
-
         // Copy the binary data
+        if (binaryOffsetList.size() != binaryList.size()) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: %1 binary chunks but %2 offsets")
+                .arg(binaryList.size()).arg(binaryOffsetList.size()));
+            return;
+        }
+        // Store the QByteArrays to prevent temporary destruction. constData() does
+        // not detach, so shared and memory-mapped buffers are not copied here.
+        std::vector<QByteArray> binaryData(binaryList.size());
+        std::vector<ImageChunk> chunks(binaryList.size());
         for (int i = 0; i < binaryList.size(); i++) {
-          int offset = binaryOffsetList[i].toInt();
-          void* dest = static_cast<void*>(static_cast<char*>(imageMsg->GetScalarPointer()) + offset);
-          
-          // Store QByteArray to prevent temporary destruction
-          QByteArray binaryData = binaryList[i].toByteArray();
-          void* src = static_cast<void*>(binaryData.data());
-          
-          // Use actual QByteArray size instead of calculated total image size
-          int dataSize = binaryData.size();
-          
-          // Safety check to prevent buffer overflow
-          int totalImageSize = dimension[0] * dimension[1] * dimension[2] * pixelSize * numberOfComponents;
-          if (offset + dataSize > totalImageSize) {
-            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: Binary data would overflow image buffer - offset: %1, size: %2, total: %3")
-                .arg(offset).arg(dataSize).arg(totalImageSize));
+            binaryData[i] = binaryList[i].toByteArray();
+            chunks[i].data = binaryData[i].constData();
+            chunks[i].offset = binaryOffsetList[i].toLongLong();
+            chunks[i].size = binaryData[i].size();
+        }
+        const qint64 totalImageSize = static_cast<qint64>(dimension[0]) * dimension[1] * dimension[2]
+                                      * pixelSize * numberOfComponents;
+        qint64 gapBytes = 0;
+        QString chunkError;
+        if (!validateImageChunks(chunks, totalImageSize, pixelSize, gapBytes, chunkError)) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: %1").arg(chunkError));
             return;
-          }
-          
-          std::memcpy(dest, src, dataSize);
         }
+        if (gapBytes > 0) {
+            signalManager->emitSignal("consoleTextIGTL", QString("WARNING: %1 of %2 image bytes not covered by binary data (sent as 0)")
+                .arg(gapBytes).arg(totalImageSize));
+        }
+        assembleImageChunks(chunks, static_cast<char*>(imageMsg->GetScalarPointer()), totalImageSize,
+                            ThreadPool::shared(), parallelCopyBytes);
 
-        // Pack the message
-        imageMsg->Pack();
-
-        // Send the message
-        int r = clientServer->Send(imageMsg->GetPackPointer(), imageMsg->GetPackSize());
+        // Pack and send the message
+        int r = sendImageMessage(imageMsg, param.contains("timestamp") ? timestamp.toMSecsSinceEpoch() : 0);
         if (r > 0) {
+            if (param.contains("planeTime")) {
+                // First image after a scan plane update (see MRSimListener)
+                BridgeMetrics::instance().planeLatency.record(BridgeMetrics::now() - param["planeTime"].toLongLong());
+            }
             signalManager->emitSignal("consoleTextIGTL", "Image sent successfully");
         } else {
             signalManager->emitSignal("consoleTextIGTL", "Failed to send image");
         }
-        
-        // Send a separate timestamp message if needed
-        if (parameter["sendTimestamp"].toInt() == 1 && param.contains("timestamp")) {
-            // Convert timestamp to string
-            qint64 ms = timestamp.currentMSecsSinceEpoch();
-            std::string timestampStr = std::to_string(ms/1000) + "." + std::to_string(ms%1000);
-            igtl::StringMessage::Pointer textMsg = igtl::StringMessage::New();
-            textMsg->SetDeviceName("IMAGE_TIMESTAMP");
-            textMsg->SetString(timestampStr);
-            textMsg->Pack();
-            clientServer->Send(textMsg->GetPackPointer(), textMsg->GetPackSize());
-        }
     } catch (const std::exception& e) {
         signalManager->emitSignal("consoleTextIGTL", QString("ERROR: %1").arg(e.what()));
     } catch (...) {
@@ -463,9 +1182,14 @@ void IGTLListener::sendImageIGTL(const QVariantMap& param) {
 void IGTLListener::sendTrackingDataIGTL(const QVariantMap& param) {
     signalManager->emitSignal("consoleTextIGTL", "Sending tracking data...");
     /*
-     * 'param' is a map of coil data, which consists of the following fields:
+     * 'param' contains a list of coils (e.g. from MRSimTrackingGenerator):
+     *
+     *  param['coils']       : List of coil dictionaries
+     *  coil['id']           : Coil name (tracking data element name)
+     *  coil['position']     : [x, y, z] in the patient coordinate system (mm)
+     *
+     * Old format: 'param' is a map from the coil name to a coil dictionary:
      *
-     *  coil['name']         : Coil name
      *  coil['position_pcs'] : Coil position in the patient coordinate system
      *  coil['position_dcs'] : Coil position in the device coordinate system
      */
@@ -476,7 +1200,7 @@ void IGTLListener::sendTrackingDataIGTL(const QVariantMap& param) {
     }
     
     // Check if clientServer is valid and connected
-    if (!clientServer || !clientServer->GetConnected()) {
+    if (!isConnected()) {
         signalManager->emitSignal("consoleTextIGTL", "ERROR: Not connected to OpenIGTLink server. Cannot send tracking data.");
         return;
     }
@@ -534,7 +1258,8 @@ void IGTLListener::sendTrackingDataIGTL(const QVariantMap& param) {
         }
         
         trackingDataMsg->Pack();
-        int result = clientServer->Send(trackingDataMsg->GetPackPointer(), trackingDataMsg->GetPackSize());
+        waitForSlowClients();
+        int result = sendMessage(trackingDataMsg);
         
         if (result > 0) {
             signalManager->emitSignal("consoleTextIGTL", "Tracking data sent successfully");
@@ -548,4 +1273,125 @@ void IGTLListener::sendTrackingDataIGTL(const QVariantMap& param) {
     }
 }
 
+igtl::ImageMessage::Pointer IGTLListener::newImageMessage(const int dimension[3], int scalarType, int numberOfComponents) {
+    if (useBufferPool) {
+        // Reuses a message (and its pack buffer) that every consumer has released
+        return ImageBufferPool::instance().acquireImageMessage(dimension, scalarType, numberOfComponents);
+    }
+    igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+    imageMsg->SetDimensions(dimension[0], dimension[1], dimension[2]);
+    imageMsg->SetScalarType(scalarType);
+    imageMsg->SetNumComponents(numberOfComponents);
+    imageMsg->AllocateScalars();
+    return imageMsg;
+}
+
+int IGTLListener::sendImageMessage(igtl::ImageMessage::Pointer imageMsg, qint64 timestampMs) {
+    waitForSlowClients();
+    qint64 start = BridgeMetrics::now();
+    if (timestampMs > 0) {
+        // Acquisition time in the header (otherwise Pack() uses the current time)
+        igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+        ts->SetTime(timestampMs / 1000.0);
+        imageMsg->SetTimeStamp(ts);
+    }
+    imageMsg->Pack();
+
+    std::lock_guard<std::recursive_mutex> lock(sendMutex);
+    lastImageMsg = imageMsg; // Answer for GET_IMAGE
+    igtl::ImageMessage::Pointer deltaMsg;
+    if (deltaUpdates) {
+        // A dropped update would leave a client with a stale region until the next keyframe
+        quint64 dropped = BridgeMetrics::instance().messagesDropped.load(std::memory_order_relaxed);
+        if (dropped != deltaDropCount) {
+            deltaEncoder.reset();
+            deltaDropCount = dropped;
+        }
+        deltaMsg = deltaEncoder.encode(imageMsg);
+        if (deltaMsg.IsNotNull()) {
+            deltaMsg->Pack();
+        }
+    }
+    int r = sendMessage(imageMsg, deltaMsg);
+    BridgeMetrics::instance().sendTime.record(BridgeMetrics::now() - start);
+    ImageTap::instance().publish(imageMsg);  // After the send, so previews add no latency
+
+    // Send a separate timestamp message if needed
+    if (sendTimestamp && timestampMs > 0) {
+        std::string timestampStr = QString("%1.%2").arg(timestampMs / 1000).arg(timestampMs % 1000, 3, 10, QChar('0')).toStdString();
+        igtl::StringMessage::Pointer textMsg = igtl::StringMessage::New();
+        textMsg->SetDeviceName("IMAGE_TIMESTAMP");
+        textMsg->SetString(timestampStr);
+        textMsg->Pack();
+        sendMessage(textMsg);
+    }
+    return r;
+}
+
+bool IGTLListener::sendImage(const ImageView& image) {
+    try {
+        const int pixelSize = scalarSize(scalarTypeFromIGTL(image.scalarType));
+        size_t imageSize = static_cast<size_t>(image.dimension[0]) * image.dimension[1] * image.dimension[2] *
+                           image.numberOfComponents * pixelSize;
+        if (pixelSize == 0 || image.data == nullptr || image.size != imageSize) {
+            signalManager->emitSignal("consoleTextIGTL", QString("ERROR: sendImage(): Invalid image '%1' (type %2, %3 bytes)")
+                .arg(image.name.c_str()).arg(image.scalarType).arg(image.size));
+            return false;
+        }
+        if (!isConnected()) {
+            return false;
+        }
+
+        igtl::Matrix4x4 matrix;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                matrix[i][j] = static_cast<float>(image.matrix[i][j]);
+            }
+        }
+
+        igtl::ImageMessage::Pointer imageMsg = newImageMessage(image.dimension, image.scalarType, image.numberOfComponents);
+        imageMsg->SetDeviceName(image.name);
+        imageMsg->SetEndian(image.endian);
+        imageMsg->SetSpacing(image.spacing[0], image.spacing[1], image.spacing[2]);
+        imageMsg->SetMatrix(matrix);
+        ImageChunk chunk;
+        chunk.data = static_cast<const char*>(image.data);
+        chunk.size = static_cast<qint64>(image.size);
+        assembleImageChunks({chunk}, static_cast<char*>(imageMsg->GetScalarPointer()), chunk.size,
+                            ThreadPool::shared(), parallelCopyBytes);
+
+        return sendImageMessage(imageMsg, image.timestamp) > 0;
+    } catch (const std::exception& e) {
+        signalManager->emitSignal("consoleTextIGTL", QString("ERROR: Exception in sendImage: %1").arg(e.what()));
+    } catch (...) {
+        signalManager->emitSignal("consoleTextIGTL", "ERROR: Unknown exception in sendImage");
+    }
+    return false;
+}
+
+bool IGTLListener::sendTracking(const CoilSample* coils, size_t count, const char* name) {
+    if (count == 0 || !isConnected()) {
+        return false;
+    }
+    try {
+        igtl::TrackingDataMessage::Pointer trackingDataMsg = igtl::TrackingDataMessage::New();
+        trackingDataMsg->SetDeviceName(name);
+        for (size_t i = 0; i < count; i++) {
+            igtl::TrackingDataElement::Pointer trackElement = igtl::TrackingDataElement::New();
+            trackElement->SetName(coils[i].id.c_str());
+            trackElement->SetType(igtl::TrackingDataElement::TYPE_TRACKER);
+            trackElement->SetPosition(coils[i].position[0], coils[i].position[1], coils[i].position[2]);
+            trackingDataMsg->AddTrackingDataElement(trackElement);
+        }
+        trackingDataMsg->Pack();
+        waitForSlowClients();
+        return sendMessage(trackingDataMsg) > 0;
+    } catch (const std::exception& e) {
+        signalManager->emitSignal("consoleTextIGTL", QString("ERROR: Exception in sendTracking: %1").arg(e.what()));
+    } catch (...) {
+        signalManager->emitSignal("consoleTextIGTL", "ERROR: Unknown exception in sendTracking");
+    }
+    return false;
+}
+
 } // namespace mrigtlbridge
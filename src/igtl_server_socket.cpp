@@ -0,0 +1,74 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtl_server_socket.h"
+
+#ifdef MRIGTL_WITH_UDP_TRANSPORT
+#include <sys/socket.h>
+#include <netdb.h>
+#endif
+
+namespace mrigtlbridge {
+
+#ifdef MRIGTL_WITH_UDP_TRANSPORT
+
+// A client socket for a descriptor accepted by IGTLServerSocket (what
+// igtl::ServerSocket does for the sockets it accepts itself)
+class AcceptedClientSocket : public igtl::ClientSocket {
+public:
+    typedef AcceptedClientSocket Self;
+    typedef igtl::ClientSocket Superclass;
+    typedef igtl::SmartPointer<Self> Pointer;
+    typedef igtl::SmartPointer<const Self> ConstPointer;
+
+    igtlTypeMacro(mrigtlbridge::AcceptedClientSocket, igtl::ClientSocket);
+    igtlNewMacro(Self);
+
+    void adopt(int descriptor) { m_SocketDescriptor = descriptor; }
+
+protected:
+    AcceptedClientSocket() {}
+    ~AcceptedClientSocket() {}
+};
+
+igtl::ClientSocket::Pointer IGTLServerSocket::waitForClient(unsigned long msec, std::string& peerAddress) {
+    peerAddress.clear();
+    if (m_SocketDescriptor < 0 || SelectSocket(m_SocketDescriptor, msec) <= 0) {
+        return igtl::ClientSocket::Pointer();
+    }
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    int descriptor = accept(m_SocketDescriptor, reinterpret_cast<sockaddr*>(&address), &length);
+    if (descriptor < 0) {
+        return igtl::ClientSocket::Pointer();
+    }
+    char host[NI_MAXHOST];
+    if (getnameinfo(reinterpret_cast<sockaddr*>(&address), length, host, sizeof(host), nullptr, 0, NI_NUMERICHOST) == 0) {
+        peerAddress = host;
+    }
+    AcceptedClientSocket::Pointer socket = AcceptedClientSocket::New();
+    socket->adopt(descriptor);
+    return igtl::ClientSocket::Pointer(socket.GetPointer());
+}
+
+#else // MRIGTL_WITH_UDP_TRANSPORT
+
+igtl::ClientSocket::Pointer IGTLServerSocket::waitForClient(unsigned long msec, std::string& peerAddress) {
+    peerAddress.clear();
+    return WaitForConnection(msec);
+}
+
+#endif // MRIGTL_WITH_UDP_TRANSPORT
+
+} // namespace mrigtlbridge
@@ -0,0 +1,76 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtl_stream_limiter.h"
+
+namespace mrigtlbridge {
+
+IGTLStreamLimiter::IGTLStreamLimiter()
+    : mode(Push),
+      resolution(0),
+      forwardedCount(0),
+      coalescedCount(0) {
+}
+
+void IGTLStreamLimiter::start(int resolutionMs) {
+    mode = Streaming;
+    resolution = resolutionMs > 0 ? resolutionMs : 0;
+    lastSent = Clock::time_point();  // The first sample goes out immediately
+    pending = nullptr;
+}
+
+void IGTLStreamLimiter::stop() {
+    mode = Stopped;
+    pending = nullptr;
+}
+
+bool IGTLStreamLimiter::offer(const igtl::MessageBase::Pointer& msg) {
+    if (mode == Push) {
+        forwardedCount++;
+        return true;
+    }
+    if (mode == Stopped) {
+        coalescedCount++;
+        return false;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (now - lastSent >= std::chrono::milliseconds(resolution)) {
+        lastSent = now;
+        pending = nullptr;
+        forwardedCount++;
+        return true;
+    }
+    if (pending.IsNotNull()) {
+        coalescedCount++;
+    }
+    pending = msg;
+    return false;
+}
+
+igtl::MessageBase::Pointer IGTLStreamLimiter::takeDue() {
+    igtl::MessageBase::Pointer msg;
+    if (mode == Streaming && pending.IsNotNull()) {
+        Clock::time_point now = Clock::now();
+        if (now - lastSent >= std::chrono::milliseconds(resolution)) {
+            lastSent = now;
+            msg = pending;
+            pending = nullptr;
+            forwardedCount++;
+        }
+    }
+    return msg;
+}
+
+} // namespace mrigtlbridge
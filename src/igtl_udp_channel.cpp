@@ -0,0 +1,381 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "igtl_udp_channel.h"
+#include <QDebug>
+#include <map>
+#include <cstring>
+
+#ifdef MRIGTL_WITH_UDP_TRANSPORT
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace mrigtlbridge {
+
+static const uint32_t DATAGRAM_MAGIC = 0x4d524755; // 'MRGU'
+static const size_t PREFIX_SIZE = 8;
+
+static void putUint32(unsigned char* p, uint32_t v) {
+    uint32_t n = htonl(v);
+    std::memcpy(p, &n, sizeof(n));
+}
+
+static uint32_t getUint32(const unsigned char* p) {
+    uint32_t n;
+    std::memcpy(&n, p, sizeof(n));
+    return ntohl(n);
+}
+
+IGTLUdpChannel::IGTLUdpChannel()
+    : fd(-1),
+      nextId(1) {
+}
+
+IGTLUdpChannel::~IGTLUdpChannel() {
+    close();
+}
+
+bool IGTLUdpChannel::open(int localPort) {
+    close();
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        qWarning() << "IGTLUdpChannel::open(): Could not create socket:" << strerror(errno);
+        return false;
+    }
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(localPort));
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        qWarning() << "IGTLUdpChannel::open(): Could not bind port" << localPort << ":" << strerror(errno);
+        close();
+        return false;
+    }
+
+    buffer.resize(65536);
+    return true;
+}
+
+void IGTLUdpChannel::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    peers.clear();
+}
+
+int IGTLUdpChannel::getLocalPort() const {
+    sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    if (fd < 0 || getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+        return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+int IGTLUdpChannel::addDestination(const std::string& host, int port) {
+    if (fd < 0) {
+        return -1;
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || !result) {
+        qWarning() << "IGTLUdpChannel::addDestination(): Could not resolve" << host.c_str();
+        return -1;
+    }
+    Peer* peer = findPeer(result->ai_addr, result->ai_addrlen, true);
+    freeaddrinfo(result);
+    if (!peer) {
+        return -1;
+    }
+    if (peer->id == 0) {
+        peer->id = nextId++;
+    }
+
+    // A prefix without a message announces us to the peer (and restarts its
+    // sequence check for us)
+    unsigned char hello[PREFIX_SIZE];
+    putUint32(hello, DATAGRAM_MAGIC);
+    putUint32(hello + 4, 0);
+    peer->sendSequence = 0;
+    return sendDatagram(*peer, hello, sizeof(hello)) ? peer->id : -1;
+}
+
+void IGTLUdpChannel::removeDestination(int id) {
+    for (auto it = peers.begin(); it != peers.end(); ++it) {
+        if (id > 0 && it->id == id) {
+            peers.erase(it);
+            return;
+        }
+    }
+}
+
+int IGTLUdpChannel::getDestinationCount() const {
+    int count = 0;
+    for (const Peer& peer : peers) {
+        count += (peer.id > 0) ? 1 : 0;
+    }
+    return count;
+}
+
+IGTLUdpChannel::Peer* IGTLUdpChannel::findPeer(const void* address, size_t length, bool add) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(address);
+    for (Peer& peer : peers) {
+        if (peer.address.size() == length && std::memcmp(peer.address.data(), bytes, length) == 0) {
+            return &peer;
+        }
+    }
+    if (!add) {
+        return nullptr;
+    }
+    Peer peer;
+    peer.address.assign(bytes, bytes + length);
+    if (peers.size() < MaxPeers) {
+        peers.push_back(peer);
+        return &peers.back();
+    }
+    // Full: take the place of a peer that is not a destination
+    for (Peer& slot : peers) {
+        if (slot.id == 0) {
+            slot = peer;
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool IGTLUdpChannel::isDestinationHost(const void* address, size_t length) const {
+    // Any port of the host: with NAT the source port need not match
+    if (length < sizeof(sockaddr_in) || static_cast<const sockaddr*>(address)->sa_family != AF_INET) {
+        return false;
+    }
+    in_addr host = static_cast<const sockaddr_in*>(address)->sin_addr;
+    for (const Peer& peer : peers) {
+        if (peer.id > 0 && peer.address.size() >= sizeof(sockaddr_in) &&
+            reinterpret_cast<const sockaddr_in*>(peer.address.data())->sin_addr.s_addr == host.s_addr) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IGTLUdpChannel::sendDatagram(const Peer& peer, const void* data, size_t size) {
+    ssize_t r = sendto(fd, data, size, 0, reinterpret_cast<const sockaddr*>(peer.address.data()),
+                       static_cast<socklen_t>(peer.address.size()));
+    return r == static_cast<ssize_t>(size);
+}
+
+bool IGTLUdpChannel::sendTo(Peer& peer, igtl::MessageBase* msg) {
+    // 'msg' must already be packed.
+    size_t size = static_cast<size_t>(msg->GetPackSize());
+    if (size > MaxMessageSize) {
+        stats.oversized++;
+        return false;
+    }
+
+    // Numbered per destination, so that the receiver sees no gaps from the
+    // messages that went to others. 0 is reserved for the announcement.
+    if (++peer.sendSequence == 0) {
+        ++peer.sendSequence;
+    }
+    unsigned char prefix[PREFIX_SIZE];
+    putUint32(prefix, DATAGRAM_MAGIC);
+    putUint32(prefix + 4, peer.sendSequence);
+
+    // Prefix and pack buffer go out as one datagram without being copied together
+    iovec iov[2];
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = sizeof(prefix);
+    iov[1].iov_base = msg->GetPackPointer();
+    iov[1].iov_len = size;
+
+    msghdr hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = peer.address.data();
+    hdr.msg_namelen = static_cast<socklen_t>(peer.address.size());
+    hdr.msg_iov = iov;
+    hdr.msg_iovlen = 2;
+    return sendmsg(fd, &hdr, 0) == static_cast<ssize_t>(sizeof(prefix) + size);
+}
+
+bool IGTLUdpChannel::send(igtl::MessageBase* msg) {
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = false;
+    for (Peer& peer : peers) {
+        if (peer.id > 0 && sendTo(peer, msg)) {
+            ok = true;
+        }
+    }
+    if (ok) {
+        stats.sent++;
+    }
+    return ok;
+}
+
+bool IGTLUdpChannel::send(igtl::MessageBase* msg, int id) {
+    if (fd < 0) {
+        return false;
+    }
+    for (Peer& peer : peers) {
+        if (id > 0 && peer.id == id) {
+            if (!sendTo(peer, msg)) {
+                return false;
+            }
+            stats.sent++;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<igtl::MessageBase::Pointer> IGTLUdpChannel::receiveLatest(int timeoutMs) {
+    std::vector<igtl::MessageBase::Pointer> messages;
+    if (fd < 0) {
+        return messages;
+    }
+
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeoutMs) <= 0) {
+        return messages;
+    }
+
+    // Newest sample per "<device type>/<device name>"
+    std::map<std::string, igtl::MessageBase::Pointer> latest;
+    igtl::MessageBase::Pointer headerMsg = igtl::MessageBase::New();
+    headerMsg->InitPack();
+    const size_t headerSize = static_cast<size_t>(headerMsg->GetPackSize());
+
+    for (;;) {
+        sockaddr_storage from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t r = recvfrom(fd, buffer.data(), buffer.size(), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        if (r < 0) {
+            break; // EAGAIN: drained
+        }
+        size_t size = static_cast<size_t>(r);
+        if (size < PREFIX_SIZE || getUint32(buffer.data()) != DATAGRAM_MAGIC) {
+            continue;
+        }
+
+        if (!isDestinationHost(&from, fromLength)) {
+            stats.rejected++;
+            continue;
+        }
+        Peer* peer = findPeer(&from, fromLength, true);
+        if (!peer) {
+            continue;
+        }
+        uint32_t seq = getUint32(buffer.data() + 4);
+        if (size == PREFIX_SIZE) {
+            // Announcement: the peer (re)started
+            peer->seen = false;
+            continue;
+        }
+        if (peer->seen) {
+            int32_t delta = static_cast<int32_t>(seq - peer->lastSequence);
+            // A large step back means the sender restarted without announcing itself
+            if (delta <= 0 && delta > -65536) {
+                stats.stale++;
+                continue;
+            }
+            if (delta > 1) {
+                stats.lost += static_cast<uint64_t>(delta - 1);
+            }
+        }
+        peer->lastSequence = seq;
+        peer->seen = true;
+
+        const unsigned char* data = buffer.data() + PREFIX_SIZE;
+        size -= PREFIX_SIZE;
+        if (size < headerSize) {
+            continue;
+        }
+        igtl::MessageBase::Pointer msg = igtl::MessageBase::New();
+        msg->InitPack();
+        std::memcpy(msg->GetPackPointer(), data, headerSize);
+        msg->Unpack();
+        msg->AllocatePack();
+        if (static_cast<size_t>(msg->GetPackBodySize()) != size - headerSize) {
+            continue;
+        }
+        std::memcpy(msg->GetPackBodyPointer(), data + headerSize, size - headerSize);
+        stats.received++;
+
+        std::string key = std::string(msg->GetDeviceType()) + "/" + msg->GetDeviceName();
+        auto it = latest.find(key);
+        if (it != latest.end()) {
+            stats.superseded++;
+            it->second = msg;
+        } else {
+            latest[key] = msg;
+        }
+    }
+
+    for (const auto& entry : latest) {
+        messages.push_back(entry.second);
+    }
+    return messages;
+}
+
+} // namespace mrigtlbridge
+
+#else // MRIGTL_WITH_UDP_TRANSPORT
+
+// UDP transport uses POSIX sockets. The channel can be constructed but never
+// opened on other platforms.
+namespace mrigtlbridge {
+
+IGTLUdpChannel::IGTLUdpChannel() : fd(-1), nextId(1) {}
+IGTLUdpChannel::~IGTLUdpChannel() {}
+
+bool IGTLUdpChannel::open(int localPort) {
+    qWarning() << "IGTLUdpChannel::open(): Not supported on this platform" << localPort;
+    return false;
+}
+
+void IGTLUdpChannel::close() {}
+int IGTLUdpChannel::getLocalPort() const { return -1; }
+int IGTLUdpChannel::addDestination(const std::string&, int) { return -1; }
+void IGTLUdpChannel::removeDestination(int) {}
+int IGTLUdpChannel::getDestinationCount() const { return 0; }
+IGTLUdpChannel::Peer* IGTLUdpChannel::findPeer(const void*, size_t, bool) { return nullptr; }
+bool IGTLUdpChannel::isDestinationHost(const void*, size_t) const { return false; }
+bool IGTLUdpChannel::sendDatagram(const Peer&, const void*, size_t) { return false; }
+bool IGTLUdpChannel::sendTo(Peer&, igtl::MessageBase*) { return false; }
+bool IGTLUdpChannel::send(igtl::MessageBase*) { return false; }
+bool IGTLUdpChannel::send(igtl::MessageBase*, int) { return false; }
+std::vector<igtl::MessageBase::Pointer> IGTLUdpChannel::receiveLatest(int) { return {}; }
+
+} // namespace mrigtlbridge
+
+#endif // MRIGTL_WITH_UDP_TRANSPORT
@@ -14,6 +14,7 @@
 
 #include "igtl_widget.h"
 #include "igtl_listener.h"
+#include "image_preview_widget.h"
 #include "signal_manager.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -84,13 +85,24 @@ void IGTLWidget::buildGUI(QWidget* parent) {
     openIGTStatus = new QLabel("Disconnected", parent);
     socketLayout->addWidget(openIGTStatus);
     
+    // Preview of the images being sent (rendered off the GUI thread)
+    QGroupBox* previewGroupBox = new QGroupBox("Preview", parent);
+    previewGroupBox->setCheckable(true);
+    previewGroupBox->setChecked(true);
+    layout->addWidget(previewGroupBox);
+
+    QVBoxLayout* previewLayout = new QVBoxLayout(previewGroupBox);
+    ImagePreviewWidget* preview = new ImagePreviewWidget(previewGroupBox);
+    previewLayout->addWidget(preview);
+    connect(previewGroupBox, &QGroupBox::toggled, preview, &ImagePreviewWidget::setActive);
+    preview->setActive(true);
+
     // Console
     QGroupBox* consoleGroupBox = new QGroupBox("Console", parent);
     layout->addWidget(consoleGroupBox);
     
     QVBoxLayout* consoleLayout = new QVBoxLayout(consoleGroupBox);
-    openIGTConsole = new QTextEdit(parent);
-    openIGTConsole->setReadOnly(true);
+    openIGTConsole = createConsole(parent);
     consoleLayout->addWidget(openIGTConsole);
     
     // Connect signals and slots
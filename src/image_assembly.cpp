@@ -0,0 +1,115 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_assembly.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// Pieces of the parallel copy; large enough that a worker streams memory
+// rather than synchronizing
+const qint64 CopyPieceBytes = 1 << 20;
+
+// A memcpy or memset of [begin, end) of the image
+struct CopyPiece {
+    const char* source;  // nullptr: zero fill
+    qint64 offset;
+    qint64 size;
+};
+
+void copyPiece(const CopyPiece& piece, char* dest) {
+    if (piece.source) {
+        std::memcpy(dest + piece.offset, piece.source, static_cast<size_t>(piece.size));
+    } else {
+        std::memset(dest + piece.offset, 0, static_cast<size_t>(piece.size));
+    }
+}
+
+} // namespace
+
+bool validateImageChunks(std::vector<ImageChunk>& chunks, qint64 totalSize, int alignment,
+                         qint64& gapBytes, QString& error) {
+    std::sort(chunks.begin(), chunks.end(),
+              [](const ImageChunk& a, const ImageChunk& b) { return a.offset < b.offset; });
+
+    alignment = std::max(1, alignment);
+    qint64 covered = 0;
+    qint64 end = 0;  // End of the previous chunk
+    for (const ImageChunk& chunk : chunks) {
+        if (chunk.offset < 0 || chunk.size < 0 || chunk.offset + chunk.size > totalSize) {
+            error = QString("Binary data would overflow image buffer - offset: %1, size: %2, total: %3")
+                .arg(chunk.offset).arg(chunk.size).arg(totalSize);
+            return false;
+        }
+        // A chunk that splits a voxel shifts every voxel after it
+        if (chunk.offset % alignment != 0 || chunk.size % alignment != 0) {
+            error = QString("Binary data not aligned to %1-byte voxels - offset: %2, size: %3")
+                .arg(alignment).arg(chunk.offset).arg(chunk.size);
+            return false;
+        }
+        if (chunk.offset < end) {
+            error = QString("Binary data overlaps the previous chunk - offset: %1, previous end: %2")
+                .arg(chunk.offset).arg(end);
+            return false;
+        }
+        if (chunk.size > 0 && !chunk.data) {
+            error = QString("Binary data missing - offset: %1").arg(chunk.offset);
+            return false;
+        }
+        covered += chunk.size;
+        end = chunk.offset + chunk.size;
+    }
+    gapBytes = totalSize - covered;
+    return true;
+}
+
+void assembleImageChunks(const std::vector<ImageChunk>& chunks, char* dest, qint64 totalSize,
+                         ThreadPool* pool, qint64 parallelThreshold) {
+    // The chunks are sorted, disjoint and in bounds (validateImageChunks()),
+    // so the pieces below can be copied in any order by any thread
+    std::vector<CopyPiece> pieces;
+    auto add = [&pieces](const char* source, qint64 offset, qint64 size) {
+        for (qint64 done = 0; done < size; done += CopyPieceBytes) {
+            qint64 length = std::min(CopyPieceBytes, size - done);
+            pieces.push_back({source ? source + done : nullptr, offset + done, length});
+        }
+    };
+    qint64 end = 0;
+    for (const ImageChunk& chunk : chunks) {
+        add(nullptr, end, chunk.offset - end);
+        add(chunk.data, chunk.offset, chunk.size);
+        end = chunk.offset + chunk.size;
+    }
+    add(nullptr, end, totalSize - end);
+
+    if (!pool || parallelThreshold <= 0 || totalSize < parallelThreshold || pieces.size() < 2
+        || pieces.size() > static_cast<size_t>(INT_MAX)) {
+        for (const CopyPiece& piece : pieces) {
+            copyPiece(piece, dest);
+        }
+        return;
+    }
+    pool->parallelFor(static_cast<int>(pieces.size()), [&](int begin, int stop) {
+        for (int i = begin; i < stop; i++) {
+            copyPiece(pieces[i], dest);
+        }
+    });
+}
+
+} // namespace mrigtlbridge
@@ -0,0 +1,276 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_buffer_pool.h"
+#include "scalar_type.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+namespace mrigtlbridge {
+
+namespace {
+
+const size_t HugePageSize = 2 * 1024 * 1024;
+// A size that has not been asked for in this many acquisitions is freed
+const quint64 MaxIdleUses = 256;
+
+} // namespace
+
+ImageBufferPool& ImageBufferPool::instance() {
+    // Not destroyed at exit: buffers may still be released after main()
+    static ImageBufferPool* pool = new ImageBufferPool();
+    return *pool;
+}
+
+void ImageBufferPool::setEnabled(bool enable) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        enabled = enable;
+    }
+    if (!enable) {
+        trim();
+    }
+}
+
+bool ImageBufferPool::isEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return enabled;
+}
+
+void ImageBufferPool::setHugePages(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    hugePages = enable;
+}
+
+void ImageBufferPool::setMaxPerSize(int count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxPerSize = static_cast<size_t>(std::max(1, count));
+}
+
+size_t ImageBufferPool::blockClass(size_t size) {
+    // Quarter octaves: at most 25% is wasted
+    if (size <= 4096) {
+        return 4096;
+    }
+    size_t octave = 4096;
+    while (octave <= size / 2) {
+        octave *= 2;
+    }
+    size_t step = octave / 4;
+    return (size + step - 1) / step * step;
+}
+
+PooledBuffer::Block* ImageBufferPool::allocateBlock(size_t capacity, bool huge) {
+    PooledBuffer::Block* block = new PooledBuffer::Block();
+    block->capacity = capacity;
+#ifdef Q_OS_LINUX
+    if (huge && capacity >= HugePageSize) {
+        size_t length = (capacity + HugePageSize - 1) / HugePageSize * HugePageSize;
+        void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            // No huge pages reserved: ask for transparent huge pages instead
+            p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, length, MADV_HUGEPAGE);
+            }
+        }
+        if (p != MAP_FAILED) {
+            block->data = static_cast<char*>(p);
+            block->mappedLength = length;
+            return block;
+        }
+    }
+#else
+    Q_UNUSED(huge);
+#endif
+    block->data = static_cast<char*>(std::malloc(capacity));
+    if (!block->data) {
+        delete block;
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void ImageBufferPool::freeBlock(PooledBuffer::Block* block) {
+#ifdef Q_OS_LINUX
+    if (block->mappedLength > 0) {
+        munmap(block->data, block->mappedLength);
+        delete block;
+        return;
+    }
+#endif
+    std::free(block->data);
+    delete block;
+}
+
+void ImageBufferPool::addBytes(qint64 bytes) {
+    statistics.bytes += bytes;
+    statistics.highWaterBytes = std::max(statistics.highWaterBytes, statistics.bytes);
+}
+
+PooledBuffer ImageBufferPool::acquire(size_t size) {
+    PooledBuffer buffer;
+    buffer.length = size;
+    const size_t capacity = blockClass(size);
+
+    PooledBuffer::Block* block = nullptr;
+    bool pooled;
+    bool huge;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pooled = enabled;
+        huge = hugePages;
+    }
+    if (!pooled) {
+        buffer.block = std::shared_ptr<PooledBuffer::Block>(allocateBlock(capacity, huge), freeBlock);
+        return buffer;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        SizeClass& sizeClass = blocks[capacity];
+        sizeClass.lastUse = ++uses;
+        if (!sizeClass.idleBlocks.empty()) {
+            block = sizeClass.idleBlocks.back();
+            sizeClass.idleBlocks.pop_back();
+            statistics.hits++;
+        } else {
+            statistics.misses++;
+            addBytes(capacity);
+        }
+        age();
+    }
+    if (!block) {
+        // Allocated outside the lock; a large malloc() or mmap() takes a while
+        block = allocateBlock(capacity, huge);
+    }
+    buffer.block = std::shared_ptr<PooledBuffer::Block>(block, [this](PooledBuffer::Block* b) { release(b); });
+    return buffer;
+}
+
+void ImageBufferPool::release(PooledBuffer::Block* block) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = blocks.find(block->capacity);
+        if (enabled && it != blocks.end() && it->second.idleBlocks.size() < maxPerSize) {
+            it->second.idleBlocks.push_back(block);
+            return;
+        }
+        addBytes(-static_cast<qint64>(block->capacity));
+    }
+    freeBlock(block);
+}
+
+igtl::ImageMessage::Pointer ImageBufferPool::acquireImageMessage(const int dimension[3], int scalarType,
+                                                                 int numberOfComponents) {
+    const size_t size = static_cast<size_t>(dimension[0]) * dimension[1] * dimension[2] *
+                        std::max(1, numberOfComponents) * std::max(1, scalarSize(scalarTypeFromIGTL(scalarType)));
+
+    igtl::ImageMessage::Pointer imageMsg;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (enabled) {
+            SizeClass& sizeClass = messages[size];
+            sizeClass.lastUse = ++uses;
+            for (const auto& pooled : sizeClass.messages) {
+                // Nobody else can get hold of a message that only the pool references
+                if (pooled->GetReferenceCount() == 1) {
+                    imageMsg = pooled;
+                    statistics.hits++;
+                    break;
+                }
+            }
+            if (imageMsg.IsNull()) {
+                statistics.misses++;
+                imageMsg = igtl::ImageMessage::New();
+                if (sizeClass.messages.size() < maxPerSize) {
+                    sizeClass.messages.push_back(imageMsg);
+                    addBytes(size);
+                }
+            }
+            age();
+        }
+    }
+    if (imageMsg.IsNull()) {
+        imageMsg = igtl::ImageMessage::New();
+    }
+    imageMsg->SetDimensions(dimension[0], dimension[1], dimension[2]);
+    imageMsg->SetScalarType(scalarType);
+    imageMsg->SetNumComponents(numberOfComponents);
+    imageMsg->AllocateScalars();
+    // As for a new message, Pack() stamps the current time unless the caller sets one
+    imageMsg->SetTimeStamp(0, 0);
+    return imageMsg;
+}
+
+void ImageBufferPool::age() {
+    // Called with the lock held, every 64 acquisitions
+    if (uses % 64 != 0) {
+        return;
+    }
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        if (uses - it->second.lastUse <= MaxIdleUses) {
+            ++it;
+            continue;
+        }
+        for (PooledBuffer::Block* block : it->second.idleBlocks) {
+            addBytes(-static_cast<qint64>(block->capacity));
+            freeBlock(block);
+        }
+        // Blocks still in use find no class on release and are freed then
+        it = blocks.erase(it);
+    }
+    for (auto it = messages.begin(); it != messages.end();) {
+        if (uses - it->second.lastUse <= MaxIdleUses) {
+            ++it;
+            continue;
+        }
+        // Messages still in use are freed by their last user
+        addBytes(-static_cast<qint64>(it->first * it->second.messages.size()));
+        it = messages.erase(it);
+    }
+}
+
+void ImageBufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : blocks) {
+        for (PooledBuffer::Block* block : entry.second.idleBlocks) {
+            addBytes(-static_cast<qint64>(block->capacity));
+            freeBlock(block);
+        }
+        entry.second.idleBlocks.clear();
+    }
+    for (auto& entry : messages) {
+        std::vector<igtl::ImageMessage::Pointer>& list = entry.second.messages;
+        for (auto it = list.begin(); it != list.end();) {
+            if ((*it)->GetReferenceCount() == 1) {
+                addBytes(-static_cast<qint64>(entry.first));
+                it = list.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+ImageBufferPool::Statistics ImageBufferPool::getStatistics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+} // namespace mrigtlbridge
@@ -0,0 +1,464 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_compression.h"
+#include "bridge_metrics.h"
+#include "image_buffer_pool.h"
+#include "scalar_type.h"
+#include "thread_pool.h"
+#include <igtl_header.h>
+#include <igtl_util.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace mrigtlbridge {
+
+namespace {
+
+typedef unsigned char Byte;
+
+const char CodecName[8] = "SHUF-LZ";
+const int CodecVersion = 1;
+const size_t CodecHeaderBytes = 40;
+const size_t ImageHeaderBytes = 72;  // IGTL_IMAGE_HEADER_SIZE (header version 1)
+
+const size_t MinMatch = 4;
+const size_t LastLiterals = 5;       // A chunk ends with literals, which keeps the 4-byte reads in bounds
+const size_t MaxOffset = 65535;
+const int HashBits = 12;
+const size_t HashTableBytes = (size_t(1) << HashBits) * sizeof(quint32);
+
+template <typename T>
+void putBE(Byte* p, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        p[i] = static_cast<Byte>(static_cast<quint64>(value) >> (8 * (sizeof(T) - 1 - i)));
+    }
+}
+
+template <typename T>
+T getBE(const Byte* p) {
+    quint64 value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value = (value << 8) | p[i];
+    }
+    return static_cast<T>(value);
+}
+
+template <int W>
+void shuffleScalars(const Byte* in, size_t count, Byte* out) {
+    for (size_t i = 0; i < count; i++) {
+        for (int b = 0; b < W; b++) {
+            out[b * count + i] = in[i * W + b];
+        }
+    }
+}
+
+template <int W>
+void unshuffleScalars(const Byte* in, size_t count, Byte* out) {
+    for (size_t i = 0; i < count; i++) {
+        for (int b = 0; b < W; b++) {
+            out[i * W + b] = in[b * count + i];
+        }
+    }
+}
+
+// Byte b of each of the 'count' scalars goes to plane b of 'out'
+void shuffleBytes(const Byte* in, size_t count, int width, Byte* out) {
+    switch (width) {
+    case 2:  shuffleScalars<2>(in, count, out); break;
+    case 4:  shuffleScalars<4>(in, count, out); break;
+    case 8:  shuffleScalars<8>(in, count, out); break;
+    default: std::memcpy(out, in, count * width); break;
+    }
+}
+
+void unshuffleBytes(const Byte* in, size_t count, int width, Byte* out) {
+    switch (width) {
+    case 2:  unshuffleScalars<2>(in, count, out); break;
+    case 4:  unshuffleScalars<4>(in, count, out); break;
+    case 8:  unshuffleScalars<8>(in, count, out); break;
+    default: std::memcpy(out, in, count * width); break;
+    }
+}
+
+inline quint32 read32(const Byte* p) {
+    quint32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline quint32 hash4(quint32 sequence) {
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+// The part of a length beyond the 15 of the token
+inline void putLength(Byte*& op, size_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = static_cast<Byte>(length);
+}
+
+inline bool readLength(const Byte*& ip, const Byte* end, size_t& length) {
+    Byte b;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+// Compresses 'in' into at most 'capacity' bytes; 'table' (HashTableBytes)
+// finds the previous position of each 4-byte sequence. Returns the compressed
+// size, or 0 if it does not fit.
+size_t lzCompress(const Byte* in, size_t size, Byte* out, size_t capacity, quint32* table) {
+    std::fill(table, table + (size_t(1) << HashBits), 0);
+    const Byte* ip = in;
+    const Byte* anchor = in;
+    const Byte* const end = in + size;
+    Byte* op = out;
+    Byte* const outEnd = out + capacity;
+
+    if (size > MinMatch + LastLiterals) {
+        const Byte* const matchLimit = end - LastLiterals;
+        unsigned misses = 0;
+        while (ip + MinMatch <= matchLimit) {
+            const quint32 sequence = read32(ip);
+            const quint32 h = hash4(sequence);
+            const Byte* ref = in + table[h];
+            table[h] = static_cast<quint32>(ip - in);
+            if (ref >= ip || static_cast<size_t>(ip - ref) > MaxOffset || read32(ref) != sequence) {
+                // Step faster through data that does not compress
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            const Byte* matchEnd = ip + MinMatch;
+            const Byte* r = ref + MinMatch;
+            while (matchEnd < matchLimit && *matchEnd == *r) {
+                matchEnd++;
+                r++;
+            }
+            const size_t literals = ip - anchor;
+            const size_t matchLength = matchEnd - ip - MinMatch;
+            if (static_cast<size_t>(outEnd - op) < literals + literals / 255 + matchLength / 255 + 5) {
+                return 0;
+            }
+            *op++ = static_cast<Byte>((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchLength, 15));
+            if (literals >= 15) {
+                putLength(op, literals - 15);
+            }
+            std::memcpy(op, anchor, literals);
+            op += literals;
+            const size_t offset = ip - ref;
+            *op++ = static_cast<Byte>(offset & 0xFF);
+            *op++ = static_cast<Byte>(offset >> 8);
+            if (matchLength >= 15) {
+                putLength(op, matchLength - 15);
+            }
+            ip = matchEnd;
+            anchor = ip;
+        }
+    }
+
+    const size_t literals = end - anchor;
+    if (static_cast<size_t>(outEnd - op) < literals + literals / 255 + 2) {
+        return 0;
+    }
+    *op++ = static_cast<Byte>(std::min<size_t>(literals, 15) << 4);
+    if (literals >= 15) {
+        putLength(op, literals - 15);
+    }
+    std::memcpy(op, anchor, literals);
+    op += literals;
+    return op - out;
+}
+
+// Decompresses exactly 'rawSize' bytes; false if 'in' is not valid
+bool lzDecompress(const Byte* in, size_t size, Byte* out, size_t rawSize) {
+    const Byte* ip = in;
+    const Byte* const end = in + size;
+    Byte* op = out;
+    Byte* const outEnd = out + rawSize;
+    while (ip < end) {
+        const Byte token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(ip, end, literals)) {
+            return false;
+        }
+        if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        std::memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        if (ip == end) {
+            break;  // The last sequence has no match
+        }
+        if (end - ip < 2) {
+            return false;
+        }
+        const size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, end, matchLength)) {
+            return false;
+        }
+        matchLength += MinMatch;
+        if (offset == 0 || offset > static_cast<size_t>(op - out) || matchLength > static_cast<size_t>(outEnd - op)) {
+            return false;
+        }
+        const Byte* match = op - offset;
+        if (offset >= matchLength) {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            // Overlapping: a run of the last 'offset' bytes
+            for (size_t i = 0; i < matchLength; i++) {
+                *op++ = *match++;
+            }
+        }
+    }
+    return op == outEnd;
+}
+
+void runChunks(ThreadPool* pool, size_t count, const std::function<void(int, int)>& fn) {
+    if (pool && count > 1) {
+        pool->parallelFor(static_cast<int>(count), fn);
+    } else {
+        fn(0, static_cast<int>(count));
+    }
+}
+
+} // namespace
+
+igtl::MessageBase::Pointer compressImage(igtl::MessageBase* imageMsg, ThreadPool* pool, int chunkBytes) {
+    BridgeMetrics& metrics = BridgeMetrics::instance();
+    const qint64 start = BridgeMetrics::now();
+    const Byte* packed = static_cast<const Byte*>(imageMsg->GetPackPointer());
+    const size_t packSize = static_cast<size_t>(imageMsg->GetPackSize());
+
+    igtl_header header;
+    std::memcpy(&header, packed, IGTL_HEADER_SIZE);
+    igtl_header_convert_byte_order(&header);
+    // Version 2 bodies have an extended header and metadata around the image
+    if (header.header_version != 1 || header.body_size < ImageHeaderBytes
+        || packSize != IGTL_HEADER_SIZE + header.body_size || std::strncmp(header.name, "IMAGE", IGTL_HEADER_TYPE_SIZE) != 0) {
+        return igtl::MessageBase::Pointer();
+    }
+    const Byte* body = packed + IGTL_HEADER_SIZE;
+    const Byte* scalars = body + ImageHeaderBytes;
+    const size_t rawBytes = header.body_size - ImageHeaderBytes;
+    int width = scalarSize(scalarTypeFromIGTL(body[3]));
+    if (width == 0 || rawBytes % width != 0) {
+        width = 1;
+    }
+    const size_t chunk = std::max<size_t>(width, static_cast<size_t>(std::max(chunkBytes, 1)) / width * width);
+    const size_t chunkCount = (rawBytes + chunk - 1) / chunk;
+
+    // Chunk c is compressed into its own place in 'staging', which it cannot
+    // outgrow: a chunk that does not get smaller is stored as it is
+    PooledBuffer staging = ImageBufferPool::instance().acquire(rawBytes);
+    std::vector<quint32> sizes(chunkCount);
+    runChunks(pool, chunkCount, [&](int begin, int end) {
+        PooledBuffer scratch = ImageBufferPool::instance().acquire(HashTableBytes + chunk);
+        quint32* table = reinterpret_cast<quint32*>(scratch.data());
+        Byte* shuffled = reinterpret_cast<Byte*>(scratch.data()) + HashTableBytes;
+        for (int c = begin; c < end; c++) {
+            const size_t offset = c * chunk;
+            const size_t length = std::min(chunk, rawBytes - offset);
+            Byte* out = reinterpret_cast<Byte*>(staging.data()) + offset;
+            const Byte* in = scalars + offset;
+            if (width > 1) {
+                shuffleBytes(in, length / width, width, shuffled);
+                in = shuffled;
+            }
+            size_t size = lzCompress(in, length, out, length - 1, table);
+            if (size == 0) {
+                std::memcpy(out, scalars + offset, length);
+                size = length;
+            }
+            sizes[c] = static_cast<quint32>(size);
+        }
+    });
+
+    size_t bodySize = CodecHeaderBytes + ImageHeaderBytes + 4 * chunkCount;
+    for (quint32 size : sizes) {
+        bodySize += size;
+    }
+    metrics.compressInBytes.fetch_add(packSize, std::memory_order_relaxed);
+    if (bodySize >= header.body_size) {
+        metrics.compressOutBytes.fetch_add(packSize, std::memory_order_relaxed);
+        metrics.compressTime.record(BridgeMetrics::now() - start);
+        return igtl::MessageBase::Pointer();
+    }
+
+    // Same version, device name and timestamp as the IMAGE
+    igtl_header outHeader = header;
+    std::memset(outHeader.name, 0, IGTL_HEADER_TYPE_SIZE);
+    std::strncpy(outHeader.name, CompressedImageType, IGTL_HEADER_TYPE_SIZE);
+    outHeader.body_size = bodySize;
+    outHeader.crc = 0;
+    igtl_header wire = outHeader;
+    igtl_header_convert_byte_order(&wire);
+
+    igtl::MessageBase::Pointer msg = igtl::MessageBase::New();
+    msg->InitPack();
+    std::memcpy(msg->GetPackPointer(), &wire, IGTL_HEADER_SIZE);
+    msg->Unpack();
+    msg->AllocatePack();
+
+    Byte* out = static_cast<Byte*>(msg->GetPackBodyPointer());
+    std::memcpy(out, CodecName, sizeof(CodecName));
+    putBE<quint16>(out + 8, CodecVersion);
+    putBE<quint16>(out + 10, static_cast<quint16>(width));
+    putBE<quint32>(out + 12, static_cast<quint32>(chunk));
+    putBE<quint32>(out + 16, static_cast<quint32>(chunkCount));
+    putBE<quint32>(out + 20, static_cast<quint32>(ImageHeaderBytes));
+    putBE<quint64>(out + 24, rawBytes);
+    putBE<quint64>(out + 32, header.crc);
+    std::memcpy(out + CodecHeaderBytes, body, ImageHeaderBytes);
+    Byte* sizeTable = out + CodecHeaderBytes + ImageHeaderBytes;
+    Byte* data = sizeTable + 4 * chunkCount;
+    for (size_t c = 0; c < chunkCount; c++) {
+        putBE<quint32>(sizeTable + 4 * c, sizes[c]);
+        std::memcpy(data, staging.data() + c * chunk, sizes[c]);
+        data += sizes[c];
+    }
+
+    outHeader.crc = crc64(out, bodySize, crc64(nullptr, 0, 0));
+    wire = outHeader;
+    igtl_header_convert_byte_order(&wire);
+    std::memcpy(msg->GetPackPointer(), &wire, IGTL_HEADER_SIZE);
+
+    metrics.imagesCompressed.fetch_add(1, std::memory_order_relaxed);
+    metrics.compressOutBytes.fetch_add(msg->GetPackSize(), std::memory_order_relaxed);
+    metrics.compressTime.record(BridgeMetrics::now() - start);
+    return msg;
+}
+
+igtl::ImageMessage::Pointer decompressImage(igtl::MessageBase* header, const void* body, qint64 bodySize,
+                                            ThreadPool* pool, QString& error) {
+    const Byte* in = static_cast<const Byte*>(body);
+    const size_t size = static_cast<size_t>(std::max<qint64>(bodySize, 0));
+    if (size < CodecHeaderBytes || std::memcmp(in, CodecName, sizeof(CodecName)) != 0) {
+        error = "Unknown codec";
+        return igtl::ImageMessage::Pointer();
+    }
+    const int version = getBE<quint16>(in + 8);
+    const int width = getBE<quint16>(in + 10);
+    const size_t chunk = getBE<quint32>(in + 12);
+    const size_t chunkCount = getBE<quint32>(in + 16);
+    const size_t imageHeaderBytes = getBE<quint32>(in + 20);
+    const quint64 rawBytes = getBE<quint64>(in + 24);
+    const quint64 imageCrc = getBE<quint64>(in + 32);
+    if (version != CodecVersion) {
+        error = QString("Unsupported codec version %1").arg(version);
+        return igtl::ImageMessage::Pointer();
+    }
+    if ((width != 1 && width != 2 && width != 4 && width != 8) || chunk == 0 || chunk % width != 0
+        || rawBytes + imageHeaderBytes > static_cast<quint64>(INT_MAX) || chunkCount != (rawBytes + chunk - 1) / chunk) {
+        error = "Invalid codec header";
+        return igtl::ImageMessage::Pointer();
+    }
+    const size_t sizeTable = CodecHeaderBytes + imageHeaderBytes;
+    if (size < sizeTable + 4 * chunkCount) {
+        error = "Truncated body";
+        return igtl::ImageMessage::Pointer();
+    }
+    std::vector<size_t> offsets(chunkCount + 1);
+    offsets[0] = sizeTable + 4 * chunkCount;
+    for (size_t c = 0; c < chunkCount; c++) {
+        const size_t chunkSize = getBE<quint32>(in + sizeTable + 4 * c);
+        if (chunkSize > std::min<size_t>(chunk, rawBytes - c * chunk)) {
+            error = QString("Invalid size of chunk %1").arg(c);
+            return igtl::ImageMessage::Pointer();
+        }
+        offsets[c + 1] = offsets[c] + chunkSize;
+    }
+    if (offsets.back() != size) {
+        error = "Body size does not match the chunks";
+        return igtl::ImageMessage::Pointer();
+    }
+
+    // The IMAGE header: that of the COMP_IMAGE with the type, body size and
+    // CRC of the original
+    igtl_header imageHeader;
+    std::memcpy(&imageHeader, header->GetPackPointer(), IGTL_HEADER_SIZE);
+    igtl_header_convert_byte_order(&imageHeader);
+    std::memset(imageHeader.name, 0, IGTL_HEADER_TYPE_SIZE);
+    std::strncpy(imageHeader.name, "IMAGE", IGTL_HEADER_TYPE_SIZE);
+    imageHeader.body_size = imageHeaderBytes + rawBytes;
+    imageHeader.crc = imageCrc;
+    igtl_header_convert_byte_order(&imageHeader);
+    igtl::MessageBase::Pointer headerMsg = igtl::MessageBase::New();
+    headerMsg->InitPack();
+    std::memcpy(headerMsg->GetPackPointer(), &imageHeader, IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+
+    // Decoded straight into the pack buffer of the image
+    igtl::ImageMessage::Pointer imageMsg = igtl::ImageMessage::New();
+    imageMsg->SetMessageHeader(headerMsg);
+    imageMsg->AllocatePack();
+    Byte* out = static_cast<Byte*>(imageMsg->GetPackBodyPointer());
+    std::memcpy(out, in + CodecHeaderBytes, imageHeaderBytes);
+    Byte* scalars = out + imageHeaderBytes;
+    std::atomic<bool> valid(true);
+    runChunks(pool, chunkCount, [&](int begin, int end) {
+        PooledBuffer scratch;
+        if (width > 1) {
+            scratch = ImageBufferPool::instance().acquire(chunk);
+        }
+        for (int c = begin; c < end; c++) {
+            const size_t offset = c * chunk;
+            const size_t length = std::min<size_t>(chunk, rawBytes - offset);
+            const Byte* source = in + offsets[c];
+            const size_t sourceSize = offsets[c + 1] - offsets[c];
+            bool ok = true;
+            if (sourceSize == length) {
+                std::memcpy(scalars + offset, source, length);  // Stored
+            } else if (width == 1) {
+                ok = lzDecompress(source, sourceSize, scalars + offset, length);
+            } else {
+                Byte* shuffled = reinterpret_cast<Byte*>(scratch.data());
+                ok = lzDecompress(source, sourceSize, shuffled, length);
+                if (ok) {
+                    unshuffleBytes(shuffled, length / width, width, scalars + offset);
+                }
+            }
+            if (!ok) {
+                valid = false;
+            }
+        }
+    });
+    if (!valid) {
+        error = "Corrupt chunk";
+        return igtl::ImageMessage::Pointer();
+    }
+    if (!(imageMsg->Unpack(1) & igtl::MessageBase::UNPACK_BODY)) {
+        error = "The decoded image does not match its CRC";
+        return igtl::ImageMessage::Pointer();
+    }
+    return imageMsg;
+}
+
+} // namespace mrigtlbridge
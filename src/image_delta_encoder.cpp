@@ -0,0 +1,196 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_delta_encoder.h"
+#include "bridge_metrics.h"
+#include "scalar_type.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// Comparison granularity along a row: a cache line, which memcmp() compares
+// with vector instructions
+const size_t BlockBytes = 64;
+
+} // namespace
+
+ImageDeltaEncoder::ImageDeltaEncoder()
+    : keyframeInterval(30),
+      maxDeltaRatio(0.5) {
+}
+
+void ImageDeltaEncoder::setKeyframeInterval(int frames) {
+    keyframeInterval = std::max(1, frames);
+}
+
+void ImageDeltaEncoder::setMaxDeltaRatio(double ratio) {
+    maxDeltaRatio = ratio;
+}
+
+void ImageDeltaEncoder::reset() {
+    devices.clear();
+}
+
+bool ImageDeltaEncoder::changedRegion(const char* current, const char* previous, const int dimension[3],
+                                      int voxelBytes, int begin[3], int end[3]) {
+    const size_t rowBytes = static_cast<size_t>(dimension[0]) * voxelBytes;
+    bool changed = false;
+    for (int a = 0; a < 3; a++) {
+        begin[a] = dimension[a];
+        end[a] = 0;
+    }
+    for (int z = 0; z < dimension[2]; z++) {
+        for (int y = 0; y < dimension[1]; y++) {
+            const size_t offset = (static_cast<size_t>(z) * dimension[1] + y) * rowBytes;
+            const char* a = current + offset;
+            const char* b = previous + offset;
+            if (std::memcmp(a, b, rowBytes) == 0) {
+                continue;
+            }
+            // First and last differing blocks of the row
+            size_t first = 0;
+            while (first < rowBytes) {
+                size_t length = std::min(BlockBytes, rowBytes - first);
+                if (std::memcmp(a + first, b + first, length) != 0) {
+                    break;
+                }
+                first += length;
+            }
+            size_t last = rowBytes;
+            while (last > first) {
+                size_t blockStart = (last - 1) / BlockBytes * BlockBytes;
+                if (std::memcmp(a + blockStart, b + blockStart, last - blockStart) != 0) {
+                    break;
+                }
+                last = blockStart;
+            }
+            begin[0] = std::min(begin[0], static_cast<int>(first / voxelBytes));
+            end[0] = std::max(end[0], static_cast<int>((last + voxelBytes - 1) / voxelBytes));
+            begin[1] = std::min(begin[1], y);
+            end[1] = std::max(end[1], y + 1);
+            begin[2] = std::min(begin[2], z);
+            end[2] = z + 1;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool ImageDeltaEncoder::sameGeometry(const DeviceState& state, igtl::ImageMessage* imageMsg) {
+    int dimension[3];
+    imageMsg->GetDimensions(dimension);
+    float spacing[3];
+    imageMsg->GetSpacing(spacing[0], spacing[1], spacing[2]);
+    igtl::Matrix4x4 matrix;
+    imageMsg->GetMatrix(matrix);
+    for (int a = 0; a < 3; a++) {
+        if (dimension[a] != state.dimension[a] || spacing[a] != state.spacing[a]) {
+            return false;
+        }
+    }
+    // Moved voxels would be merged with the old image at the old position
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            if (matrix[i][j] != state.matrix[i][j]) {
+                return false;
+            }
+        }
+    }
+    return imageMsg->GetScalarType() == state.scalarType && imageMsg->GetNumComponents() == state.components
+           && imageMsg->GetEndian() == state.endian;
+}
+
+igtl::ImageMessage::Pointer ImageDeltaEncoder::encode(igtl::ImageMessage* imageMsg) {
+    BridgeMetrics& metrics = BridgeMetrics::instance();
+    const qint64 start = BridgeMetrics::now();
+
+    int dimension[3];
+    imageMsg->GetDimensions(dimension);
+    const int components = std::max(1, imageMsg->GetNumComponents());
+    const int voxelBytes = scalarSize(scalarTypeFromIGTL(imageMsg->GetScalarType())) * components;
+    const size_t imageBytes = static_cast<size_t>(dimension[0]) * dimension[1] * dimension[2] * voxelBytes;
+    const char* current = static_cast<const char*>(imageMsg->GetScalarPointer());
+    DeviceState& state = devices[imageMsg->GetDeviceName()];
+
+    bool keyframe = voxelBytes == 0 || state.scalars.size() != imageBytes || !sameGeometry(state, imageMsg)
+                    || state.framesSinceKeyframe + 1 >= keyframeInterval;
+    int begin[3] = {0, 0, 0};
+    int end[3] = {1, 1, 1};
+    size_t deltaBytes = 0;
+    if (!keyframe) {
+        if (!changedRegion(current, state.scalars.data(), dimension, voxelBytes, begin, end)) {
+            // Nothing changed: one voxel keeps the frame (and its timestamp) going out
+            begin[0] = begin[1] = begin[2] = 0;
+            end[0] = end[1] = end[2] = 1;
+        }
+        deltaBytes = static_cast<size_t>(end[0] - begin[0]) * (end[1] - begin[1]) * (end[2] - begin[2]) * voxelBytes;
+        keyframe = deltaBytes > maxDeltaRatio * imageBytes;
+    }
+
+    if (keyframe) {
+        state.scalars.assign(current, current + imageBytes);
+        for (int a = 0; a < 3; a++) {
+            state.dimension[a] = dimension[a];
+        }
+        imageMsg->GetSpacing(state.spacing[0], state.spacing[1], state.spacing[2]);
+        imageMsg->GetMatrix(state.matrix);
+        state.scalarType = imageMsg->GetScalarType();
+        state.components = imageMsg->GetNumComponents();
+        state.endian = imageMsg->GetEndian();
+        state.framesSinceKeyframe = 0;
+        metrics.deltaKeyframes.fetch_add(1, std::memory_order_relaxed);
+        metrics.diffTime.record(BridgeMetrics::now() - start);
+        return igtl::ImageMessage::Pointer();
+    }
+
+    igtl::ImageMessage::Pointer delta = igtl::ImageMessage::New();
+    delta->SetDimensions(dimension[0], dimension[1], dimension[2]);
+    delta->SetSubVolume(end[0] - begin[0], end[1] - begin[1], end[2] - begin[2], begin[0], begin[1], begin[2]);
+    delta->SetScalarType(imageMsg->GetScalarType());
+    delta->SetNumComponents(imageMsg->GetNumComponents());
+    delta->SetEndian(imageMsg->GetEndian());
+    delta->SetSpacing(state.spacing[0], state.spacing[1], state.spacing[2]);
+    delta->SetMatrix(state.matrix);
+    delta->SetDeviceName(imageMsg->GetDeviceName());
+    unsigned int sec, frac;
+    imageMsg->GetTimeStamp(&sec, &frac);
+    delta->SetTimeStamp(sec, frac);
+    delta->AllocateScalars();
+
+    // The subvolume rows go into the message and into the last frame (the
+    // rest of which is unchanged)
+    const size_t rowBytes = static_cast<size_t>(dimension[0]) * voxelBytes;
+    const size_t segmentBytes = static_cast<size_t>(end[0] - begin[0]) * voxelBytes;
+    char* out = static_cast<char*>(delta->GetScalarPointer());
+    for (int z = begin[2]; z < end[2]; z++) {
+        for (int y = begin[1]; y < end[1]; y++) {
+            const size_t offset = (static_cast<size_t>(z) * dimension[1] + y) * rowBytes
+                                  + static_cast<size_t>(begin[0]) * voxelBytes;
+            std::memcpy(out, current + offset, segmentBytes);
+            std::memcpy(state.scalars.data() + offset, current + offset, segmentBytes);
+            out += segmentBytes;
+        }
+    }
+    state.framesSinceKeyframe++;
+
+    metrics.deltaFrames.fetch_add(1, std::memory_order_relaxed);
+    metrics.deltaBytesSaved.fetch_add(imageBytes - deltaBytes, std::memory_order_relaxed);
+    metrics.diffTime.record(BridgeMetrics::now() - start);
+    return delta;
+}
+
+} // namespace mrigtlbridge
@@ -0,0 +1,183 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_preview_widget.h"
+#include "image_tap.h"
+#include "scalar_kernels.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <algorithm>
+
+namespace mrigtlbridge {
+
+PreviewRenderer::PreviewRenderer(QObject* parent)
+    : QThread(parent),
+      stopRequested(false),
+      maxSize(256),
+      rate(10.0),
+      window(0.0),
+      level(0.0),
+      frameCount(0),
+      lastRenderMs(0.0) {
+}
+
+PreviewRenderer::~PreviewRenderer() {
+    stop();
+}
+
+void PreviewRenderer::setWindowLevel(double w, double l) {
+    window = w;
+    level = l;
+}
+
+void PreviewRenderer::stop() {
+    stopRequested = true;
+    if (isRunning()) {
+        wait();
+    }
+    stopRequested = false;
+}
+
+void PreviewRenderer::draw(QPainter& painter, const QRect& target) {
+    QMutexLocker locker(&imageMutex);
+    if (front.isNull()) {
+        return;
+    }
+    QSize size = front.size().scaled(target.size(), Qt::KeepAspectRatio);
+    QRect rect(QPoint(0, 0), size);
+    rect.moveCenter(target.center());
+    painter.drawImage(rect, front);
+}
+
+void PreviewRenderer::run() {
+    ImageTap& tap = ImageTap::instance();
+    tap.attach();
+    quint64 sequence = 0;
+    while (!stopRequested) {
+        igtl::ImageMessage::Pointer image = tap.take(sequence);
+        if (image.IsNotNull()) {
+            render(image);
+            emit frameReady();
+        }
+        QThread::msleep(static_cast<unsigned long>(1000.0 / rate));
+    }
+    tap.detach();
+}
+
+void PreviewRenderer::render(igtl::ImageMessage* image) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int dim[3];
+    image->GetDimensions(dim);
+    if (dim[0] <= 0 || dim[1] <= 0 || dim[2] <= 0) {
+        return;
+    }
+    const int components = std::max(1, image->GetNumComponents());
+    const ScalarType scalarType = scalarTypeFromIGTL(image->GetScalarType());
+    const int scalarSize = mrigtlbridge::scalarSize(scalarType);
+    const bool bigEndian = (image->GetEndian() == igtl::ImageMessage::ENDIAN_BIG);
+    const bool swap = bigEndian != (Q_BYTE_ORDER == Q_BIG_ENDIAN);
+    // The packed message is not modified after it has been sent, so its
+    // scalars can be read here without a copy
+    const unsigned char* data = static_cast<const unsigned char*>(image->GetScalarPointer());
+
+    const int step = std::max(1, (std::max(dim[0], dim[1]) + maxSize - 1) / maxSize);
+    const int width = (dim[0] + step - 1) / step;
+    const int height = (dim[1] + step - 1) / step;
+    const size_t sliceOffset = static_cast<size_t>(dim[2] / 2) * dim[0] * dim[1];
+
+    values.resize(static_cast<size_t>(width) * height);
+    float lo = 0.0f;
+    float hi = 0.0f;
+    bool valid = dispatchScalarType(scalarType, [&](auto traits) {
+        using T = typename decltype(traits)::Type;
+        for (int y = 0; y < height; y++) {
+            size_t row = sliceOffset + static_cast<size_t>(y) * step * dim[0];
+            for (int x = 0; x < width; x++) {
+                size_t index = (row + static_cast<size_t>(x) * step) * components;
+                float value = static_cast<float>(loadScalar<T>(data + index * scalarSize, swap));
+                values[static_cast<size_t>(y) * width + x] = value;
+                if (x == 0 && y == 0) {
+                    lo = hi = value;
+                } else {
+                    lo = std::min(lo, value);
+                    hi = std::max(hi, value);
+                }
+            }
+        }
+    });
+    if (!valid) {
+        return;
+    }
+    if (window > 0.0) {
+        lo = static_cast<float>(level - window / 2.0);
+        hi = static_cast<float>(level + window / 2.0);
+    }
+    const float scale = (hi > lo) ? 255.0f / (hi - lo) : 0.0f;
+
+    if (back.width() != width || back.height() != height) {
+        back = QImage(width, height, QImage::Format_Grayscale8);
+    }
+    for (int y = 0; y < height; y++) {
+        uchar* line = back.scanLine(y);
+        const float* in = values.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++) {
+            line[x] = static_cast<uchar>(std::min(std::max((in[x] - lo) * scale, 0.0f), 255.0f));
+        }
+    }
+
+    {
+        QMutexLocker locker(&imageMutex);
+        std::swap(front, back);
+    }
+    frameCount++;
+    lastRenderMs = timer.nsecsElapsed() / 1.0e6;
+}
+
+ImagePreviewWidget::ImagePreviewWidget(QWidget* parent)
+    : QWidget(parent),
+      renderer(new PreviewRenderer(this)) {
+    setMinimumSize(128, 128);
+    connect(renderer, &PreviewRenderer::frameReady, this, &ImagePreviewWidget::onFrameReady);
+}
+
+ImagePreviewWidget::~ImagePreviewWidget() {
+    renderer->stop();
+}
+
+void ImagePreviewWidget::setActive(bool active) {
+    if (active && !renderer->isRunning()) {
+        renderer->start();
+    } else if (!active) {
+        renderer->stop();
+    }
+    update();
+}
+
+void ImagePreviewWidget::paintEvent(QPaintEvent* event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    if (renderer->isRunning()) {
+        renderer->draw(painter, rect());
+    }
+}
+
+void ImagePreviewWidget::onFrameReady() {
+    // Repaints are coalesced, so a slow GUI thread only skips frames
+    update();
+}
+
+} // namespace mrigtlbridge
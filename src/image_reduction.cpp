@@ -0,0 +1,285 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_reduction.h"
+#include "scalar_kernels.h"
+#include "thread_pool.h"
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// Comma-separated integers; false unless there are between 1 and 'max' values >= 'min'
+bool parseInts(const QString& text, int* values, int max, int min) {
+    QStringList items = text.split(',');
+    if (items.isEmpty() || items.size() > max) {
+        return false;
+    }
+    for (int i = 0; i < items.size(); i++) {
+        bool ok = false;
+        values[i] = items[i].trimmed().toInt(&ok);
+        if (!ok || values[i] < min) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct ReduceArgs {
+    const char* source;
+    char* dest;
+    int sourceDim[3];
+    int components;
+    bool swap;      // The scalars are not in host byte order
+    ReductionPlan plan;
+};
+
+// Output rows [rowBegin, rowEnd) of the reduced image, row r being line
+// r % ny of slice r / ny
+template <typename T>
+void reduceRows(const ReduceArgs& a, int rowBegin, int rowEnd) {
+    const ReductionPlan& p = a.plan;
+    const int c = a.components;
+    const size_t sourceRow = static_cast<size_t>(a.sourceDim[0]) * c;      // Scalars per source row
+    const size_t destRow = static_cast<size_t>(p.dimension[0]) * c;
+    const T* source = reinterpret_cast<const T*>(a.source);
+    T* dest = reinterpret_cast<T*>(a.dest);
+
+    if (!p.boxFilter) {
+        // Decimation: the voxel in the middle of each block; bytes are moved
+        // as they are, so the byte order does not matter
+        const int pick[3] = {(p.factor[0] - 1) / 2, (p.factor[1] - 1) / 2, (p.factor[2] - 1) / 2};
+        for (int r = rowBegin; r < rowEnd; r++) {
+            const int y = r % p.dimension[1];
+            const int z = r / p.dimension[1];
+            const size_t sy = static_cast<size_t>(p.origin[1]) + static_cast<size_t>(y) * p.factor[1] + pick[1];
+            const size_t sz = static_cast<size_t>(p.origin[2]) + static_cast<size_t>(z) * p.factor[2] + pick[2];
+            const T* in = source + (sz * a.sourceDim[1] + sy) * sourceRow + (static_cast<size_t>(p.origin[0]) + pick[0]) * c;
+            T* out = dest + static_cast<size_t>(r) * destRow;
+            if (p.factor[0] == 1) {
+                std::memcpy(out, in, destRow * sizeof(T));
+            } else {
+                const size_t stride = static_cast<size_t>(p.factor[0]) * c;
+                for (int x = 0; x < p.dimension[0]; x++) {
+                    for (int k = 0; k < c; k++) {
+                        out[x * c + k] = in[x * stride + k];
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // Box filter: sum the source rows of a block into 'line' (contiguous, so
+    // the adds vectorize), then the columns of each block, then scale. Up to
+    // 16-bit types the sums are exact in float.
+    using Acc = std::conditional_t<(sizeof(T) <= 2), float, double>;
+    const size_t lineLength = static_cast<size_t>(p.dimension[0]) * p.factor[0] * c;
+    std::vector<Acc> line(lineLength);
+    std::vector<Acc> sums(destRow);
+    const Acc scale = Acc(1) / (static_cast<Acc>(p.factor[0]) * p.factor[1] * p.factor[2]);
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const int y = r % p.dimension[1];
+        const int z = r / p.dimension[1];
+        std::fill(line.begin(), line.end(), Acc(0));
+        for (int dz = 0; dz < p.factor[2]; dz++) {
+            const size_t sz = static_cast<size_t>(p.origin[2]) + static_cast<size_t>(z) * p.factor[2] + dz;
+            for (int dy = 0; dy < p.factor[1]; dy++) {
+                const size_t sy = static_cast<size_t>(p.origin[1]) + static_cast<size_t>(y) * p.factor[1] + dy;
+                const T* in = source + (sz * a.sourceDim[1] + sy) * sourceRow + static_cast<size_t>(p.origin[0]) * c;
+                if (a.swap) {
+                    for (size_t i = 0; i < lineLength; i++) {
+                        line[i] += static_cast<Acc>(loadScalar<T>(in + i, true));
+                    }
+                } else {
+                    for (size_t i = 0; i < lineLength; i++) {
+                        line[i] += static_cast<Acc>(in[i]);
+                    }
+                }
+            }
+        }
+        const size_t stride = static_cast<size_t>(p.factor[0]) * c;
+        for (int x = 0; x < p.dimension[0]; x++) {
+            for (int k = 0; k < c; k++) {
+                Acc sum = 0;
+                for (int dx = 0; dx < p.factor[0]; dx++) {
+                    sum += line[x * stride + dx * c + k];
+                }
+                sums[x * c + k] = sum * scale;
+            }
+        }
+        T* out = dest + static_cast<size_t>(r) * destRow;
+        convertFromFloat<T>(sums.data(), destRow, out);
+        if (a.swap) {
+            swapScalars(out, destRow);
+        }
+    }
+}
+
+} // namespace
+
+bool ImageReduction::isIdentity() const {
+    for (int a = 0; a < 3; a++) {
+        if (roiOrigin[a] != 0 || roiSize[a] != 0 || factor[a] != 1) {
+            return false;
+        }
+    }
+    return maxSize == 0;
+}
+
+bool ImageReduction::parse(const QString& text, QString& error) {
+    ImageReduction result;
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty() || trimmed == "none") {
+        *this = result;
+        return true;
+    }
+    const QStringList options = trimmed.split(' ');
+    for (const QString& option : options) {
+        if (option.isEmpty()) {
+            continue;
+        }
+        const QString key = option.section('=', 0, 0);
+        const QString value = option.section('=', 1);
+        if (key == "roi") {
+            int roi[6] = {0, 0, 0, 0, 0, 0};
+            if (!parseInts(value, roi, 6, 0) || value.split(',').size() != 6) {
+                error = QString("Invalid ROI '%1' (x,y,z,w,h,d)").arg(value);
+                return false;
+            }
+            for (int a = 0; a < 3; a++) {
+                result.roiOrigin[a] = roi[a];
+                result.roiSize[a] = roi[a + 3];
+            }
+        } else if (key == "factor") {
+            int f[3] = {0, 0, 1};
+            if (!parseInts(value, f, 3, 1)) {
+                error = QString("Invalid factor '%1'").arg(value);
+                return false;
+            }
+            result.factor[0] = f[0];
+            result.factor[1] = (f[1] > 0) ? f[1] : f[0];
+            result.factor[2] = f[2];
+        } else if (key == "filter") {
+            if (value != "box" && value != "pick") {
+                error = QString("Invalid filter '%1' ('box' or 'pick')").arg(value);
+                return false;
+            }
+            result.boxFilter = (value == "box");
+        } else if (key == "max") {
+            if (!parseInts(value, &result.maxSize, 1, 1)) {
+                error = QString("Invalid maximum size '%1'").arg(value);
+                return false;
+            }
+        } else {
+            error = QString("Unknown image reduction option '%1'").arg(option);
+            return false;
+        }
+    }
+    *this = result;
+    return true;
+}
+
+QString ImageReduction::toString() const {
+    if (isIdentity()) {
+        return "none";
+    }
+    QStringList options;
+    if (roiOrigin[0] || roiOrigin[1] || roiOrigin[2] || roiSize[0] || roiSize[1] || roiSize[2]) {
+        options << QString("roi=%1,%2,%3,%4,%5,%6").arg(roiOrigin[0]).arg(roiOrigin[1]).arg(roiOrigin[2])
+                   .arg(roiSize[0]).arg(roiSize[1]).arg(roiSize[2]);
+    }
+    if (factor[0] != 1 || factor[1] != 1 || factor[2] != 1) {
+        options << QString("factor=%1,%2,%3").arg(factor[0]).arg(factor[1]).arg(factor[2]);
+    }
+    options << QString("filter=%1").arg(boxFilter ? "box" : "pick");
+    if (maxSize > 0) {
+        options << QString("max=%1").arg(maxSize);
+    }
+    return options.join(' ');
+}
+
+bool planReduction(const int dimension[3], const ImageReduction& reduction, ReductionPlan& plan) {
+    plan.boxFilter = reduction.boxFilter;
+    for (int a = 0; a < 3; a++) {
+        const int origin = reduction.roiOrigin[a];
+        if (origin >= dimension[a]) {
+            return false;
+        }
+        int length = dimension[a] - origin;
+        if (reduction.roiSize[a] > 0) {
+            length = std::min(length, reduction.roiSize[a]);
+        }
+        int factor = std::max(1, reduction.factor[a]);
+        if (reduction.maxSize > 0) {
+            factor = std::max(factor, (length + reduction.maxSize - 1) / reduction.maxSize);
+        }
+        factor = std::min(factor, length);
+        plan.origin[a] = origin;
+        plan.factor[a] = factor;
+        plan.dimension[a] = length / factor;  // A partial block at the end is dropped
+    }
+    return true;
+}
+
+void reduceImage(igtl::ImageMessage* source, const ReductionPlan& plan, igtl::ImageMessage* dest, ThreadPool* pool) {
+    ReduceArgs args;
+    source->GetDimensions(args.sourceDim);
+    args.source = static_cast<const char*>(source->GetScalarPointer());
+    args.dest = static_cast<char*>(dest->GetScalarPointer());
+    args.components = std::max(1, source->GetNumComponents());
+    args.swap = (source->GetEndian() == igtl::ImageMessage::ENDIAN_BIG) != (Q_BYTE_ORDER == Q_BIG_ENDIAN);
+    args.plan = plan;
+
+    const int rows = plan.dimension[1] * plan.dimension[2];
+    dispatchScalarType(scalarTypeFromIGTL(source->GetScalarType()), [&](auto traits) {
+        using T = typename decltype(traits)::Type;
+        if (pool && rows > 1) {
+            pool->parallelFor(rows, [&](int begin, int end) { reduceRows<T>(args, begin, end); }, 16);
+        } else {
+            reduceRows<T>(args, 0, rows);
+        }
+    });
+
+    // Voxel i of the reduced image is centered on source voxel
+    // origin + i * factor + first, where 'first' is the center of the block
+    // (box) or the picked voxel. The IGTL position is the center of the image.
+    float spacing[3];
+    source->GetSpacing(spacing[0], spacing[1], spacing[2]);
+    igtl::Matrix4x4 matrix;
+    source->GetMatrix(matrix);
+    double shift[3];
+    for (int a = 0; a < 3; a++) {
+        const double first = plan.boxFilter ? (plan.factor[a] - 1) / 2.0 : (plan.factor[a] - 1) / 2;
+        const double center = plan.origin[a] + first + plan.factor[a] * (plan.dimension[a] - 1) / 2.0;
+        shift[a] = (center - (args.sourceDim[a] - 1) / 2.0) * spacing[a];
+    }
+    for (int i = 0; i < 3; i++) {
+        matrix[i][3] += static_cast<float>(matrix[i][0] * shift[0] + matrix[i][1] * shift[1] + matrix[i][2] * shift[2]);
+    }
+    dest->SetSpacing(spacing[0] * plan.factor[0], spacing[1] * plan.factor[1], spacing[2] * plan.factor[2]);
+    dest->SetMatrix(matrix);
+    dest->SetDeviceName(source->GetDeviceName());
+    dest->SetEndian(source->GetEndian());
+    unsigned int sec, frac;
+    source->GetTimeStamp(&sec, &frac);
+    dest->SetTimeStamp(sec, frac);
+}
+
+} // namespace mrigtlbridge
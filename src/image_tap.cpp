@@ -0,0 +1,54 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "image_tap.h"
+
+namespace mrigtlbridge {
+
+ImageTap& ImageTap::instance() {
+    static ImageTap tap;
+    return tap;
+}
+
+void ImageTap::attach() {
+    consumers.fetch_add(1);
+}
+
+void ImageTap::detach() {
+    if (consumers.fetch_sub(1) == 1) {
+        // Release the last image with the last consumer
+        std::lock_guard<std::mutex> lock(mutex);
+        latest = nullptr;
+    }
+}
+
+void ImageTap::publish(const igtl::ImageMessage::Pointer& image) {
+    if (!isActive()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    latest = image;
+    published++;
+}
+
+igtl::ImageMessage::Pointer ImageTap::take(quint64& sequence) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (published == sequence || latest.IsNull()) {
+        return nullptr;
+    }
+    sequence = published;
+    return latest;
+}
+
+} // namespace mrigtlbridge
@@ -13,7 +13,10 @@
 =========================================================================*/
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QLoggingCategory>
+#include <QTimer>
+#include <cstring>
 #include <memory>
 
 // Forward declarations to make MOC happy
@@ -24,8 +27,12 @@ QT_FORWARD_DECLARE_CLASS(QWidget)
 #include "igtl_widget.h"
 #include "mrsim_widget.h"
 #include "mr_igtl_bridge_window.h"
+#include "startup_report.h"
 
 int main(int argc, char** argv) {
+    QElapsedTimer startup;
+    startup.start();
+
     QApplication app(argc, argv);
     
     // Set up logging
@@ -49,6 +56,17 @@ int main(int argc, char** argv) {
     mainWindow.setup();
     mainWindow.resize(1000, 800);
     mainWindow.show();
-    
+
+    // --startup-report: time to the first pass of the event loop and peak RSS,
+    // for comparison with the headless mrigtl_bridge
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--startup-report") == 0) {
+            QTimer::singleShot(0, &app, [&startup]() {
+                mrigtlbridge::printStartupReport("mrigtl_lib", startup.elapsed());
+                QApplication::quit();
+            });
+        }
+    }
+
     return app.exec();
 }
\ No newline at end of file
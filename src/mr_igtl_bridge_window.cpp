@@ -14,7 +14,9 @@
 
 #include "mr_igtl_bridge_window.h"
 #include "widget_base.h"
+#include "performance_panel.h"
 #include <QHBoxLayout>
+#include <QVBoxLayout>
 #include <QFrame>
 #include <QThread>
 #include <QApplication>
@@ -25,6 +27,7 @@ MainWindow::MainWindow(QWidget* parent)
     : QWidget(parent),
       leftWidget(nullptr),
       rightWidget(nullptr),
+      performancePanel(nullptr),
       title("MRI OpenIGTLink Bridge") {
 }
 
@@ -64,8 +67,10 @@ void MainWindow::setRightWidget(WidgetBase* widget) {
 void MainWindow::setup() {
     setWindowTitle(title);
 
-    QHBoxLayout* topLayout = new QHBoxLayout(this);
-    setLayout(topLayout);
+    QVBoxLayout* windowLayout = new QVBoxLayout(this);
+    setLayout(windowLayout);
+    QHBoxLayout* topLayout = new QHBoxLayout();
+    windowLayout->addLayout(topLayout, 1);
 
     // Left Layout (OpenIGTLink)
     QWidget* leftContainer = new QWidget(this);
@@ -86,6 +91,10 @@ void MainWindow::setup() {
     if (rightWidget) {
         rightWidget->buildGUI(rightContainer);
     }
+
+    // Throughput and latency of both sides
+    performancePanel = new PerformancePanel(this);
+    windowLayout->addWidget(performancePanel);
 }
 
 } // namespace mrigtlbridge
\ No newline at end of file
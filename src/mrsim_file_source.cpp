@@ -0,0 +1,416 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "mrsim_file_source.h"
+#include "scalar_type.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// NRRD type names (see the NRRD format specification) to scalar type names
+const char* nrrdType(const std::string& type) {
+    static const char* const names[][2] = {
+        {"signed char", "int8"}, {"int8", "int8"}, {"int8_t", "int8"},
+        {"uchar", "uint8"}, {"unsigned char", "uint8"}, {"uint8", "uint8"}, {"uint8_t", "uint8"},
+        {"short", "int16"}, {"short int", "int16"}, {"signed short", "int16"}, {"signed short int", "int16"},
+        {"int16", "int16"}, {"int16_t", "int16"},
+        {"ushort", "uint16"}, {"unsigned short", "uint16"}, {"unsigned short int", "uint16"},
+        {"uint16", "uint16"}, {"uint16_t", "uint16"},
+        {"int", "int32"}, {"signed int", "int32"}, {"int32", "int32"}, {"int32_t", "int32"},
+        {"uint", "uint32"}, {"unsigned int", "uint32"}, {"uint32", "uint32"}, {"uint32_t", "uint32"},
+        {"float", "float32"}, {"double", "float64"},
+    };
+    for (const auto& name : names) {
+        if (type == name[0]) {
+            return name[1];
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> tokens(const std::string& value) {
+    std::vector<std::string> result;
+    std::istringstream stream(value);
+    std::string token;
+    while (stream >> token) {
+        result.push_back(token);
+    }
+    return result;
+}
+
+// "(a,b,c)" -> {a, b, c}; "none" -> empty
+std::vector<double> parseVector(const std::string& token) {
+    std::vector<double> result;
+    if (token.size() < 2 || token.front() != '(' || token.back() != ')') {
+        return result;
+    }
+    std::istringstream stream(token.substr(1, token.size() - 2));
+    std::string component;
+    while (std::getline(stream, component, ',')) {
+        result.push_back(std::atof(component.c_str()));
+    }
+    return result;
+}
+
+int hostEndian() {
+    int n = 1; // for checking endianness:
+    return (*(char *)&n == 1) ? 2 : 1; // 2 if little endian
+}
+
+} // namespace
+
+FileMapping::Map::~Map() {
+    if (data) {
+        file->unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+    }
+}
+
+MRSimFileSource::MRSimFileSource()
+    : endian(2),
+      dimensions{0, 0, 0},
+      spacing{1.0, 1.0, 1.0},
+      matrix{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}},
+      frameInterval(0.0) {
+}
+
+void MRSimFileSource::getMatrix(double m[4][4]) const {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = matrix[i][j];
+        }
+    }
+}
+
+bool MRSimFileSource::map(const QString& path, FileMapping& result) {
+    QFileInfo info(path);
+    if (!info.exists()) {
+        error = QString("File not found: %1").arg(path);
+        return false;
+    }
+
+    auto map = std::make_shared<FileMapping::Map>();
+    map->size = info.size();
+    map->file.reset(new QFile(path));
+    if (map->size <= 0 || !map->file->open(QIODevice::ReadOnly)) {
+        error = QString("Cannot open %1").arg(path);
+        return false;
+    }
+    map->data = reinterpret_cast<const char*>(map->file->map(0, map->size));
+    if (!map->data) {
+        error = QString("Cannot map %1: %2").arg(path, map->file->errorString());
+        return false;
+    }
+    result.map = map;
+    return true;
+}
+
+bool MRSimFileSource::open(const QString& path, const RawSettings& raw) {
+    error.clear();
+    frames.clear();
+    mapping = FileMapping();
+
+    FileMapping file;
+    if (!map(path, file)) {
+        return false;
+    }
+    const char* data = file.data();
+    qint64 size = file.size();
+
+    int frameCount = 0;
+    if (size >= 8 && std::strncmp(data, "NRRD000", 7) == 0) {
+        qint64 offset = 0;
+        QString dataFile;
+        if (!parseNrrd(path, data, size, offset, dataFile, frameCount)) {
+            return false;
+        }
+        if (!dataFile.isEmpty()) {
+            // Detached header: the frames are in the data file
+            if (!map(dataFile, file)) {
+                return false;
+            }
+            data = file.data();
+            size = file.size();
+        }
+        if (offset < 0) {
+            // 'byte skip: -1': the data is at the end of the file
+            offset = size - static_cast<qint64>(frameCount) * dimensions[0] * dimensions[1] * dimensions[2]
+                     * scalarSize(scalarTypeFromName(dtype));
+        }
+        if (offset < 0 || offset >= size) {
+            error = QString("%1: data offset out of range").arg(path);
+            return false;
+        }
+        data += offset;
+        size -= offset;
+    } else {
+        if (scalarTypeFromName(raw.dtype) == ScalarType::Invalid) {
+            error = QString("Invalid data type: %1").arg(raw.dtype);
+            return false;
+        }
+        if (raw.width <= 0 || raw.height <= 0 || raw.slices <= 0 || raw.headerBytes < 0 || raw.headerBytes >= size) {
+            error = QString("%1: invalid raw image settings").arg(path);
+            return false;
+        }
+        dtype = raw.dtype;
+        endian = hostEndian();
+        dimensions[0] = raw.width;
+        dimensions[1] = raw.height;
+        dimensions[2] = raw.slices;
+        for (int i = 0; i < 3; i++) {
+            spacing[i] = raw.spacing[i];
+        }
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                matrix[i][j] = (i == j) ? 1.0 : 0.0;
+            }
+        }
+        frameInterval = 0.0;
+        data += raw.headerBytes;
+        size -= raw.headerBytes;
+    }
+
+    if (!setFrames(data, size, frameCount)) {
+        return false;
+    }
+    mapping = file;
+    return true;
+}
+
+bool MRSimFileSource::setFrames(const char* data, qint64 size, int frameCount) {
+    qint64 frameBytes = static_cast<qint64>(dimensions[0]) * dimensions[1] * dimensions[2]
+                        * scalarSize(scalarTypeFromName(dtype));
+    if (frameBytes <= 0 || frameBytes > INT_MAX) {
+        error = "Invalid frame size";
+        return false;
+    }
+    qint64 available = size / frameBytes;
+    if (available == 0) {
+        error = "The file is smaller than one frame";
+        return false;
+    }
+    // Raw files: as many frames as the file holds. NRRD: as many as the header
+    // says, if the data is complete.
+    if (frameCount <= 0 || frameCount > available) {
+        frameCount = static_cast<int>(std::min<qint64>(available, INT_MAX));
+    }
+
+    frames.reserve(frameCount);
+    for (int f = 0; f < frameCount; f++) {
+        frames.append(QByteArray::fromRawData(data + f * frameBytes, static_cast<int>(frameBytes)));
+    }
+    return true;
+}
+
+bool MRSimFileSource::parseNrrd(const QString& path, const char* data, qint64 size, qint64& dataOffset,
+                                QString& dataFile, int& frameCount) {
+    // The header ends with the first empty line
+    std::string header;
+    qint64 end = -1;
+    for (qint64 i = 0; i + 1 < size && i < 65536; i++) {
+        if (data[i] == '\n' && data[i + 1] == '\n') {
+            end = i + 2;
+            break;
+        }
+        if (data[i] == '\n' && data[i + 1] == '\r' && i + 2 < size && data[i + 2] == '\n') {
+            end = i + 3;
+            break;
+        }
+    }
+    if (end < 0) {
+        error = QString("%1: NRRD header not terminated").arg(path);
+        return false;
+    }
+    header.assign(data, static_cast<size_t>(end));
+
+    std::string type;
+    std::string encoding = "raw";
+    std::string endianName;
+    std::string space;
+    int dimension = 0;
+    qint64 byteSkip = 0;
+    std::vector<std::string> sizes;
+    std::vector<std::string> kinds;
+    std::vector<std::string> spacings;
+    std::vector<std::string> units;
+    std::vector<std::string> directions;
+    std::vector<double> origin;
+
+    std::istringstream lines(header);
+    std::string line;
+    std::getline(lines, line);  // Magic
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t colon = line.find(": ");
+        size_t keyValue = line.find(":=");
+        if (colon == std::string::npos || (keyValue != std::string::npos && keyValue < colon)) {
+            continue;  // Key/value pairs are not used
+        }
+        std::string field = line.substr(0, colon);
+        std::string value = line.substr(colon + 2);
+        if (field == "type") {
+            type = value;
+        } else if (field == "dimension") {
+            dimension = std::atoi(value.c_str());
+        } else if (field == "sizes") {
+            sizes = tokens(value);
+        } else if (field == "encoding") {
+            encoding = value;
+        } else if (field == "endian") {
+            endianName = value;
+        } else if (field == "byte skip" || field == "byteskip") {
+            byteSkip = std::atoll(value.c_str());
+        } else if (field == "data file" || field == "datafile") {
+            dataFile = QFileInfo(path).dir().filePath(QString::fromStdString(value));
+        } else if (field == "kinds") {
+            kinds = tokens(value);
+        } else if (field == "spacings") {
+            spacings = tokens(value);
+        } else if (field == "units") {
+            units = tokens(value);
+        } else if (field == "space") {
+            space = value;
+        } else if (field == "space directions") {
+            directions = tokens(value);
+        } else if (field == "space origin") {
+            origin = parseVector(value);
+        }
+    }
+
+    const char* typeName = nrrdType(type);
+    if (!typeName) {
+        error = QString("%1: unsupported NRRD type '%2'").arg(path, QString::fromStdString(type));
+        return false;
+    }
+    if (encoding != "raw") {
+        error = QString("%1: only raw NRRD encoding can be mapped (found '%2')").arg(path, QString::fromStdString(encoding));
+        return false;
+    }
+    if (dimension < 2 || dimension > 4 || static_cast<int>(sizes.size()) != dimension) {
+        error = QString("%1: unsupported NRRD dimension %2").arg(path).arg(dimension);
+        return false;
+    }
+    if (dataFile.contains('%') || dataFile.endsWith("LIST")) {
+        error = QString("%1: multiple NRRD data files are not supported").arg(path);
+        return false;
+    }
+
+    // The last axis is the time axis of a 4D image, or of a 3D image of kind 'time'
+    int timeAxis = -1;
+    if (dimension == 4) {
+        timeAxis = 3;
+    } else if (dimension == 3 && kinds.size() == 3 && kinds[2] == "time") {
+        timeAxis = 2;
+    }
+    int spatialAxes = (timeAxis >= 0) ? timeAxis : dimension;
+
+    dtype = typeName;
+    endian = (endianName == "big") ? 1 : (endianName == "little") ? 2 : hostEndian();
+    for (int a = 0; a < 3; a++) {
+        dimensions[a] = (a < spatialAxes) ? std::atoi(sizes[a].c_str()) : 1;
+    }
+    frameCount = (timeAxis >= 0) ? std::atoi(sizes[timeAxis].c_str()) : 1;
+
+    // Directions (columns) and spacing of the spatial axes. 'space directions'
+    // has an entry per axis ('none' for non-spatial ones); otherwise 'spacings'.
+    double columns[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    for (int a = 0; a < 3; a++) {
+        spacing[a] = 1.0;
+    }
+    if (!directions.empty()) {
+        int axis = 0;
+        for (const std::string& token : directions) {
+            std::vector<double> v = parseVector(token);
+            if (v.size() != 3 || axis >= 3) {
+                continue;
+            }
+            double norm = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (norm > 0.0) {
+                spacing[axis] = norm;
+                for (int i = 0; i < 3; i++) {
+                    columns[axis][i] = v[i] / norm;
+                }
+            }
+            axis++;
+        }
+        if (axis == 2) {
+            // 2D image in 3D space: the normal is the cross product of the in-plane axes
+            columns[2][0] = columns[0][1] * columns[1][2] - columns[0][2] * columns[1][1];
+            columns[2][1] = columns[0][2] * columns[1][0] - columns[0][0] * columns[1][2];
+            columns[2][2] = columns[0][0] * columns[1][1] - columns[0][1] * columns[1][0];
+        }
+    } else {
+        for (int a = 0; a < spatialAxes && a < static_cast<int>(spacings.size()); a++) {
+            double s = std::atof(spacings[a].c_str());
+            if (s > 0.0) {
+                spacing[a] = s;
+            }
+        }
+    }
+
+    // LPS to RAS
+    double sign[3] = {1.0, 1.0, 1.0};
+    if (space == "left-posterior-superior" || space == "LPS" ||
+        space == "left-posterior-superior-time" || space == "LPST") {
+        sign[0] = -1.0;
+        sign[1] = -1.0;
+    }
+    for (int i = 0; i < 3; i++) {
+        double o = (origin.size() == 3) ? origin[i] : 0.0;
+        double center = o;
+        for (int a = 0; a < 3; a++) {
+            matrix[i][a] = sign[i] * columns[a][i];
+            center += columns[a][i] * spacing[a] * (dimensions[a] - 1) / 2.0;
+        }
+        matrix[i][3] = sign[i] * center;
+        matrix[3][i] = 0.0;
+    }
+    matrix[3][3] = 1.0;
+
+    // Frame interval from the spacing of the time axis ('ms' or seconds)
+    frameInterval = 0.0;
+    if (timeAxis >= 0 && timeAxis < static_cast<int>(spacings.size())) {
+        double s = std::atof(spacings[timeAxis].c_str());
+        if (s > 0.0) {
+            bool ms = timeAxis < static_cast<int>(units.size()) && units[timeAxis].find("ms") != std::string::npos;
+            frameInterval = ms ? s / 1000.0 : s;
+        }
+    }
+
+    // Attached data follows the header; detached data starts at 'byte skip'
+    if (byteSkip < 0) {
+        dataOffset = -1;
+    } else {
+        dataOffset = (dataFile.isEmpty() ? end : 0) + byteSkip;
+    }
+    return true;
+}
+
+} // namespace mrigtlbridge
@@ -0,0 +1,224 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "mrsim_image_generator.h"
+#include "scalar_type.h"
+#include "thread_pool.h"
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace mrigtlbridge {
+
+namespace {
+
+// 3D Shepp-Logan phantom (Kak & Slaney geometry, Toft contrast) with a T2 (ms)
+// per ellipsoid for the multi-echo decay.
+struct Ellipsoid {
+    double a, b, c;       // Semi-axes
+    double x0, y0, z0;    // Center
+    double phi;           // Rotation about z (degrees)
+    double intensity;
+    double t2;
+};
+
+const Ellipsoid SheppLogan[] = {
+    {0.6900, 0.920, 0.900,  0.00,  0.000,  0.000,   0.0,  1.0,  40.0},
+    {0.6624, 0.874, 0.880,  0.00,  0.000,  0.000,   0.0, -0.8,  80.0},
+    {0.4100, 0.160, 0.210, -0.22,  0.000, -0.250, 108.0, -0.2, 250.0},
+    {0.3100, 0.110, 0.220,  0.22,  0.000, -0.250,  72.0, -0.2, 250.0},
+    {0.2100, 0.250, 0.500,  0.00,  0.350, -0.250,   0.0,  0.1, 120.0},
+    {0.0460, 0.046, 0.046,  0.00,  0.100, -0.250,   0.0,  0.1, 120.0},
+    {0.0460, 0.023, 0.020, -0.08, -0.650, -0.250,   0.0,  0.1, 120.0},
+    {0.0460, 0.023, 0.020,  0.06, -0.650, -0.250,  90.0,  0.1, 120.0},
+    {0.0560, 0.040, 0.100,  0.06, -0.105,  0.625,  90.0,  0.1, 120.0},
+    {0.0560, 0.056, 0.100,  0.00,  0.100,  0.625,   0.0,  0.1, 120.0},
+};
+
+const double PI = 3.14159265358979323846;
+
+// cos/sin of 'phi' for each ellipsoid
+struct RotationTable {
+    double values[sizeof(SheppLogan) / sizeof(SheppLogan[0])][2];
+    RotationTable() {
+        for (size_t n = 0; n < sizeof(SheppLogan) / sizeof(SheppLogan[0]); n++) {
+            values[n][0] = std::cos(SheppLogan[n].phi * PI / 180.0);
+            values[n][1] = std::sin(SheppLogan[n].phi * PI / 180.0);
+        }
+    }
+    const double* operator[](size_t n) const { return values[n]; }
+};
+const RotationTable EllipsoidRotation;
+
+template <typename T>
+void store(char* buffer, size_t index, double value, double maxValue) {
+    double v = std::min(std::max(value, 0.0), 1.0) * maxValue;
+    reinterpret_cast<T*>(buffer)[index] = static_cast<T>(v);
+}
+
+} // namespace
+
+MRSimImageGenerator::MRSimImageGenerator()
+    : scalarType(5),
+      scalarSize(2) {
+}
+
+bool MRSimImageGenerator::configure(const Settings& s) {
+    const ScalarType type = scalarTypeFromName(s.dtype);
+    if (type == ScalarType::Invalid) {
+        qWarning() << "MRSimImageGenerator::configure(): Invalid data type" << s.dtype.c_str();
+        return false;
+    }
+    if (s.width <= 0 || s.height <= 0 || s.slices <= 0 || s.echoes <= 0 || s.ringSize <= 0) {
+        qWarning() << "MRSimImageGenerator::configure(): Invalid matrix size";
+        return false;
+    }
+    // Each image is a single QByteArray
+    int imageSlices = s.multiSlice ? 1 : s.slices;
+    if (static_cast<double>(s.width) * s.height * imageSlices * mrigtlbridge::scalarSize(type) > INT_MAX) {
+        qWarning() << "MRSimImageGenerator::configure(): Image too large";
+        return false;
+    }
+
+    settings = s;
+    scalarType = static_cast<int>(type);
+    scalarSize = mrigtlbridge::scalarSize(type);
+    frames.clear();
+    return true;
+}
+
+size_t MRSimImageGenerator::getFrameBytes() const {
+    return static_cast<size_t>(settings.width) * settings.height * settings.slices * settings.echoes * scalarSize;
+}
+
+double MRSimImageGenerator::sample(double x, double y, double z, int frame, int echo) const {
+    const std::string& phantom = settings.phantom;
+    double phase = 2.0 * PI * frame / settings.ringSize;
+
+    if (phantom == "checker") {
+        // 16 squares across, shifted by one square over the ring
+        double shift = 2.0 * frame / (8.0 * settings.ringSize);
+        int cx = static_cast<int>(std::floor((x + 1.0 + shift) * 8.0));
+        int cy = static_cast<int>(std::floor((y + 1.0) * 8.0));
+        int cz = static_cast<int>(std::floor((z + 1.0) * 8.0));
+        return ((cx + cy + cz) & 1) ? 0.8 : 0.2;
+    } else if (phantom == "gradient") {
+        return 0.5 + 0.25 * (x + std::sin(phase) * y);
+    }
+
+    // Shepp-Logan; breathing-like scaling along y over the ring. The density is
+    // additive as in the original phantom; the T2 is that of the innermost
+    // ellipsoid containing the point.
+    y /= 1.0 + 0.03 * std::sin(phase);
+    double density = 0.0;
+    double t2 = 0.0;
+    for (size_t n = 0; n < sizeof(SheppLogan) / sizeof(SheppLogan[0]); n++) {
+        const Ellipsoid& e = SheppLogan[n];
+        double dx = x - e.x0;
+        double dy = y - e.y0;
+        double dz = z - e.z0;
+        double u = (EllipsoidRotation[n][0] * dx + EllipsoidRotation[n][1] * dy) / e.a;
+        double v = (-EllipsoidRotation[n][1] * dx + EllipsoidRotation[n][0] * dy) / e.b;
+        double w = dz / e.c;
+        if (u * u + v * v + w * w <= 1.0) {
+            density += e.intensity;
+            t2 = e.t2;
+        }
+    }
+    if (t2 <= 0.0) {
+        return 0.0;
+    }
+    double te = echo * settings.echoSpacing;
+    return density * std::exp(-te / t2);
+}
+
+void MRSimImageGenerator::renderRows(int frame, int echo, int firstSlice, int sliceCount, char* buffer, int rowBegin, int rowEnd) const {
+    const int width = settings.width;
+    const int height = settings.height;
+    const int slices = settings.slices;
+    // Scale to the range of the type; MR magnitude images rarely exceed a few thousand
+    const double maxValue = (scalarSize == 1) ? ((scalarType == 2) ? 127.0 : 255.0) : 1000.0;
+    const bool alternating = (settings.phantom == "alternating");
+
+    // The type is selected once; the pixel loop is instantiated per type
+    dispatchScalarType(scalarTypeFromIGTL(scalarType), [&](auto traits) {
+        using T = typename decltype(traits)::Type;
+        for (int row = rowBegin; row < rowEnd; row++) {
+            int k = firstSlice + row / height;
+            int j = row % height;
+            double z = (slices > 1) ? -1.0 + (2.0 * k + 1.0) / slices : 0.0;
+            double y = -1.0 + (2.0 * j + 1.0) / height;
+            size_t base = static_cast<size_t>(row) * width;
+            for (int i = 0; i < width; i++) {
+                double value;
+                if (alternating) {
+                    // The pattern of the original test image
+                    value = ((base + i) % 2 == 0) ? 1.0 : 0.2;
+                } else {
+                    double x = -1.0 + (2.0 * i + 1.0) / width;
+                    value = sample(x, y, z, frame, echo);
+                }
+                store<T>(buffer, base + i, value, maxValue);
+            }
+        }
+    });
+}
+
+void MRSimImageGenerator::render() {
+    const int imageSlices = settings.multiSlice ? 1 : settings.slices;
+    const int imagesPerEcho = settings.multiSlice ? settings.slices : 1;
+    const int rows = imageSlices * settings.height;
+    const int imageBytes = settings.width * rows * scalarSize;
+
+    // Allocate the ring first, then fill every image with all cores
+    frames.assign(settings.ringSize, std::vector<Image>());
+    for (int f = 0; f < settings.ringSize; f++) {
+        for (int e = 0; e < settings.echoes; e++) {
+            for (int s = 0; s < imagesPerEcho; s++) {
+                Image image;
+                image.data.resize(imageBytes);
+                image.echo = e;
+                image.slice = s * imageSlices;
+                frames[f].push_back(image);
+            }
+        }
+    }
+
+    // One pass over the rows of all images on the shared pool, so that small
+    // images still keep every core busy and no threads are created here. The
+    // buffers are taken here, as QByteArray::data() may detach.
+    std::vector<std::pair<int, Image*>> images;
+    std::vector<char*> buffers;
+    for (int f = 0; f < settings.ringSize; f++) {
+        for (Image& image : frames[f]) {
+            images.emplace_back(f, &image);
+            buffers.push_back(image.data.data());
+        }
+    }
+    ThreadPool::shared()->parallelFor(static_cast<int>(images.size()) * rows, [&](int begin, int end) {
+        for (int index = begin; index < end;) {
+            const int n = index / rows;
+            const int rowBegin = index % rows;
+            const int rowEnd = std::min(rows, rowBegin + (end - index));
+            const Image& image = *images[n].second;
+            renderRows(images[n].first, image.echo, image.slice, imageSlices, buffers[n], rowBegin, rowEnd);
+            index += rowEnd - rowBegin;
+        }
+    }, 16);
+}
+
+} // namespace mrigtlbridge
@@ -13,22 +13,96 @@
 =========================================================================*/
 
 #include "mrsim_listener.h"
+#include "bridge_metrics.h"
 #include "signal_manager.h"
+#include "thread_pool.h"
 #include <QDebug>
 #include <QThread>
 #include <QTime>
 #include <QCoreApplication>
 #include <QMutexLocker>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
 
 namespace mrigtlbridge {
 
+namespace {
+
+// Scan plane matrix as received from TRANSFORM (4 rows); identity if not set
+void planeMatrix(const QVariantMap& plane, double m[4][4]) {
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            m[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+    QVariantList rows = plane["matrix"].toList();
+    if (rows.size() == 4) {
+        for (int i = 0; i < 4; i++) {
+            QVariantList row = rows[i].toList();
+            for (int j = 0; j < 4 && j < row.size(); j++) {
+                m[i][j] = row[j].toDouble();
+            }
+        }
+    }
+}
+
+} // namespace
+
 MRSimListener::MRSimListener(QObject* parent)
     : ListenerBase(parent),
-      running(false) {
+      running(false),
+      lastPlaneUpdate(0),
+      planeTime(0),
+      frameIndex(0),
+      source(RingSource),
+      interleaved(false),
+      pooledFrames(false),
+      planeBytes(0),
+      trackingEnabled(false),
+      trackingInterval(0.01),
+      trackingSent(0),
+      framesSent(0),
+      frameInterval(0.05) {
     
+    // Initialize parameters
+    parameter["width"] = 256;
+    parameter["height"] = 256;
+    parameter["slices"] = 1;
+    parameter["dtype"] = "uint16";               // See ScalarType in scalar_type.h
+    parameter["fps"] = 20.0;                     // Frames (volumes, or sets of slices) per second
+    parameter["echoes"] = 1;                     // Images per frame with T2 decay
+    parameter["multiSlice"] = 0;                 // 1: send each slice as a separate 2D image
+    parameter["phantom"] = "shepplogan";         // 'shepplogan', 'checker', 'gradient' or 'alternating'
+    parameter["ringSize"] = 4;                   // Number of pre-rendered frames
+    parameter["pixelSpacing"] = 1.0;             // mm
+    parameter["sliceThickness"] = 1.0;           // mm
+    parameter["imageName"] = "TestImage";
+    parameter["source"] = "ring";                // 'ring': cycle through pre-rendered frames
+                                                 // 'reslice': resample a 3D phantom along each scan plane
+                                                 // 'file': replay a raw or NRRD image series
+    parameter["volumeSize"] = 256;               // Reference volume matrix (cubic) for 'reslice'
+    parameter["volumeSpacing"] = 1.0;            // mm
+    parameter["planeMode"] = "simultaneous";     // 'simultaneous' or 'interleaved' acquisition of the planes
+    parameter["bufferPool"] = 1;                 // 1: reslice into buffers from ImageBufferPool
+    parameter["hugePages"] = 0;                  // 1: back pooled buffers of 2 MB and more with huge pages (Linux)
+    parameter["file"] = "";                      // Image series for 'file'
+    parameter["headerBytes"] = 0;                // Bytes to skip at the start of a raw file
+    parameter["replaySpeed"] = 1.0;              // 1: recorded frame rate (or 'fps' if unknown)
+    parameter["trackingCoils"] = 0;              // Number of synthetic tracking coils (0: no tracking)
+    parameter["trackingRate"] = 100.0;           // Hz (up to 1000)
+    parameter["trackingPath"] = "catheter";      // 'catheter', 'circle' or 'lissajous'
+    parameter["trackingAmplitude"] = 20.0;       // mm
+    parameter["trackingPeriod"] = 4.0;           // s
+    parameter["coilSpacing"] = 5.0;              // mm
+
     // Initialize scan planes
-    scanPlanes.resize(3);
+    std::shared_ptr<PlaneState> state = std::make_shared<PlaneState>();
+    state->planes.resize(ScanPlaneCount);
+    planeState = state;
 }
 
 MRSimListener::~MRSimListener() {
@@ -52,95 +126,489 @@ void MRSimListener::disconnectSlots() {
 
 bool MRSimListener::initialize() {
     signalManager->emitSignal("consoleTextMR", "Initializing MR Simulator...");
+
+    MRSimImageGenerator::Settings settings;
+    settings.width = parameter["width"].toInt();
+    settings.height = parameter["height"].toInt();
+    settings.slices = parameter["slices"].toInt();
+    settings.dtype = parameter["dtype"].toString().toStdString();
+    settings.echoes = parameter["echoes"].toInt();
+    settings.multiSlice = parameter["multiSlice"].toInt() == 1;
+    settings.phantom = parameter["phantom"].toString().toStdString();
+    settings.ringSize = parameter["ringSize"].toInt();
+    if (!generator.configure(settings)) {
+        signalManager->emitSignal("consoleTextMR", "ERROR: Invalid simulator settings");
+        return false;
+    }
+
+    double fps = parameter["fps"].toDouble();
+    frameInterval = (fps > 0.0) ? 1.0 / fps : 0.05;
+
+    QString sourceName = parameter["source"].toString();
+    if (sourceName == "reslice") {
+        source = ResliceSource;
+        interleaved = (parameter["planeMode"].toString() == "interleaved");
+        if (!loadReferenceVolume()) {
+            return false;
+        }
+    } else if (sourceName == "file") {
+        source = FileSource;
+        if (!openReplayFile()) {
+            return false;
+        }
+    } else {
+        source = RingSource;
+        // Render everything now so that a running sequence only cycles through buffers
+        QElapsedTimer timer;
+        timer.start();
+        generator.render();
+        buildImageParameters();
+        publishScanPlane(-1, QVariantMap());  // Slice matrices for the final settings
+        signalManager->emitSignal("consoleTextMR", QString("Pre-rendered %1 frames (%2 MB) in %3 ms")
+                                  .arg(generator.getFrameCount())
+                                  .arg(generator.getFrameBytes() * generator.getFrameCount() / (1024.0 * 1024.0), 0, 'f', 1)
+                                  .arg(timer.elapsed()));
+    }
+
+    if (!configureTracking()) {
+        return false;
+    }
+
+    // Poll at twice the frame (or tracking) rate
+    double interval = trackingEnabled ? std::min(frameInterval, trackingInterval) : frameInterval;
+    processTimer->setTimerType(Qt::PreciseTimer);
+    processTimeout = std::max(1, static_cast<int>(interval * 1000.0 / 2));
     return true;
 }
 
-void MRSimListener::process() {
-    // If the simulation is running, generate and send image data
-    if (running) {
-        QMutexLocker locker(&mutex);
-        
-        // Send console message
-        signalManager->emitSignal("consoleTextMR", "Simulating MR acquisition...");
-        
-        try {
-            // Create a small simple test image first to debug IGTL sending
+bool MRSimListener::configureTracking() {
+    trackingEnabled = false;
+    if (parameter["trackingCoils"].toInt() <= 0) {
+        return true;
+    }
+
+    MRSimTrackingGenerator::Settings settings;
+    settings.coils = parameter["trackingCoils"].toInt();
+    settings.path = parameter["trackingPath"].toString().toStdString();
+    settings.amplitude = parameter["trackingAmplitude"].toDouble();
+    settings.period = parameter["trackingPeriod"].toDouble();
+    settings.spacing = parameter["coilSpacing"].toDouble();
+    double rate = parameter["trackingRate"].toDouble();
+    if (rate <= 0.0 || rate > 1000.0 || !tracking.configure(settings)) {
+        signalManager->emitSignal("consoleTextMR", "ERROR: Invalid tracking settings");
+        return false;
+    }
+    trackingInterval = 1.0 / rate;
+    trackingEnabled = true;
+    signalManager->emitSignal("consoleTextMR", QString("Tracking %1 coils (%2) at %3 Hz")
+                              .arg(settings.coils)
+                              .arg(QString::fromStdString(settings.path))
+                              .arg(rate));
+    return true;
+}
+
+bool MRSimListener::loadReferenceVolume() {
+    int size = parameter["volumeSize"].toInt();
+    double spacing = parameter["volumeSpacing"].toDouble();
+    MRSimImageGenerator::Settings volumeSettings;
+    volumeSettings.width = size;
+    volumeSettings.height = size;
+    volumeSettings.slices = size;
+    volumeSettings.dtype = "float32";
+    volumeSettings.phantom = parameter["phantom"].toString().toStdString();
+    volumeSettings.ringSize = 1;
+    MRSimImageGenerator volumeGenerator;
+    if (spacing <= 0.0 || !volumeGenerator.configure(volumeSettings)) {
+        signalManager->emitSignal("consoleTextMR", "ERROR: Invalid reference volume settings");
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    volumeGenerator.render();
+    QByteArray volume = volumeGenerator.getFrame(0)[0].data;
+    float* voxels = reinterpret_cast<float*>(volume.data());
+    if (generator.getScalarSize() == 1) {
+        // Same intensity range as the pre-rendered 8-bit images
+        float scale = (generator.getScalarType() == 2) ? 0.127f : 0.255f;
+        for (int i = 0; i < volume.size() / static_cast<int>(sizeof(float)); i++) {
+            voxels[i] *= scale;
+        }
+    }
+    const double volumeSpacing[3] = {spacing, spacing, spacing};
+    reslicer.setVolume(voxels, size, size, size, volumeSpacing);
+
+    const MRSimImageGenerator::Settings& settings = generator.getSettings();
+    int n = 1; // for checking endianness:
+    int endian = (*(char *)&n == 1) ? 2 : 1; // 2 if little endian
+    QVariantList dimensions;
+    dimensions << settings.width << settings.height << 1;
+    QVariantList spacings;
+    spacings << parameter["pixelSpacing"].toDouble() << parameter["pixelSpacing"].toDouble() << parameter["sliceThickness"].toDouble();
+    QVariantList binaryOffset;
+    binaryOffset.append(0);
+    resliceParameters.clear();
+    resliceParameters["dtype"] = QString::fromStdString(settings.dtype);
+    resliceParameters["dimension"] = dimensions;
+    resliceParameters["spacing"] = spacings;
+    resliceParameters["numberOfComponents"] = 1;
+    resliceParameters["endian"] = endian;
+    resliceParameters["binaryOffset"] = binaryOffset;
+
+    planeBytes = static_cast<size_t>(settings.width) * settings.height * generator.getScalarSize();
+    pooledFrames = (parameter["bufferPool"].toInt() == 1);
+    ImageBufferPool::instance().setHugePages(parameter["hugePages"].toInt() == 1);
+    planeBuffers.clear();
+    if (!pooledFrames) {
+        for (int k = 0; k < ScanPlaneCount; k++) {
+            planeBuffers.append(QByteArray(static_cast<int>(planeBytes), 0));
+        }
+    }
+
+    signalManager->emitSignal("consoleTextMR", QString("Rendered %1^3 reference volume in %2 ms (%3, %4 threads)")
+                              .arg(size)
+                              .arg(timer.elapsed())
+                              .arg(reslicer.isVectorized() ? "AVX2" : "scalar")
+                              .arg(ThreadPool::shared()->getThreadCount()));
+    return true;
+}
+
+bool MRSimListener::openReplayFile() {
+    MRSimFileSource::RawSettings raw;
+    raw.width = parameter["width"].toInt();
+    raw.height = parameter["height"].toInt();
+    raw.slices = parameter["slices"].toInt();
+    raw.dtype = parameter["dtype"].toString();
+    raw.spacing[0] = parameter["pixelSpacing"].toDouble();
+    raw.spacing[1] = parameter["pixelSpacing"].toDouble();
+    raw.spacing[2] = parameter["sliceThickness"].toDouble();
+    raw.headerBytes = parameter["headerBytes"].toLongLong();
+
+    QString path = parameter["file"].toString();
+    QElapsedTimer timer;
+    timer.start();
+    if (!replayFile.open(path, raw)) {
+        signalManager->emitSignal("consoleTextMR", QString("ERROR: %1").arg(replayFile.getError()));
+        return false;
+    }
+
+    // Recorded frame rate if the file has one, scaled by the replay speed
+    double speed = parameter["replaySpeed"].toDouble();
+    if (replayFile.getFrameInterval() > 0.0) {
+        frameInterval = replayFile.getFrameInterval();
+    }
+    if (speed > 0.0) {
+        frameInterval /= speed;
+    }
+
+    const int* dimension = replayFile.getDimensions();
+    const double* spacing = replayFile.getSpacing();
+    double m[4][4];
+    replayFile.getMatrix(m);
+    QVariantList dimensions;
+    dimensions << dimension[0] << dimension[1] << dimension[2];
+    QVariantList spacings;
+    spacings << spacing[0] << spacing[1] << spacing[2];
+    QVariantList matrix;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            matrix.append(m[i][j]);
+        }
+    }
+    QVariantList binaryOffset;
+    binaryOffset.append(0);
+    replayParameters.clear();
+    replayParameters["dtype"] = replayFile.getDtype();
+    replayParameters["dimension"] = dimensions;
+    replayParameters["spacing"] = spacings;
+    replayParameters["name"] = parameter["imageName"].toString();
+    replayParameters["numberOfComponents"] = 1;
+    replayParameters["endian"] = replayFile.getEndian();
+    replayParameters["matrix"] = matrix;
+    replayParameters["binaryOffset"] = binaryOffset;
+    frameIndex = 0;
+
+    qint64 bytes = static_cast<qint64>(replayFile.getFrameCount()) * replayFile.getFrame(0).size();
+    signalManager->emitSignal("consoleTextMR", QString("Mapped %1 frames (%2 MB) of %3 in %4 ms, replay at %5 fps")
+                              .arg(replayFile.getFrameCount())
+                              .arg(bytes / (1024.0 * 1024.0), 0, 'f', 1)
+                              .arg(path)
+                              .arg(timer.elapsed())
+                              .arg(1.0 / frameInterval, 0, 'f', 1));
+    return true;
+}
+
+void MRSimListener::buildImageParameters() {
+    // Everything except the matrix and the timestamp is fixed for the session.
+    // The binary is a QByteArray owned by the generator and shared implicitly.
+    const MRSimImageGenerator::Settings& settings = generator.getSettings();
+    int imageSlices = settings.multiSlice ? 1 : settings.slices;
+    int n = 1; // for checking endianness:
+    int endian = (*(char *)&n == 1) ? 2 : 1; // 2 if little endian
+
+    QVariantList dimensions;
+    dimensions << settings.width << settings.height << imageSlices;
+    QVariantList spacings;
+    spacings << parameter["pixelSpacing"].toDouble() << parameter["pixelSpacing"].toDouble() << parameter["sliceThickness"].toDouble();
+
+    frameParameters.clear();
+    for (int f = 0; f < generator.getFrameCount(); f++) {
+        QVector<QVariantMap> images;
+        for (const MRSimImageGenerator::Image& image : generator.getFrame(f)) {
+            QString name = parameter["imageName"].toString();
+            if (settings.echoes > 1) {
+                name += QString("_E%1").arg(image.echo + 1);
+            }
+            if (settings.multiSlice) {
+                name += QString("_S%1").arg(image.slice + 1);
+            }
+
             QVariantMap imageParam;
-            
-            // Set basic image parameters for a small test image
-            imageParam["dtype"] = "uint16";
-            
-            // Create small 256x256 image for testing
-            QVariantList dimensions;
-            dimensions.append(256);
-            dimensions.append(256);
-            dimensions.append(1);
+            imageParam["dtype"] = QString::fromStdString(settings.dtype);
             imageParam["dimension"] = dimensions;
-            
-            QVariantList spacings;
-            spacings.append(1.0);
-            spacings.append(1.0);
-            spacings.append(1.0);
             imageParam["spacing"] = spacings;
-            
-            imageParam["name"] = "TestImage";
+            imageParam["name"] = name;
             imageParam["numberOfComponents"] = 1;
-            int n = 1; // for checking endianness:
-
-            imageParam["endian"] = (*(char *)&n == 1)? 2 : 1; // 1 if little endian
-
-            // Default identity matrix
-            QVariantList matrix;
-            QVariantList row1, row2, row3, row4;
-            row1 << 1.0 << 0.0 << 0.0 << 0.0;
-            row2 << 0.0 << 1.0 << 0.0 << 0.0;
-            row3 << 0.0 << 0.0 << 1.0 << 0.0;
-            row4 << 0.0 << 0.0 << 0.0 << 1.0;
-            matrix << row1 << row2 << row3 << row4;
-            imageParam["matrix"] = matrix;
-            
-            // Debug matrix structure
-            signalManager->emitSignal("consoleTextMR", QString("Matrix size: %1").arg(matrix.size()));
-            
-            // Create a simple binary image
-            int width = 256;
-            int height = 256;
-            int size = width * height * 2;
-            QByteArray imgData;
-            imgData.resize(size);
-            
-            // Fill with a simple pattern (alternating values)
-            quint16* pixelData = reinterpret_cast<quint16*>(imgData.data());
-            for (int i = 0; i < width * height; i++) {
-                pixelData[i] = (i % 2 == 0) ? 1000 : 200;
+            imageParam["endian"] = endian;
+            QVariantList binary;
+            binary.append(image.data);
+            imageParam["binary"] = binary;
+            QVariantList binaryOffset;
+            binaryOffset.append(0);
+            imageParam["binaryOffset"] = binaryOffset;
+            images.append(imageParam);
+        }
+        frameParameters.append(images);
+    }
+}
+
+QVector<QVariantList> MRSimListener::computeSliceMatrices(const QVariantMap& plane) const {
+    // The image is placed on scan plane 0; in multi-slice mode the slices are
+    // stacked along the plane normal, centered on the plane.
+    double m[4][4];
+    planeMatrix(plane, m);
+
+    const MRSimImageGenerator::Settings& settings = generator.getSettings();
+    int count = settings.multiSlice ? settings.slices : 1;
+    double thickness = parameter["sliceThickness"].toDouble();
+    double norm = std::sqrt(m[0][2] * m[0][2] + m[1][2] * m[1][2] + m[2][2] * m[2][2]);
+    if (norm <= 0.0) {
+        norm = 1.0;
+    }
+
+    QVector<QVariantList> sliceMatrices;
+    for (int k = 0; k < count; k++) {
+        double offset = (count > 1) ? (k - (count - 1) / 2.0) * thickness / norm : 0.0;
+        QVariantList matrix;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                double v = m[i][j];
+                if (j == 3 && i < 3) {
+                    v += offset * m[i][2];
+                }
+                matrix.append(v);
+            }
+        }
+        sliceMatrices.append(matrix);
+    }
+    return sliceMatrices;
+}
+
+void MRSimListener::publishScanPlane(int planeId, const QVariantMap& plane) {
+    // Copy, modify and swap in; retried if another update was published in
+    // between. planeId < 0 only recomputes the slice matrices.
+    std::shared_ptr<const PlaneState> current = std::atomic_load(&planeState);
+    std::shared_ptr<const PlaneState> next;
+    do {
+        std::shared_ptr<PlaneState> state = std::make_shared<PlaneState>(*current);
+        if (planeId >= 0) {
+            state->planes[planeId] = plane;
+            state->updateTime = plane.value("receivedTime", BridgeMetrics::now()).toLongLong();
+        }
+        state->sliceMatrices = computeSliceMatrices(state->planes[0]);
+        next = state;
+    } while (!std::atomic_compare_exchange_weak(&planeState, &current, next));
+}
+
+void MRSimListener::process() {
+    std::shared_ptr<const PlaneState> state = std::atomic_load(&planeState);
+    long due;
+    long trackingDue = 0;
+    {
+        QMutexLocker locker(&mutex);
+        if (!running) {
+            return;
+        }
+
+        // Frames are paced against the sequence start rather than the timer, so
+        // timer jitter does not accumulate. After a stall, skip ahead instead of
+        // sending a burst.
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - sequenceStart).count();
+        bool ready = (source == ResliceSource) ? reslicer.hasVolume()
+                   : (source == FileSource) ? replayFile.getFrameCount() > 0
+                   : !frameParameters.isEmpty();
+        due = ready ? static_cast<long>(elapsed / frameInterval) + 1 : framesSent;
+        if (due - framesSent > 2) {
+            framesSent = due - 1;
+        }
+
+        // Tracking may fall a few samples behind the timer at high rates;
+        // catch up with a short burst, but skip ahead after a longer stall.
+        if (trackingEnabled) {
+            trackingDue = static_cast<long>(elapsed / trackingInterval) + 1;
+            if (trackingDue - trackingSent > 10) {
+                trackingSent = trackingDue - 1;
+            }
+        }
+    }
+
+    // The first frame after a scan plane update carries the time the plane was
+    // received, for the scan-plane-to-image latency
+    if (state->updateTime != lastPlaneUpdate) {
+        lastPlaneUpdate = state->updateTime;
+        planeTime = state->updateTime;
+    }
+
+    try {
+        while (trackingSent < trackingDue) {
+            signalManager->emitSignal("sendTrackingDataIGTL", tracking.sample(trackingSent * trackingInterval));
+            trackingSent++;
+        }
+        while (framesSent < due) {
+            if (source == ResliceSource) {
+                sendReslicedFrame(state->planes);
+            } else if (source == FileSource) {
+                sendReplayFrame();
+            } else {
+                sendFrame(state->sliceMatrices);
             }
-            
-            // Set the binary data
-            //QVariantList binary;
-            //binary.append(imgData);
-            imageParam["binary"] = imgData;
+            framesSent++;
+            planeTime = 0;
+        }
+    }
+    catch (const std::exception& e) {
+        signalManager->emitSignal("consoleTextMR", QString("Error: %1").arg(e.what()));
+    }
+    catch (...) {
+        signalManager->emitSignal("consoleTextMR", "Unknown error occurred");
+    }
+}
+
+void MRSimListener::sendFrame(const QVector<QVariantList>& matrices) {
+    QDateTime timestamp = QDateTime::currentDateTime();
+    const MRSimImageGenerator::Settings& settings = generator.getSettings();
+    const QVector<QVariantMap>& images = frameParameters[frameIndex];
+    for (int i = 0; i < images.size(); i++) {
+        QVariantMap imageParam = images[i];
+        int slice = settings.multiSlice ? generator.getFrame(frameIndex)[i].slice : 0;
+        imageParam["matrix"] = matrices.value(slice);
+        imageParam["timestamp"] = timestamp;
+        if (planeTime > 0) {
+            imageParam["planeTime"] = planeTime;
+        }
+        signalManager->emitSignal("sendImageIGTL", imageParam);
+    }
+    frameIndex = (frameIndex + 1) % frameParameters.size();
+}
+
+void MRSimListener::sendReslicedFrame(const QVector<QVariantMap>& planes) {
+    // One image per scan plane that has received a matrix (plane 0 at the
+    // identity if none has). Plane k > 0 is sent as '<imageName>_P<k>'.
+    QVector<int> active;
+    for (int k = 0; k < planes.size(); k++) {
+        if (planes[k].contains("matrix")) {
+            active.append(k);
+        }
+    }
+    if (active.isEmpty()) {
+        active.append(0);
+    }
+
+    const int count = active.size();
+    const MRSimImageGenerator::Settings& settings = generator.getSettings();
+    double pixelSpacing = parameter["pixelSpacing"].toDouble();
+    QString imageName = parameter["imageName"].toString();
+    std::vector<std::array<std::array<double, 4>, 4>> matrices(count);
+    std::vector<char*> buffers(count);
+    std::vector<PooledBuffer> pooled(count);
+    for (int n = 0; n < count; n++) {
+        double m[4][4];
+        planeMatrix(planes[active[n]], m);
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                matrices[n][i][j] = m[i][j];
+            }
+        }
+        if (pooledFrames) {
+            pooled[n] = ImageBufferPool::instance().acquire(planeBytes);
+            buffers[n] = pooled[n].data();
+        } else {
+            // If the previous image is still referenced by a queued signal, data()
+            // detaches and the reslice goes into a fresh buffer.
+            buffers[n] = planeBuffers[active[n]].data();
+        }
+    }
+
+    // All planes are resliced at once; each plane splits its rows across the
+    // same pool, so a single plane still uses every core.
+    ThreadPool* pool = ThreadPool::shared();
+    pool->parallelFor(count, [&](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            double m[4][4];
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    m[i][j] = matrices[n][i][j];
+                }
+            }
+            reslicer.reslice(m, settings.width, settings.height, pixelSpacing, generator.getScalarType(),
+                             buffers[n], pool);
+        }
+    });
 
-            // Set binary offset
-            imageParam["binaryOffset"] = 0;
-            
-            // Add timestamp
-            imageParam["timestamp"] = QDateTime::currentDateTime();
-            
-            // Debug output
-            signalManager->emitSignal("consoleTextMR", "Sending test image...");
-            
-            // Send the image via OpenIGTLink
-            signalManager->emitSignal("sendImageIGTL", imageParam);
-        } 
-        catch (const std::exception& e) {
-            signalManager->emitSignal("consoleTextMR", QString("Error: %1").arg(e.what()));
+    // 'simultaneous': every plane has the time of the frame. 'interleaved':
+    // the planes share the frame interval and plane n was acquired at the
+    // start of its own slot, so the last plane carries the time of the frame.
+    QDateTime now = QDateTime::currentDateTime();
+    qint64 slotMs = interleaved ? static_cast<qint64>(frameInterval * 1000.0 / count) : 0;
+    for (int n = 0; n < count; n++) {
+        int k = active[n];
+        QVariantList matrix;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                matrix.append(matrices[n][i][j]);
+            }
+        }
+        QVariantList binary;
+        binary.append(pooledFrames ? pooled[n].toByteArray() : planeBuffers[k]);
+
+        QVariantMap imageParam = resliceParameters;
+        imageParam["name"] = (k == 0) ? imageName : QString("%1_P%2").arg(imageName).arg(k);
+        imageParam["binary"] = binary;
+        if (pooledFrames) {
+            // Keeps the block out of the pool while any copy of the parameters exists
+            imageParam["binaryBuffer"] = QVariant::fromValue(pooled[n]);
         }
-        catch (...) {
-            signalManager->emitSignal("consoleTextMR", "Unknown error occurred");
+        imageParam["matrix"] = matrix;
+        imageParam["timestamp"] = now.addMSecs(-slotMs * (count - 1 - n));
+        if (planeTime > 0) {
+            imageParam["planeTime"] = planeTime;
         }
-        
+        signalManager->emitSignal("sendImageIGTL", imageParam);
     }
+}
 
+void MRSimListener::sendReplayFrame() {
+    // The frame refers to the mapping; sendImageIGTL copies it straight from
+    // the page cache into the message.
+    QVariantList binary;
+    binary.append(replayFile.getFrame(frameIndex));
+    QVariantMap imageParam = replayParameters;
+    imageParam["binary"] = binary;
+    // Keeps the mapping while any copy of the parameters exists
+    imageParam["binaryBuffer"] = QVariant::fromValue(replayFile.getMapping());
+    imageParam["timestamp"] = QDateTime::currentDateTime();
+    signalManager->emitSignal("sendImageIGTL", imageParam);
+    frameIndex = (frameIndex + 1) % replayFile.getFrameCount();
 }
 
 void MRSimListener::finalize() {
@@ -150,24 +618,33 @@ void MRSimListener::finalize() {
 void MRSimListener::onStartSequence() {
     QMutexLocker locker(&mutex);
     running = true;
-    signalManager->emitSignal("consoleTextMR", "Sequence started");
+    sequenceStart = std::chrono::steady_clock::now();
+    framesSent = 0;
+    trackingSent = 0;
+    signalManager->emitSignal("consoleTextMR", QString("Sequence started (%1 fps)").arg(1.0 / frameInterval));
 }
 
 void MRSimListener::onStopSequence() {
     QMutexLocker locker(&mutex);
     running = false;
     signalManager->emitSignal("consoleTextMR", "Sequence stopped");
+    if (trackingEnabled) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - sequenceStart).count();
+        signalManager->emitSignal("consoleTextMR", QString("Sent %1 tracking samples in %2 s (%3 Hz, %4 coils)")
+                                  .arg(trackingSent)
+                                  .arg(elapsed, 0, 'f', 1)
+                                  .arg(elapsed > 0.0 ? trackingSent / elapsed : 0.0, 0, 'f', 1)
+                                  .arg(tracking.getCoilCount()));
+    }
     
     // If this was triggered by IGTL disconnect, we should also show it
     signalManager->emitSignal("consoleTextMR", "IGTL connection closed");
 }
 
 void MRSimListener::onUpdateScanPlane(const QVariantMap& param) {
-    QMutexLocker locker(&mutex);
-    
     int planeId = param["plane_id"].toInt();
-    if (planeId >= 0 && planeId < scanPlanes.size()) {
-        scanPlanes[planeId] = param;
+    if (planeId >= 0 && planeId < ScanPlaneCount) {
+        publishScanPlane(planeId, param);
         signalManager->emitSignal("consoleTextMR", QString("Scan plane %1 updated").arg(planeId));
     }
 }
@@ -0,0 +1,115 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "mrsim_tracking_generator.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace mrigtlbridge {
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+enum PathType {
+    CatheterPath,
+    CirclePath,
+    LissajousPath
+};
+
+} // namespace
+
+MRSimTrackingGenerator::MRSimTrackingGenerator()
+    : pathType(CatheterPath) {
+}
+
+bool MRSimTrackingGenerator::configure(const Settings& s) {
+    int type;
+    if (s.path == "catheter") {
+        type = CatheterPath;
+    } else if (s.path == "circle") {
+        type = CirclePath;
+    } else if (s.path == "lissajous") {
+        type = LissajousPath;
+    } else {
+        qWarning() << "MRSimTrackingGenerator::configure(): Invalid path" << s.path.c_str();
+        return false;
+    }
+    if (s.coils < 1 || s.coils > MaxCoils || s.period <= 0.0) {
+        qWarning() << "MRSimTrackingGenerator::configure(): Invalid coil count or period";
+        return false;
+    }
+
+    settings = s;
+    pathType = type;
+    names.clear();
+    for (int i = 0; i < s.coils; i++) {
+        names.append(QString("coil%1").arg(i));
+    }
+    return true;
+}
+
+void MRSimTrackingGenerator::position(int index, double t, double p[3]) const {
+    const double a = settings.amplitude;
+    const double phase = 2.0 * PI * t / settings.period;
+
+    switch (pathType) {
+    case CirclePath: {
+        double angle = phase + 2.0 * PI * index / names.size();
+        p[0] = a * std::cos(angle);
+        p[1] = a * std::sin(angle);
+        p[2] = settings.spacing * (index - (names.size() - 1) / 2.0);
+        break;
+    }
+    case LissajousPath: {
+        double offset = 2.0 * PI * index / names.size();
+        p[0] = a * std::sin(3.0 * phase + offset);
+        p[1] = a * std::sin(2.0 * phase + offset);
+        p[2] = 0.5 * a * std::sin(phase + offset);
+        break;
+    }
+    default: {
+        // Arc length of the element from the entry point (z = -length): the
+        // tip moves by 'amplitude' over a period. The catheter bends in x
+        // with a constant radius, and everything moves in y with breathing.
+        double length = settings.spacing * (names.size() - 1);
+        double s = length + 0.5 * a * (1.0 - std::cos(phase)) - settings.spacing * index;
+        double radius = 5.0 * std::max(a, 1.0);
+        p[0] = radius * (1.0 - std::cos(s / radius));
+        p[1] = 0.1 * a * std::sin(2.0 * phase);
+        p[2] = radius * std::sin(s / radius) - length;
+        break;
+    }
+    }
+}
+
+QVariantMap MRSimTrackingGenerator::sample(double t) const {
+    QVariantList coils;
+    for (int i = 0; i < names.size(); i++) {
+        double p[3];
+        position(i, t, p);
+        QVariantList values;
+        values << p[0] << p[1] << p[2];
+        QVariantMap coil;
+        coil["id"] = names[i];
+        coil["position"] = values;
+        coils.append(coil);
+    }
+    QVariantMap param;
+    param["coils"] = coils;
+    return param;
+}
+
+} // namespace mrigtlbridge
@@ -89,8 +89,7 @@ void MRSimWidget::buildGUI(QWidget* parent) {
     layout->addWidget(consoleGroupBox);
     
     QVBoxLayout* consoleLayout = new QVBoxLayout(consoleGroupBox);
-    mrSimConsole = new QTextEdit(parent);
-    mrSimConsole->setReadOnly(true);
+    mrSimConsole = createConsole(parent);
     consoleLayout->addWidget(mrSimConsole);
     
     // Connect signals and slots
@@ -184,7 +183,7 @@ void MRSimWidget::onStopSequenceClicked() {
 
 void MRSimWidget::onConsoleTextReceived(const QString& text) {
     QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss");
-    mrSimConsole->append(QString("[%1] %2").arg(timestamp, text));
+    addConsoleMessage(mrSimConsole, QString("[%1] %2").arg(timestamp, text));
 }
 
 } // namespace mrigtlbridge
@@ -0,0 +1,119 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "performance_panel.h"
+#include "image_buffer_pool.h"
+#include <QGridLayout>
+
+namespace mrigtlbridge {
+
+PerformancePanel::PerformancePanel(QWidget* parent)
+    : QGroupBox("Performance", parent),
+      timer(new QTimer(this)) {
+    QGridLayout* layout = new QGridLayout(this);
+    setLayout(layout);
+    imageLabel = addRow("Images:");
+    trackingLabel = addRow("Tracking:");
+    transformLabel = addRow("Transforms received:");
+    queueLabel = addRow("Client queues:");
+    sendTimeLabel = addRow("Image send time:");
+    latencyLabel = addRow("Scan plane to image:");
+    poolLabel = addRow("Buffer pool:");
+    deltaLabel = addRow("Delta updates:");
+    compressionLabel = addRow("Compression:");
+
+    history.append(BridgeMetrics::instance().snapshot());
+    connect(timer, &QTimer::timeout, this, &PerformancePanel::sample);
+    timer->start(1000);
+}
+
+void PerformancePanel::setInterval(int msec) {
+    timer->setInterval(msec);
+}
+
+QLabel* PerformancePanel::addRow(const QString& name) {
+    QGridLayout* grid = static_cast<QGridLayout*>(layout());
+    int row = grid->count() / 2;  // Two labels per row
+    grid->addWidget(new QLabel(name, this), row, 0);
+    QLabel* value = new QLabel("-", this);
+    grid->addWidget(value, row, 1);
+    return value;
+}
+
+void PerformancePanel::sample() {
+    const BridgeMetrics::Snapshot now = BridgeMetrics::instance().snapshot();
+    const BridgeMetrics::Snapshot& last = history.last();
+    const BridgeMetrics::Snapshot& first = history.first();
+    double seconds = (now.time - last.time) / 1.0e9;
+    if (seconds <= 0.0) {
+        return;
+    }
+
+    auto rate = [seconds](quint64 a, quint64 b) { return (a - b) / seconds; };
+    auto percentiles = [](const quint64* a, const quint64* b) {
+        double p50 = BridgeMetrics::Histogram::percentile(a, b, 0.50);
+        double p99 = BridgeMetrics::Histogram::percentile(a, b, 0.99);
+        if (p50 == 0.0 && p99 == 0.0) {
+            return QString("-");
+        }
+        return QString("p50 %1 ms, p99 %2 ms").arg(p50, 0, 'f', 2).arg(p99, 0, 'f', 2);
+    };
+
+    imageLabel->setText(QString("%1 /s, %2 MB/s")
+        .arg(rate(now.imagesSent, last.imagesSent), 0, 'f', 1)
+        .arg(rate(now.imageBytesSent, last.imageBytesSent) / (1024.0 * 1024.0), 0, 'f', 2));
+    trackingLabel->setText(QString("%1 /s").arg(rate(now.trackingSent, last.trackingSent), 0, 'f', 1));
+    transformLabel->setText(QString("%1 /s").arg(rate(now.transformsReceived, last.transformsReceived), 0, 'f', 1));
+    queueLabel->setText(QString("%1 queued, %2 dropped /s")
+        .arg(now.queuedMessages)
+        .arg(rate(now.messagesDropped, last.messagesDropped), 0, 'f', 1));
+    // Send times over the last interval; the latency has one sample per plane
+    // update, so it is taken over the whole history
+    sendTimeLabel->setText(percentiles(now.sendTime, last.sendTime));
+    latencyLabel->setText(percentiles(now.planeLatency, first.planeLatency));
+
+    const ImageBufferPool::Statistics pool = ImageBufferPool::instance().getStatistics();
+    const quint64 requests = pool.hits + pool.misses;
+    if (requests > 0) {
+        poolLabel->setText(QString("%1% hits, %2 MB (high water %3 MB)")
+            .arg(100.0 * pool.hits / requests, 0, 'f', 1)
+            .arg(pool.bytes / (1024.0 * 1024.0), 0, 'f', 1)
+            .arg(pool.highWaterBytes / (1024.0 * 1024.0), 0, 'f', 1));
+    }
+
+    const quint64 deltaImages = (now.deltaFrames - last.deltaFrames) + (now.deltaKeyframes - last.deltaKeyframes);
+    if (deltaImages > 0) {
+        deltaLabel->setText(QString("%1 MB/s saved, %2 keyframes /s, diff %3")
+            .arg(rate(now.deltaBytesSaved, last.deltaBytesSaved) / (1024.0 * 1024.0), 0, 'f', 2)
+            .arg(rate(now.deltaKeyframes, last.deltaKeyframes), 0, 'f', 1)
+            .arg(percentiles(now.diffTime, last.diffTime)));
+    }
+
+    const quint64 compressOut = now.compressOutBytes - last.compressOutBytes;
+    if (compressOut > 0) {
+        // Images that did not get smaller count as sent uncompressed
+        compressionLabel->setText(QString("ratio %1, %2 MB/s to %3 MB/s, encode %4")
+            .arg(static_cast<double>(now.compressInBytes - last.compressInBytes) / compressOut, 0, 'f', 2)
+            .arg(rate(now.compressInBytes, last.compressInBytes) / (1024.0 * 1024.0), 0, 'f', 2)
+            .arg(rate(now.compressOutBytes, last.compressOutBytes) / (1024.0 * 1024.0), 0, 'f', 2)
+            .arg(percentiles(now.compressTime, last.compressTime)));
+    }
+
+    history.append(now);
+    if (history.size() > HistoryLength) {
+        history.removeFirst();
+    }
+}
+
+} // namespace mrigtlbridge
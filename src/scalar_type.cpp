@@ -0,0 +1,44 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "scalar_type.h"
+#include <QLatin1String>
+
+namespace mrigtlbridge {
+
+const char* scalarTypeName(ScalarType type) {
+    const char* name = "";
+    dispatchScalarType(type, [&name](auto traits) { name = decltype(traits)::name; });
+    return name;
+}
+
+ScalarType scalarTypeFromName(const QString& name) {
+    for (ScalarType type : AllScalarTypes) {
+        if (name == QLatin1String(scalarTypeName(type))) {
+            return type;
+        }
+    }
+    return ScalarType::Invalid;
+}
+
+ScalarType scalarTypeFromName(const std::string& name) {
+    for (ScalarType type : AllScalarTypes) {
+        if (name == scalarTypeName(type)) {
+            return type;
+        }
+    }
+    return ScalarType::Invalid;
+}
+
+} // namespace mrigtlbridge
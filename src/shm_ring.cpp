@@ -0,0 +1,373 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "shm_ring.h"
+#include <QDebug>
+
+#ifdef MRIGTL_WITH_SHM_TRANSPORT
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+namespace mrigtlbridge {
+
+static const uint32_t RING_MAGIC = 0x4d52474c; // 'MRGL'
+static const uint32_t RING_VERSION = 1;
+static const size_t DATA_OFFSET = 4096;         // Ring data starts on its own page
+static const uint32_t RECORD_PAD = 1;           // Filler up to the end of the ring
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "futex words must be lock-free");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be lock-free");
+
+struct SharedMemoryRing::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    int32_t creatorPid;  // Process that created (and writes or reads) the ring
+
+    // Monotonic byte positions; the producer owns 'head', the consumer 'tail'
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+
+    // Futex words bumped on every commit/release
+    alignas(64) std::atomic<uint32_t> dataSeq;
+    std::atomic<uint32_t> spaceSeq;
+    std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+};
+
+struct RecordHeader {
+    uint32_t size;   // Payload size (without this header and padding)
+    uint32_t flags;
+};
+
+static inline uint64_t recordSize(size_t payload) {
+    return (sizeof(RecordHeader) + payload + 7) & ~static_cast<uint64_t>(7);
+}
+
+static int remainingMs(const std::chrono::steady_clock::time_point& deadline) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+SharedMemoryRing::SharedMemoryRing()
+    : header(nullptr),
+      data(nullptr),
+      mappedSize(0),
+      pendingRelease(0),
+      owner(false) {
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    close();
+}
+
+bool SharedMemoryRing::create(const std::string& name, size_t capacity) {
+    close();
+
+    size_t cap = 4096;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    int error = errno;
+    if (fd < 0 && error == EEXIST && isStale(name)) {
+        // Left behind by a run that did not exit cleanly
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        error = errno;
+    }
+    if (fd < 0) {
+        if (error == EEXIST) {
+            qWarning() << "SharedMemoryRing::create():" << name.c_str() << "is in use by another running instance";
+        } else {
+            qWarning() << "SharedMemoryRing::create(): shm_open failed for" << name.c_str() << ":" << strerror(error);
+        }
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(DATA_OFFSET + cap)) != 0) {
+        qWarning() << "SharedMemoryRing::create(): Could not size the segment:" << strerror(errno);
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    if (!map(fd, DATA_OFFSET + cap)) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header = new (header) Header();
+    header->capacity = cap;
+    header->creatorPid = static_cast<int32_t>(getpid());
+    header->head = 0;
+    header->tail = 0;
+    header->dataSeq = 0;
+    header->spaceSeq = 0;
+    header->readerWaiting = 0;
+    header->writerWaiting = 0;
+    header->version = RING_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = RING_MAGIC;
+
+    shmName = name;
+    owner = true;
+    return true;
+}
+
+bool SharedMemoryRing::isStale(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+    if (fd < 0) {
+        return errno == ENOENT;  // Gone in the meantime
+    }
+    struct stat st;
+    bool stale = false;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+        void* addr = mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+            const Header* existing = static_cast<const Header*>(addr);
+            // A ring of another version cannot be in use by this build; otherwise
+            // only a ring whose creator has exited is taken over
+            stale = existing->magic != RING_MAGIC || existing->version != RING_VERSION ||
+                    (kill(existing->creatorPid, 0) != 0 && errno == ESRCH);
+            munmap(addr, sizeof(Header));
+        }
+    }
+    ::close(fd);
+    return stale;
+}
+
+bool SharedMemoryRing::open(const std::string& name) {
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= DATA_OFFSET) {
+        ::close(fd);
+        return false;
+    }
+    if (!map(fd, static_cast<size_t>(st.st_size))) {
+        return false;
+    }
+    if (header->magic != RING_MAGIC || header->version != RING_VERSION ||
+        DATA_OFFSET + header->capacity != mappedSize) {
+        qWarning() << "SharedMemoryRing::open(): " << name.c_str() << "is not a compatible ring";
+        close();
+        return false;
+    }
+
+    shmName = name;
+    owner = false;
+    return true;
+}
+
+bool SharedMemoryRing::map(int fd, size_t totalSize) {
+    void* addr = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        qWarning() << "SharedMemoryRing: mmap failed:" << strerror(errno);
+        return false;
+    }
+    header = static_cast<Header*>(addr);
+    data = static_cast<unsigned char*>(addr) + DATA_OFFSET;
+    mappedSize = totalSize;
+    return true;
+}
+
+void SharedMemoryRing::close() {
+    if (header) {
+        munmap(header, mappedSize);
+        header = nullptr;
+        data = nullptr;
+        mappedSize = 0;
+    }
+    if (owner) {
+        shm_unlink(shmName.c_str());
+        owner = false;
+    }
+    pendingRelease = 0;
+}
+
+size_t SharedMemoryRing::getCapacity() const {
+    return header ? static_cast<size_t>(header->capacity) : 0;
+}
+
+size_t SharedMemoryRing::getUsed() const {
+    return header ? static_cast<size_t>(header->head.load() - header->tail.load()) : 0;
+}
+
+bool SharedMemoryRing::write(const void* src, size_t size, int timeoutMs) {
+    if (!header || size > getMaxMessageSize()) {
+        return false;
+    }
+
+    const uint64_t cap = header->capacity;
+    const uint64_t need = recordSize(size);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+
+    for (;;) {
+        uint64_t head = header->head.load(std::memory_order_relaxed);
+        uint64_t offset = head & (cap - 1);
+        uint64_t contiguous = cap - offset;
+        // A record never wraps; if it does not fit before the end, pad to the end first
+        uint64_t total = need + (contiguous < need ? contiguous : 0);
+
+        uint32_t seq = header->spaceSeq.load();
+        uint64_t tail = header->tail.load(std::memory_order_acquire);
+        if (cap - (head - tail) >= total) {
+            if (contiguous < need) {
+                RecordHeader* pad = reinterpret_cast<RecordHeader*>(data + offset);
+                pad->size = static_cast<uint32_t>(contiguous - sizeof(RecordHeader));
+                pad->flags = RECORD_PAD;
+                head += contiguous;
+                offset = 0;
+            }
+            RecordHeader* rec = reinterpret_cast<RecordHeader*>(data + offset);
+            rec->size = static_cast<uint32_t>(size);
+            rec->flags = 0;
+            std::memcpy(rec + 1, src, size);
+
+            header->head.store(head + need, std::memory_order_release);
+            header->dataSeq.fetch_add(1);
+            if (header->readerWaiting.load()) {
+                futexWake(&header->dataSeq);
+            }
+            return true;
+        }
+
+        if (timeoutMs == 0) {
+            return false;
+        }
+        int wait = timeoutMs < 0 ? -1 : remainingMs(deadline);
+        if (wait == 0) {
+            return false;
+        }
+        header->writerWaiting.store(1);
+        futexWait(&header->spaceSeq, seq, wait);
+        header->writerWaiting.store(0);
+    }
+}
+
+const void* SharedMemoryRing::peek(size_t& size, int timeoutMs) {
+    if (!header) {
+        return nullptr;
+    }
+
+    const uint64_t cap = header->capacity;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+
+    for (;;) {
+        uint32_t seq = header->dataSeq.load();
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        uint64_t head = header->head.load(std::memory_order_acquire);
+
+        if (head != tail) {
+            RecordHeader* rec = reinterpret_cast<RecordHeader*>(data + (tail & (cap - 1)));
+            if (rec->flags & RECORD_PAD) {
+                pendingRelease = sizeof(RecordHeader) + rec->size;
+                release();
+                continue;
+            }
+            size = rec->size;
+            pendingRelease = recordSize(rec->size);
+            return rec + 1;
+        }
+
+        if (timeoutMs == 0) {
+            return nullptr;
+        }
+        int wait = timeoutMs < 0 ? -1 : remainingMs(deadline);
+        if (wait == 0) {
+            return nullptr;
+        }
+        header->readerWaiting.store(1);
+        futexWait(&header->dataSeq, seq, wait);
+        header->readerWaiting.store(0);
+    }
+}
+
+void SharedMemoryRing::release() {
+    if (!header || pendingRelease == 0) {
+        return;
+    }
+    header->tail.store(header->tail.load(std::memory_order_relaxed) + pendingRelease, std::memory_order_release);
+    pendingRelease = 0;
+    header->spaceSeq.fetch_add(1);
+    if (header->writerWaiting.load()) {
+        futexWake(&header->spaceSeq);
+    }
+}
+
+bool SharedMemoryRing::futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs) {
+    // Not FUTEX_PRIVATE: the word is shared with another process
+    struct timespec ts;
+    struct timespec* tsp = nullptr;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        tsp = &ts;
+    }
+    long r = syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, tsp, nullptr, 0);
+    return r == 0 || errno == EAGAIN || errno == EINTR;
+}
+
+void SharedMemoryRing::futexWake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+} // namespace mrigtlbridge
+
+#else // MRIGTL_WITH_SHM_TRANSPORT
+
+// Shared memory transport requires Linux (futex). The ring can be constructed
+// but never opened on other platforms.
+namespace mrigtlbridge {
+
+struct SharedMemoryRing::Header {
+    uint64_t capacity;
+};
+
+SharedMemoryRing::SharedMemoryRing() : header(nullptr), data(nullptr), mappedSize(0), pendingRelease(0), owner(false) {}
+SharedMemoryRing::~SharedMemoryRing() {}
+
+bool SharedMemoryRing::create(const std::string& name, size_t capacity) {
+    qWarning() << "SharedMemoryRing::create(): Not supported on this platform" << name.c_str() << capacity;
+    return false;
+}
+
+bool SharedMemoryRing::isStale(const std::string&) { return false; }
+bool SharedMemoryRing::open(const std::string&) { return false; }
+void SharedMemoryRing::close() {}
+size_t SharedMemoryRing::getCapacity() const { return 0; }
+size_t SharedMemoryRing::getUsed() const { return 0; }
+bool SharedMemoryRing::write(const void*, size_t, int) { return false; }
+const void* SharedMemoryRing::peek(size_t&, int) { return nullptr; }
+void SharedMemoryRing::release() {}
+
+} // namespace mrigtlbridge
+
+#endif // MRIGTL_WITH_SHM_TRANSPORT
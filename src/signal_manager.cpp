@@ -163,6 +163,11 @@ void SignalManagerProxy::emitSignal(const QString& name, const QVariant& param)
     queueCondition.notify_one();
 }
 
+size_t SignalManagerProxy::getQueueSize() {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return signalQueue.size();
+}
+
 void SignalManagerProxy::run() {
     while (!stopRequested) {
         SignalData data;
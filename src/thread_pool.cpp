@@ -0,0 +1,137 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace mrigtlbridge {
+
+ThreadPool::ThreadPool(int threads)
+    : stopping(false) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::run, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool* ThreadPool::shared() {
+    static ThreadPool pool;
+    return &pool;
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task) {
+    auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+    std::future<void> result = packaged->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back([packaged]() { (*packaged)(); });
+    }
+    condition.notify_one();
+    return result;
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& fn, int grain) {
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(1, grain);
+    int chunkCount = std::min((count + grain - 1) / grain, getThreadCount() * 4);
+    if (chunkCount <= 1) {
+        fn(0, count);
+        return;
+    }
+    int chunkSize = (count + chunkCount - 1) / chunkCount;
+    chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    // Shared with the helpers, which may start after this call has returned;
+    // 'fn' is only touched by whoever claims a chunk, which the caller waits for.
+    struct Job {
+        const std::function<void(int, int)>* fn;
+        int count;
+        int chunkSize;
+        int chunkCount;
+        std::atomic<int> next;
+        std::atomic<int> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->count = count;
+    job->chunkSize = chunkSize;
+    job->chunkCount = chunkCount;
+    job->next = 0;
+    job->done = 0;
+
+    auto work = [job]() {
+        for (;;) {
+            int chunk = job->next.fetch_add(1);
+            if (chunk >= job->chunkCount) {
+                return;
+            }
+            int begin = chunk * job->chunkSize;
+            (*job->fn)(begin, std::min(job->count, begin + job->chunkSize));
+            if (job->done.fetch_add(1) + 1 == job->chunkCount) {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished.notify_all();
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int helpers = std::min(getThreadCount(), chunkCount - 1);
+        for (int i = 0; i < helpers; i++) {
+            tasks.emplace_back(work);
+        }
+    }
+    condition.notify_all();
+
+    work();
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->done == job->chunkCount; });
+}
+
+void ThreadPool::run() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+} // namespace mrigtlbridge
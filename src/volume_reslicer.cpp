@@ -0,0 +1,216 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+#include "volume_reslicer.h"
+#include "scalar_kernels.h"
+#include "thread_pool.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MRIGTL_RESLICE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace mrigtlbridge {
+
+VolumeReslicer::VolumeReslicer()
+    : dim{0, 0, 0},
+      spacing{1.0, 1.0, 1.0},
+      vectorized(hasAVX2()) {
+}
+
+bool VolumeReslicer::hasAVX2() {
+#ifdef MRIGTL_RESLICE_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void VolumeReslicer::setVolume(const float* data, int nx, int ny, int nz, const double s[3]) {
+    volume.assign(data, data + static_cast<size_t>(nx) * ny * nz);
+    dim[0] = nx;
+    dim[1] = ny;
+    dim[2] = nz;
+    for (int i = 0; i < 3; i++) {
+        spacing[i] = s[i];
+    }
+}
+
+void VolumeReslicer::reslice(const double matrix[4][4], int width, int height, double pixelSpacing,
+                             int scalarType, void* output, ThreadPool* pool) const {
+    // Voxel position of pixel (i, j): origin + i * stepX + j * stepY, where the
+    // physical position is converted with index = p / spacing + (n - 1) / 2.
+    double origin[3];
+    double stepX[3];
+    double stepY[3];
+    for (int a = 0; a < 3; a++) {
+        stepX[a] = matrix[a][0] * pixelSpacing / spacing[a];
+        stepY[a] = matrix[a][1] * pixelSpacing / spacing[a];
+        origin[a] = matrix[a][3] / spacing[a] + (dim[a] - 1) / 2.0
+                    - stepX[a] * (width - 1) / 2.0 - stepY[a] * (height - 1) / 2.0;
+    }
+
+    const ScalarType type = scalarTypeFromIGTL(scalarType);
+    auto rows = [&](int begin, int end) {
+        std::vector<float> row(width);
+        for (int j = begin; j < end; j++) {
+            float start[3];
+            float step[3];
+            for (int a = 0; a < 3; a++) {
+                start[a] = static_cast<float>(origin[a] + stepY[a] * j);
+                step[a] = static_cast<float>(stepX[a]);
+            }
+            if (vectorized) {
+                sampleRowAVX2(start, step, width, row.data());
+            } else {
+                sampleRow(start, step, width, row.data());
+            }
+
+            size_t offset = static_cast<size_t>(j) * width;
+            dispatchScalarType(type, [&](auto traits) {
+                using T = typename decltype(traits)::Type;
+                convertFromFloat<T>(row.data(), width, static_cast<T*>(output) + offset);
+            });
+        }
+    };
+
+    if (volume.empty()) {
+        return;
+    }
+    if (pool) {
+        pool->parallelFor(height, rows, 8);
+    } else {
+        rows(0, height);
+    }
+}
+
+void VolumeReslicer::sampleRow(const float start[3], const float step[3], int count, float* out) const {
+    const int nx = dim[0];
+    const int ny = dim[1];
+    const int nz = dim[2];
+    const size_t sliceSize = static_cast<size_t>(nx) * ny;
+    const float* v = volume.data();
+
+    for (int i = 0; i < count; i++) {
+        float x = start[0] + step[0] * i;
+        float y = start[1] + step[1] * i;
+        float z = start[2] + step[2] * i;
+        if (!(x >= 0.0f && y >= 0.0f && z >= 0.0f && x < nx - 1 && y < ny - 1 && z < nz - 1)) {
+            out[i] = 0.0f;
+            continue;
+        }
+        int ix = static_cast<int>(x);
+        int iy = static_cast<int>(y);
+        int iz = static_cast<int>(z);
+        float fx = x - ix;
+        float fy = y - iy;
+        float fz = z - iz;
+        const float* p = v + ix + static_cast<size_t>(iy) * nx + iz * sliceSize;
+        float c00 = p[0] + fx * (p[1] - p[0]);
+        float c10 = p[nx] + fx * (p[nx + 1] - p[nx]);
+        float c01 = p[sliceSize] + fx * (p[sliceSize + 1] - p[sliceSize]);
+        float c11 = p[sliceSize + nx] + fx * (p[sliceSize + nx + 1] - p[sliceSize + nx]);
+        float c0 = c00 + fy * (c10 - c00);
+        float c1 = c01 + fy * (c11 - c01);
+        out[i] = c0 + fz * (c1 - c0);
+    }
+}
+
+#ifdef MRIGTL_RESLICE_AVX2
+
+__attribute__((target("avx2,fma")))
+static inline __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+    return _mm256_fmadd_ps(t, _mm256_sub_ps(b, a), a);
+}
+
+__attribute__((target("avx2,fma")))
+void VolumeReslicer::sampleRowAVX2(const float start[3], const float step[3], int count, float* out) const {
+    const int nx = dim[0];
+    const int ny = dim[1];
+    const int nz = dim[2];
+    const float* v = volume.data();
+
+    const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 maxX = _mm256_set1_ps(static_cast<float>(nx - 1));
+    const __m256 maxY = _mm256_set1_ps(static_cast<float>(ny - 1));
+    const __m256 maxZ = _mm256_set1_ps(static_cast<float>(nz - 1));
+    const __m256i strideY = _mm256_set1_epi32(nx);
+    const __m256i strideZ = _mm256_set1_epi32(nx * ny);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 n = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), lane);
+        __m256 x = _mm256_fmadd_ps(n, _mm256_set1_ps(step[0]), _mm256_set1_ps(start[0]));
+        __m256 y = _mm256_fmadd_ps(n, _mm256_set1_ps(step[1]), _mm256_set1_ps(start[1]));
+        __m256 z = _mm256_fmadd_ps(n, _mm256_set1_ps(step[2]), _mm256_set1_ps(start[2]));
+
+        __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GE_OQ), _mm256_cmp_ps(x, maxX, _CMP_LT_OQ)),
+                          _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_GE_OQ), _mm256_cmp_ps(y, maxY, _CMP_LT_OQ))),
+            _mm256_and_ps(_mm256_cmp_ps(z, zero, _CMP_GE_OQ), _mm256_cmp_ps(z, maxZ, _CMP_LT_OQ)));
+        if (_mm256_movemask_ps(inside) == 0) {
+            _mm256_storeu_ps(out + i, zero);
+            continue;
+        }
+        // Keep lanes outside the volume at index 0 so that the gathers stay in bounds
+        x = _mm256_and_ps(x, inside);
+        y = _mm256_and_ps(y, inside);
+        z = _mm256_and_ps(z, inside);
+
+        __m256 flx = _mm256_floor_ps(x);
+        __m256 fly = _mm256_floor_ps(y);
+        __m256 flz = _mm256_floor_ps(z);
+        __m256 fx = _mm256_sub_ps(x, flx);
+        __m256 fy = _mm256_sub_ps(y, fly);
+        __m256 fz = _mm256_sub_ps(z, flz);
+
+        __m256i base = _mm256_add_epi32(_mm256_cvttps_epi32(flx),
+                       _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(fly), strideY),
+                                        _mm256_mullo_epi32(_mm256_cvttps_epi32(flz), strideZ)));
+        __m256i baseY = _mm256_add_epi32(base, strideY);
+        __m256i baseZ = _mm256_add_epi32(base, strideZ);
+        __m256i baseYZ = _mm256_add_epi32(baseY, strideZ);
+
+        __m256 p000 = _mm256_i32gather_ps(v, base, 4);
+        __m256 p100 = _mm256_i32gather_ps(v, _mm256_add_epi32(base, one), 4);
+        __m256 p010 = _mm256_i32gather_ps(v, baseY, 4);
+        __m256 p110 = _mm256_i32gather_ps(v, _mm256_add_epi32(baseY, one), 4);
+        __m256 p001 = _mm256_i32gather_ps(v, baseZ, 4);
+        __m256 p101 = _mm256_i32gather_ps(v, _mm256_add_epi32(baseZ, one), 4);
+        __m256 p011 = _mm256_i32gather_ps(v, baseYZ, 4);
+        __m256 p111 = _mm256_i32gather_ps(v, _mm256_add_epi32(baseYZ, one), 4);
+
+        __m256 c0 = lerp8(lerp8(p000, p100, fx), lerp8(p010, p110, fx), fy);
+        __m256 c1 = lerp8(lerp8(p001, p101, fx), lerp8(p011, p111, fx), fy);
+        _mm256_storeu_ps(out + i, _mm256_and_ps(lerp8(c0, c1, fz), inside));
+    }
+
+    if (i < count) {
+        float tail[3] = {start[0] + step[0] * i, start[1] + step[1] * i, start[2] + step[2] * i};
+        sampleRow(tail, step, count - i, out + i);
+    }
+}
+
+#else
+
+void VolumeReslicer::sampleRowAVX2(const float start[3], const float step[3], int count, float* out) const {
+    sampleRow(start, step, count, out);
+}
+
+#endif
+
+} // namespace mrigtlbridge
@@ -16,8 +16,10 @@
 #include "signal_manager.h"
 #include "listener_base.h"
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QMessageBox>
 #include <QThread>
+#include <algorithm>
 
 namespace mrigtlbridge {
 
@@ -154,7 +156,17 @@ void WidgetBase::onListenerTerminated(const QString& className) {
     }
 }
 
-void WidgetBase::addConsoleMessage(QTextEdit* console, const QString& message) {
+QPlainTextEdit* WidgetBase::createConsole(QWidget* parent) {
+    // Plain text and a bounded document keep the cost of an insert independent
+    // of how long the application has been running
+    QPlainTextEdit* console = new QPlainTextEdit(parent);
+    console->setReadOnly(true);
+    console->setUndoRedoEnabled(false);
+    console->setMaximumBlockCount(MAX_CONSOLE_LINES);
+    return console;
+}
+
+void WidgetBase::addConsoleMessage(QPlainTextEdit* console, const QString& message) {
     // Thread-safe: Add message to buffer instead of directly updating GUI
     QMutexLocker locker(&consoleBufferMutex);
     
@@ -164,21 +176,43 @@ void WidgetBase::addConsoleMessage(QTextEdit* console, const QString& message) {
     // Implement circular buffer behavior - remove oldest messages if buffer is full
     while (consoleBuffer.size() >= MAX_CONSOLE_BUFFER_SIZE) {
         consoleBuffer.dequeue();
+        consoleStatistics.dropped++;
     }
     
     consoleBuffer.enqueue(message);
 }
 
 void WidgetBase::flushConsoleBuffer() {
-    // This runs on the main thread via timer, safe to update GUI
-    QMutexLocker locker(&consoleBufferMutex);
-    
-    if (targetConsole) {
-        while (!consoleBuffer.isEmpty()) {
-            QString message = consoleBuffer.dequeue();
-            targetConsole->append(message);
-        }
+    // This runs on the main thread via timer, safe to update GUI. The buffer is
+    // taken as a whole so that the listeners are not held up by the insert.
+    QQueue<QString> messages;
+    QPlainTextEdit* console;
+    {
+        QMutexLocker locker(&consoleBufferMutex);
+        messages.swap(consoleBuffer);
+        console = targetConsole;
+    }
+    if (!console || messages.isEmpty()) {
+        return;
     }
+
+    // One insert (and one layout) per flush instead of one per message
+    QElapsedTimer timer;
+    timer.start();
+    console->appendPlainText(QStringList(messages).join('\n'));
+    double ms = timer.nsecsElapsed() / 1.0e6;
+
+    QMutexLocker locker(&consoleBufferMutex);
+    consoleStatistics.flushes++;
+    consoleStatistics.lines += messages.size();
+    consoleStatistics.lastMs = ms;
+    consoleStatistics.maxMs = std::max(consoleStatistics.maxMs, ms);
+    consoleStatistics.totalMs += ms;
+}
+
+WidgetBase::ConsoleStatistics WidgetBase::getConsoleStatistics() {
+    QMutexLocker locker(&consoleBufferMutex);
+    return consoleStatistics;
 }
 
 } // namespace mrigtlbridge
\ No newline at end of file
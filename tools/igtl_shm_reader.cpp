@@ -0,0 +1,106 @@
+/*=========================================================================
+
+  Program:   mrigtlbridge
+  Language:  C++
+  Web page:  https://github.com/ProstateBRP/mrigtl_lib
+
+  Copyright (c) Brigham and Women's Hospital. All rights reserved.
+
+  This software is distributed WITHOUT ANY WARRANTY; without even
+  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+  PURPOSE.  See the above copyright notices for more information.
+
+=========================================================================*/
+
+// Stand-in reader for the shared memory transport.
+//
+// Attaches to the rings created by an IGTLListener with transport 'shm', reads
+// the outbound messages in place (only the 58-byte header is unpacked) and
+// prints the message rate and throughput once per second. With '--start' a
+// STRING "START_SEQUENCE" is written to the inbound ring first.
+//
+// Usage: igtl_shm_reader [name] [--start]
+
+#include "shm_ring.h"
+#include <igtlMessageBase.h>
+#include <igtlStringMessage.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace mrigtlbridge;
+
+int main(int argc, char* argv[]) {
+    std::string name = "/mrigtl";
+    bool sendStart = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--start") == 0) {
+            sendStart = true;
+        } else {
+            name = argv[i];
+        }
+    }
+
+    SharedMemoryRing tx;
+    while (!tx.open(name + "_tx")) {
+        std::printf("Waiting for %s_tx...\n", name.c_str());
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::printf("Attached to %s_tx (%zu MB)\n", name.c_str(), tx.getCapacity() / (1024 * 1024));
+
+    if (sendStart) {
+        SharedMemoryRing rx;
+        if (rx.open(name + "_rx")) {
+            igtl::StringMessage::Pointer stringMsg = igtl::StringMessage::New();
+            stringMsg->SetDeviceName("shm_reader");
+            stringMsg->SetString("START_SEQUENCE");
+            stringMsg->Pack();
+            rx.write(stringMsg->GetPackPointer(), stringMsg->GetPackSize(), 1000);
+        } else {
+            std::printf("Could not open %s_rx\n", name.c_str());
+        }
+    }
+
+    igtl::MessageBase::Pointer header = igtl::MessageBase::New();
+    header->InitPack();
+    const size_t headerSize = static_cast<size_t>(header->GetPackSize());
+
+    long messages = 0;
+    double bytes = 0.0;
+    std::string lastType;
+    std::string lastName;
+    auto reportTime = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    for (;;) {
+        size_t size = 0;
+        const char* record = static_cast<const char*>(tx.peek(size, 100));
+        if (record) {
+            if (size >= headerSize) {
+                std::memcpy(header->GetPackPointer(), record, headerSize);
+                header->Unpack();
+                lastType = header->GetDeviceType();
+                lastName = header->GetDeviceName();
+                if (lastType == "STRING" && lastName == "DISCONNECT") {
+                    tx.release();
+                    std::printf("Writer disconnected\n");
+                    break;
+                }
+            }
+            messages++;
+            bytes += size;
+            tx.release();
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= reportTime) {
+            std::printf("%6ld msg/s  %9.1f MB/s  last: %s '%s'  queued: %zu bytes\n",
+                        messages, bytes / (1024.0 * 1024.0), lastType.c_str(), lastName.c_str(), tx.getUsed());
+            messages = 0;
+            bytes = 0.0;
+            reportTime = now + std::chrono::seconds(1);
+        }
+    }
+    return 0;
+}